@@ -1,49 +1,94 @@
 #include <iostream>
+#include <csignal>
 #include <fstream>
 #include <string>
 #include <thread>
 #include <chrono>
 #include "portaudio.h"  // Changed to use quotes
 #include <boost/asio.hpp>  // Changed to use angle brackets
-#include <queue>
 #include <mutex>
-#include <condition_variable>
 #include <vector>
 #include "sndfile.h"  // Changed to use quotes
 #include <filesystem>
 #include <atomic>
+#include <map>
+#include <memory>
+#include "logger.h"
+#include "dsp_kernels.h"
+#include "resampler.h"
+#include "clip_stream.h"
+#include "pcm_cache.h"
+#include "airframe_profile.h"
+#include "snapshot.h"
+#include "audio_mixer.h"
+#include "output_manager.h"
+#include "device_registry.h"
+#include "telemetry_packet.h"
+#include "udp_receiver.h"
+#include "process_stats.h"
+#include "file_watcher.h"
+#include "latency_trace.h"
+#include "telemetry_capture.h"
+#include "synthetic_flight.h"
+#include "decision_log.h"
+#include "aoa_predictor.h"
+#include "telemetry_source.h"
+
+static_assert(EFFECT_LAYERS == MIXER_EFFECT_VOICES, "one mixer synth voice per effect layer");
+
+// Warning clips converted to the sample rate of the stream they play on
+ResampledClipCache resampledClips;
+// Decodes ahead for warning clips streamed from disk
+ClipStreamer clipStreamer;
+// The same clips persisted in cache/, so later launches skip decoding
+PcmDiskCache pcmCache;
+
+// Output devices of every host API, indexed for lookups by name and ordinal
+DeviceRegistry deviceRegistry;
+
+// One stream per output device, shared by every warning routed to it.
+// Declared before the profiles, which hold leases on it.
+OutputManager outputs;
+
+// Loaded airframe profiles
+AirframeProfileCache airframeProfiles;
+
+// Senders of telemetry, each with its own airframe, profile snapshot and
+// warning state. A profile is published to a source with a single pointer
+// swap while the receiver reads it through a lock-free read guard.
+TelemetrySourceTable telemetrySources;
+// Guards the wanted profile of every source and the routes below
+std::mutex profileSwitchMutex;
+// Source_<n> routes of default.cfg; the version is bumped on every reload
+// so the receiver matches its senders again
+std::vector<SourceRoute> sourceRoutes;
+std::atomic<uint32_t> sourceRoutesVersion{0};
 
-// Configuration parameters
-float AOA_Warning_Start, AOA_Warning_End, Stall_warning;
-float AOA_warning_start_volume, AOA_warning_end_volume, Stall_warning_volume;
-std::string AOA_warning_audio_file, Stall_warning_audio_file;
-int AOA_warning_device_index, Stall_warning_device_index;
-int AOA_warning_balance, Stall_warning_balance;
-
-// Queue for sound playback
-std::queue<std::tuple<std::string, float, int, int>> soundQueue; // Use device index instead of device name
-std::mutex queueMutex;
-std::condition_variable queueCondition;
-bool stopCurrentSound = false;
-bool soundPlaying = false;
-
-// Buffers for preprocessed audio data
-std::vector<float> AOA_warning_buffer;
-std::vector<float> Stall_warning_buffer;
-int AOA_warning_sampleRate, AOA_warning_channels;
-int Stall_warning_sampleRate, Stall_warning_channels;
 
 // Forward declaration of calculateVolume function
 float calculateVolume(float AoA, float start, float end, float start_volume, float end_volume);
 
-// Add these global variables after the existing globals
-std::atomic<bool> shouldStop{false};
-std::string currentConfigPath;
-std::filesystem::file_time_type lastConfigModTime;
-std::string currentAirframe;  // Add this line after other global declarations
-
-// Add these declarations after other global variables
-std::string AOA_warning_device_name, Stall_warning_device_name;
+// The main thread's event loop: telemetry, timers, file changes and
+// signals. Besides the audio callbacks only the blocking work has threads
+// of its own: opening streams, loading profiles and writing the log.
+boost::asio::io_context eventLoop;
+
+// Reports edits in configuration/ and audio/
+DirectoryWatcher fileWatcher;
+
+// Optional outputs of the receive loop: the raw datagram stream (--record)
+// and the warning decisions (--decisions)
+CaptureRecorder captureRecorder;
+DecisionLog decisionLog;
+// Set while telemetry comes from --replay or --synthetic instead of UDP
+bool replayMode = false;
+// Clock the null and WAV outputs follow during a replay, unless
+// --audio-speed is given
+std::shared_ptr<ReplayAudioClock> replayAudioClock;
+// Datagrams read by the receive loop, from every sender
+uint64_t datagramsReceived = 0;
+// Capture times count from the first wakeup
+int64_t firstWakeupTime = 0;
 
 // Function to copy default config to new airframe config
 bool createAirframeConfig(const std::string& airframeName) {
@@ -52,18 +97,18 @@ bool createAirframeConfig(const std::string& airframeName) {
     
     std::ifstream src(defaultPath, std::ios::binary);
     if (!src.is_open()) {
-        std::cerr << "Failed to open default configuration file." << std::endl;
+        LOG_ERROR("Failed to open default configuration file.");
         return false;
     }
     
     std::ofstream dst(airframePath, std::ios::binary);
     if (!dst.is_open()) {
-        std::cerr << "Failed to create airframe configuration file." << std::endl;
+        LOG_ERROR("Failed to create airframe configuration file.");
         return false;
     }
     
     dst << src.rdbuf();
-    std::cout << "Created new configuration file for " << airframeName << std::endl;
+    LOG_INFO("Created new configuration file for {}", airframeName);
     return true;
 }
 
@@ -75,18 +120,16 @@ bool isNumeric(const std::string& str) {
 
 // Replace the existing findAndUpdateDeviceName function
 std::string findAndUpdateDeviceName(int deviceIndex, const std::string& configPath) {
-    const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(deviceIndex);
-    if (!deviceInfo) {
-        std::cerr << "Invalid device index: " << deviceIndex << std::endl;
+    std::string deviceName = deviceRegistry.deviceName(deviceIndex);
+    if (deviceName.empty()) {
+        LOG_ERROR("Invalid device index: {}", deviceIndex);
         return "";
     }
-
-    std::string deviceName = deviceInfo->name;
     
     // Read the entire config file
     std::ifstream inFile(configPath);
     if (!inFile.is_open()) {
-        std::cerr << "Failed to open config file for updating device name" << std::endl;
+        LOG_ERROR("Failed to open config file for updating device name");
         return deviceName;
     }
     
@@ -139,120 +182,89 @@ std::string findAndUpdateDeviceName(int deviceIndex, const std::string& configPa
     if (needsUpdate) {
         std::ofstream outFile(configPath);
         if (!outFile.is_open()) {
-            std::cerr << "Failed to open config file for writing updated device name" << std::endl;
+            LOG_ERROR("Failed to open config file for writing updated device name");
             return deviceName;
         }
         for (const auto& l : lines) {
             outFile << l << std::endl;
         }
         outFile.close();
-        std::cout << "Updated config file: converted device index " << deviceIndex 
-                  << " to name '" << deviceName << "'" << std::endl;
+        LOG_INFO("Updated config file: converted device index {} to name '{}'", deviceIndex, deviceName);
     }
 
     return deviceName;
 }
 
-// Add this new function before findDeviceByName()
-int getWasapiDeviceCount() {
-    int numDevices = Pa_GetDeviceCount();
-    int wasapiCount = 0;
-    for (int i = 0; i < numDevices; ++i) {
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
-        if (deviceInfo && deviceInfo->maxOutputChannels > 0) {
-            const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-            if (std::string(hostApiInfo->name).find("WASAPI") != std::string::npos) {
-                wasapiCount++;
-            }
+// Device index for a warning: the device with the configured name, else
+// the configured index, read as a device number or, as older configs used
+// it, as the nth device of the host API. Falls back to the host API's
+// first device; a named device that is missing is looked for again later,
+// so it is picked up when it is plugged back in.
+int resolveOutputDevice(const std::string& deviceName, int deviceIndex, const std::string& warningType) {
+    if (!deviceName.empty()) {
+        int found = deviceRegistry.findByName(deviceName);
+        if (found >= 0) {
+            return found;
         }
+        LOG_WARNING("Warning: {} device '{}' not found, using the default device until it is connected",
+                    warningType, deviceName);
+        outputs.retryDevicesLater();
+    } else if (deviceRegistry.isOutputDevice(deviceIndex)) {
+        return deviceIndex;
+    } else {
+        int found = deviceRegistry.findByOrdinal(deviceIndex);
+        if (found >= 0) {
+            return found;
+        }
+        LOG_WARNING("Warning: Requested {} device index {} not found, using first available device instead",
+                    warningType, deviceIndex);
     }
-    return wasapiCount;
-}
 
-// Replace existing findDeviceByName() with this version
-int findDeviceByName(const std::string& deviceName) {
-    int numDevices = Pa_GetDeviceCount();
-    // First try to find WASAPI device with this name
-    for (int i = 0; i < numDevices; ++i) {
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
-        if (deviceInfo && deviceInfo->maxOutputChannels > 0) {
-            const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-            if (std::string(hostApiInfo->name).find("WASAPI") != std::string::npos) {
-                if (std::string(deviceInfo->name) == deviceName) {
-                    return i;
-                }
-            }
-        }
+    int fallback = deviceRegistry.defaultOutput();
+    if (fallback < 0) {
+        LOG_ERROR("Error: No output devices found");
     }
-    return -1;
+    return fallback;
 }
 
-// Replace existing findWasapiDevice() with this version
-int findWasapiDevice(int requestedIndex) {
-    int numDevices = Pa_GetDeviceCount();
-    int wasapiCount = 0;
-    
-    // First try to find the nth WASAPI device
-    for (int i = 0; i < numDevices; ++i) {
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
-        const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-        
-        if (deviceInfo->maxOutputChannels > 0 && 
-            std::string(hostApiInfo->name).find("WASAPI") != std::string::npos) {
-            if (wasapiCount == requestedIndex) {
-                return i;
-            }
-            wasapiCount++;
-        }
+// Path of the config file for an airframe, creating it from default.cfg
+// on first use. An empty name selects default.cfg.
+std::string resolveConfigPath(const std::string& airframeName) {
+    if (airframeName.empty()) {
+        return "configuration/default.cfg";
     }
 
-    // If requested index is too high, return the first WASAPI device
-    for (int i = 0; i < numDevices; ++i) {
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
-        const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-        
-        if (deviceInfo->maxOutputChannels > 0 && 
-            std::string(hostApiInfo->name).find("WASAPI") != std::string::npos) {
-            std::cout << "Warning: Requested WASAPI device index " << requestedIndex 
-                     << " not found, using first available WASAPI device instead" << std::endl;
-            return i;
+    std::string configPath = "configuration/" + airframeName + ".cfg";
+    std::ifstream test(configPath);
+    if (!test.is_open()) {
+        LOG_INFO("No configuration found for {}, creating new config...", airframeName);
+        if (createAirframeConfig(airframeName)) {
+            LOG_INFO("Successfully created configuration for {}", airframeName);
+        } else {
+            LOG_WARNING("Failed to create airframe config, using default.cfg");
+            configPath = "configuration/default.cfg";
         }
     }
-
-    std::cerr << "Error: No WASAPI devices found" << std::endl;
-    return -1;
+    return configPath;
 }
 
-// Modified readConfig function to handle airframe-specific configs
-void readConfig(const std::string& airframeName = "") {
-    if (airframeName.empty()) {
-        currentConfigPath = "configuration/default.cfg";
-    } else {
-        currentConfigPath = "configuration/" + airframeName + ".cfg";
-        std::ifstream test(currentConfigPath);
-        if (!test.is_open()) {
-            std::cout << "No configuration found for " << airframeName << ", creating new config..." << std::endl;
-            if (createAirframeConfig(airframeName)) {
-                std::cout << "Successfully created configuration for " << airframeName << std::endl;
-            } else {
-                std::cout << "Failed to create airframe config, using default.cfg" << std::endl;
-                currentConfigPath = "configuration/default.cfg";
-            }
-        }
-    }
-    
-    // Update last modification time
-    try {
-        lastConfigModTime = std::filesystem::last_write_time(currentConfigPath);
-    } catch (const std::filesystem::filesystem_error& e) {
-        std::cerr << "Error getting file modification time: " << e.what() << std::endl;
-    }
+// Audio files are named relative to audio/ and may be in a subfolder of it.
+// The name is kept in the form the file watcher reports changes in, so
+// "sub\rumble.wav" on Windows or "./rumble.wav" still match their file.
+std::string normalizeAudioFile(const std::string& file) {
+    return std::filesystem::path(file).lexically_normal().generic_string();
+}
 
-    std::ifstream config(currentConfigPath);
+// Read one config file into config. Only the keys present in the file are
+// changed, so a default config can be layered under an airframe one.
+bool readConfig(const std::string& configPath, AirframeConfig& settings) {
+    std::ifstream config(configPath);
     if (!config.is_open()) {
-        std::cerr << "Failed to open configuration file: " << currentConfigPath << std::endl;
-        exit(1);
+        LOG_ERROR("Failed to open configuration file: {}", configPath);
+        return false;
     }
+    // The first Effect line of a file replaces the effects it inherits
+    bool effectsDeclared = false;
     std::string line;
     while (std::getline(config, line)) {
         // Skip empty lines
@@ -287,101 +299,107 @@ void readConfig(const std::string& airframeName = "") {
                      key == "Stall_warning_device_index" || key == "Stall_warning_device_name") && 
                     isNumeric(value)) {
                     int deviceIndex = std::stoi(value);
-                    std::string deviceName = findAndUpdateDeviceName(deviceIndex, currentConfigPath);
+                    std::string deviceName = findAndUpdateDeviceName(deviceIndex, configPath);
                     
                     if (key.find("AOA") != std::string::npos) {
-                        AOA_warning_device_index = deviceIndex;
-                        AOA_warning_device_name = deviceName;
+                        settings.aoaWarningDeviceIndex = deviceIndex;
+                        settings.aoaWarningDeviceName = deviceName;
                     } else {
-                        Stall_warning_device_index = deviceIndex;
-                        Stall_warning_device_name = deviceName;
+                        settings.stallWarningDeviceIndex = deviceIndex;
+                        settings.stallWarningDeviceName = deviceName;
                     }
                     continue;
                 }
                 
-                if (key == "AOA_Warning_Start") AOA_Warning_Start = std::stof(value);
-                else if (key == "AOA_Warning_End") AOA_Warning_End = std::stof(value);
-                else if (key == "Stall_warning") Stall_warning = std::stof(value);
-                else if (key == "AOA_warning_start_volume") AOA_warning_start_volume = std::stof(value);
-                else if (key == "AOA_warning_end_volume") AOA_warning_end_volume = std::stof(value);
-                else if (key == "Stall_warning_volume") Stall_warning_volume = std::stof(value);
-                else if (key == "AOA_warning_audio_file") AOA_warning_audio_file = value;
-                else if (key == "Stall_warning_audio_file") Stall_warning_audio_file = value;
+                if (key == "AOA_Warning_Start") settings.aoaWarningStart = std::stof(value);
+                else if (key == "AOA_Warning_End") settings.aoaWarningEnd = std::stof(value);
+                else if (key == "Stall_warning") settings.stallWarning = std::stof(value);
+                else if (key == "AOA_warning_start_volume") settings.aoaWarningStartVolume = std::stof(value);
+                else if (key == "AOA_warning_end_volume") settings.aoaWarningEndVolume = std::stof(value);
+                else if (key == "Stall_warning_volume") settings.stallWarningVolume = std::stof(value);
+                else if (key == "AOA_warning_audio_file") settings.aoaWarningAudioFile = normalizeAudioFile(value);
+                else if (key == "Stall_warning_audio_file") settings.stallWarningAudioFile = normalizeAudioFile(value);
                 else if (key == "AOA_warning_device_index") {
-                    AOA_warning_device_index = std::stoi(value);
-                    AOA_warning_device_name = findAndUpdateDeviceName(AOA_warning_device_index, currentConfigPath);
+                    settings.aoaWarningDeviceIndex = std::stoi(value);
+                    settings.aoaWarningDeviceName = findAndUpdateDeviceName(settings.aoaWarningDeviceIndex, configPath);
+                }
+                else if (key == "AOA_warning_device_name") settings.aoaWarningDeviceName = value;
+                else if (key == "AOA_warning_balance") settings.aoaWarningBalance = std::stoi(value);
+                else if (key == "Stall_warning_device_index") {
+                    settings.stallWarningDeviceIndex = std::stoi(value);
+                    settings.stallWarningDeviceName = findAndUpdateDeviceName(settings.stallWarningDeviceIndex, configPath);
                 }
-                else if (key == "AOA_warning_device_name") {
-                    AOA_warning_device_name = value;
-                    int deviceIndex = findDeviceByName(value);
-                    if (deviceIndex >= 0) {
-                        AOA_warning_device_index = deviceIndex;
+                else if (key == "Stall_warning_device_name") settings.stallWarningDeviceName = value;
+                else if (key == "Stall_warning_balance") settings.stallWarningBalance = std::stoi(value);
+                else if (key == "AOA_warning_routing" || key == "Stall_warning_routing") {
+                    ChannelRouting& routing = key == "AOA_warning_routing" ? settings.aoaWarningRouting
+                                                                          : settings.stallWarningRouting;
+                    std::string error;
+                    if (!parseChannelRouting(value, routing, error)) {
+                        LOG_WARNING("Warning: Ignoring {} in {}: {}", key, configPath, error);
                     }
                 }
-                else if (key == "AOA_warning_balance") AOA_warning_balance = std::stoi(value);
-                else if (key == "Stall_warning_device_index") {
-                    Stall_warning_device_index = std::stoi(value);
-                    Stall_warning_device_name = findAndUpdateDeviceName(Stall_warning_device_index, currentConfigPath);
+                else if (key == "Effect") {
+                    if (!effectsDeclared) {
+                        settings.effects.clear();
+                        effectsDeclared = true;
+                    }
+                    if (value == "off") continue;
+                    EffectRule rule;
+                    std::string error;
+                    if (parseEffectRule(value, rule, error)) {
+                        settings.effects.push_back(rule);
+                    } else {
+                        LOG_WARNING("Warning: Ignoring Effect '{}' in {}: {}", value, configPath, error);
+                    }
                 }
-                else if (key == "Stall_warning_device_name") {
-                    Stall_warning_device_name = value;
-                    int deviceIndex = findDeviceByName(value);
-                    if (deviceIndex >= 0) {
-                        Stall_warning_device_index = deviceIndex;
+                else if (key.compare(0, 7, "Source_") == 0) {
+                    std::string error;
+                    if (!parseSourceRouteSetting(key, value, settings.sources, error)) {
+                        LOG_WARNING("Warning: Ignoring {} in {}: {}", key, configPath, error);
+                    }
+                }
+                else if (key == "AOA_prediction") settings.aoaPrediction = (value != "off");
+                else if (key == "AOA_prediction_max_lookahead") settings.aoaPredictionMaxLookahead = std::stof(value);
+                else if (key == "AOA_hysteresis") settings.aoaHysteresis = std::stof(value);
+                else if (key == "Telemetry_receive_mode") settings.coalescePackets = (value != "all");
+                else if (key == "Telemetry_timeout") settings.telemetryTimeout = std::stof(value);
+                else if (key == "Audio_cache") settings.audioCache = (value != "off");
+                else if (key == "Audio_host_api") settings.hostApi = value;
+                else if (key == "Warning_mode") settings.synthesis = (value == "synth");
+                else if (key == "Synth_waveform") {
+                    settings.synthWaveform = value == "square" ? SynthWaveform::Square : SynthWaveform::Sine;
+                }
+                else if (key == "Synth_start_frequency") settings.synthStartFrequency = std::stof(value);
+                else if (key == "Synth_end_frequency") settings.synthEndFrequency = std::stof(value);
+                else if (key == "Synth_start_pulse_rate") settings.synthStartPulseRate = std::stof(value);
+                else if (key == "Synth_end_pulse_rate") settings.synthEndPulseRate = std::stof(value);
+                else if (key == "Synth_stall_frequency") settings.synthStallFrequency = std::stof(value);
+                else if (key == "Log_level") {
+                    LogLevel level;
+                    if (parseLogLevel(value, level)) {
+                        settings.logLevel = value;
+                    } else {
+                        LOG_WARNING("Unknown Log_level '{}', expected debug, info, warning, error or off", value);
                     }
                 }
-                else if (key == "Stall_warning_balance") Stall_warning_balance = std::stoi(value);
             }
         }
     }
     config.close();
-    std::cout << "Configuration loaded successfully." << std::endl;
-    std::cout << "AOA_Warning_Start: " << AOA_Warning_Start << std::endl;
-    std::cout << "AOA_Warning_End: " << AOA_Warning_End << std::endl;
-    std::cout << "Stall_warning: " << Stall_warning << std::endl;
-    std::cout << "AOA_warning_start_volume: " << AOA_warning_start_volume << std::endl;
-    std::cout << "AOA_warning_end_volume: " << AOA_warning_end_volume << std::endl;
-    std::cout << "Stall_warning_volume: " << Stall_warning_volume << std::endl;
-    std::cout << "AOA_warning_audio_file: " << AOA_warning_audio_file << std::endl;
-    std::cout << "Stall_warning_audio_file: " << Stall_warning_audio_file << std::endl;
-    std::cout << "AOA_warning_device_index: " << AOA_warning_device_index << std::endl;
-    std::cout << "AOA_warning_balance: " << AOA_warning_balance << std::endl;
-    std::cout << "Stall_warning_device_index: " << Stall_warning_device_index << std::endl;
-    std::cout << "Stall_warning_balance: " << Stall_warning_balance << std::endl;
-
-    // Add device name logging
-    std::cout << "AOA Warning Device: " << AOA_warning_device_name 
-              << " (index: " << AOA_warning_device_index << ")" << std::endl;
-    std::cout << "Stall Warning Device: " << Stall_warning_device_name 
-              << " (index: " << Stall_warning_device_index << ")" << std::endl;
+    return true;
 }
 
-// Modify listAudioDevices() to show only system indices
+// List the output devices of the preferred host API
 void listAudioDevices() {
-    Pa_Initialize();
-    int numDevices = Pa_GetDeviceCount();
-    const PaDeviceInfo* deviceInfo;
-    const PaHostApiInfo* hostApiInfo;
-    
-    std::cout << "\nAvailable WASAPI output devices:" << std::endl;
-    std::cout << "--------------------------------" << std::endl;
-    
-    for (int i = 0; i < numDevices; ++i) {
-        deviceInfo = Pa_GetDeviceInfo(i);
-        if (deviceInfo->maxOutputChannels > 0) {
-            hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-            if (std::string(hostApiInfo->name).find("WASAPI") != std::string::npos) {
-                std::cout << "  [" << i << "] " 
-                         << deviceInfo->name 
-                         << " - Channels: " << deviceInfo->maxOutputChannels
-                         << std::endl;
-            }
-        }
+    LOG_INFO("\nAvailable {} output devices:", deviceRegistry.preferredHostApiName());
+    LOG_INFO("--------------------------------");
+
+    for (const AudioDeviceEntry& device : deviceRegistry.preferredDevices()) {
+        LOG_INFO("  [{}] {} - Channels: {}", device.index, device.name, device.outputChannels);
     }
-    
-    std::cout << "\nNote: Use the device number shown in [n] in your config file\n" << std::endl;
-    
-    Pa_Terminate();
+
+    LOG_INFO("\nNote: Use the device number shown in [n] in your config file\n");
 }
 
 // Function to load audio data into buffer
@@ -389,7 +407,7 @@ bool loadAudioData(const std::string& filename, std::vector<float>& buffer, int&
     SF_INFO sfInfo;
     SNDFILE* sndFile = sf_open(filename.c_str(), SFM_READ, &sfInfo);
     if (!sndFile) {
-        std::cerr << "Failed to open audio file: " << filename << std::endl;
+        LOG_ERROR("Failed to open audio file: {}", filename);
         return false;
     }
 
@@ -411,50 +429,40 @@ float calculateVolume(float AoA, float start, float end, float start_volume, flo
 
 // Function to apply a limiter to the audio signal
 void applyLimiter(std::vector<float>& buffer, float threshold) {
-    for (auto& sample : buffer) {
-        if (sample > threshold) {
-            sample = threshold;
-        } else if (sample < -threshold) {
-            sample = -threshold;
-        }
-    }
+    clampSamples(buffer.data(), buffer.size(), threshold);
 }
 
 // Function to preprocess audio data
 void preprocessAudioData(const std::string& file, float volume, int balance, std::vector<float>& buffer, int& sampleRate, int& channels) {
     std::string filePath = "audio/" + file;
-    std::cout << "Loading audio file: " << filePath << std::endl;
+    LOG_INFO("Loading audio file: {}", filePath);
     
     // Clear the buffer before loading new data
     buffer.clear();
     
     if (!loadAudioData(filePath, buffer, sampleRate, channels)) {
-        std::cerr << "Failed to load audio data: " << filePath << std::endl;
+        LOG_ERROR("Failed to load audio data: {}", filePath);
         return;
     }
 
-    std::cout << "Successfully loaded audio file: " << filePath << std::endl;
-    std::cout << "Initial buffer size: " << buffer.size() << ", channels: " << channels << std::endl;
+    LOG_INFO("Successfully loaded audio file: {}", filePath);
+    LOG_DEBUG("Initial buffer size: {}, channels: {}", buffer.size(), channels);
 
     if (buffer.empty()) {
-        std::cerr << "Error: Buffer is empty after loading" << std::endl;
+        LOG_ERROR("Error: Buffer is empty after loading");
         return;
     }
 
     float leftVolume = volume * (1.0f - balance / 100.0f);
     float rightVolume = volume * (1.0f + balance / 100.0f);
 
-    std::cout << "Applying volume adjustments - Left: " << leftVolume << ", Right: " << rightVolume << std::endl;
+    LOG_DEBUG("Applying volume adjustments - Left: {}, Right: {}", leftVolume, rightVolume);
 
     // Create a temporary buffer for the processed audio
     std::vector<float> processedBuffer = buffer;
 
-    for (size_t i = 0; i < processedBuffer.size(); i += channels) {
-        processedBuffer[i] *= leftVolume / 100.0f;
-        if (channels > 1) {
-            processedBuffer[i + 1] *= rightVolume / 100.0f;
-        }
-    }
+    applyInterleavedGain(processedBuffer.data(), processedBuffer.size() / channels, channels,
+                         leftVolume / 100.0f, rightVolume / 100.0f);
 
     // Apply limiter to the audio signal
     applyLimiter(processedBuffer, 0.9f);
@@ -462,402 +470,1458 @@ void preprocessAudioData(const std::string& file, float volume, int balance, std
     // Only update the buffer if processing was successful
     buffer = std::move(processedBuffer);
 
-    std::cout << "Final buffer size: " << buffer.size() 
-              << ", First few samples: " << buffer[0];
-    if (buffer.size() > 1) std::cout << ", " << buffer[1];
-    if (buffer.size() > 2) std::cout << ", " << buffer[2];
-    std::cout << std::endl;
+    LOG_DEBUG("Final buffer size: {}, First few samples: {}, {}, {}", buffer.size(), buffer[0],
+              buffer.size() > 1 ? buffer[1] : 0.0f, buffer.size() > 2 ? buffer[2] : 0.0f);
 }
 
-// Add global variables for volume scaling
-float aoa_warning_scaling = 1.0f;
-float stall_warning_scaling = 1.0f;
-
-// Function to analyze audio peak levels and calculate safe volume scaling
-float analyzeAudioLevels(const std::vector<float>& buffer, const std::string& warningType) {
-    float maxPeak = 0.0f;
-    for (const float& sample : buffer) {
-        float absSample = std::abs(sample);
-        if (absSample > maxPeak) {
-            maxPeak = absSample;
-        }
-    }
-    
+// Safe volume scaling for a clip whose processed samples peak at maxPeak
+float scalingForPeak(float maxPeak, const std::string& warningType) {
     // Calculate scaling factor needed to prevent clipping at max volume
     float maxDesiredPeak = 0.7f; // Leave some headroom
     float safeScaling = (maxPeak > 0.0f) ? std::min(maxDesiredPeak / maxPeak, 1.0f) : 1.0f;
     
-    std::cout << warningType << " audio analysis - Max peak: " << maxPeak 
-              << ", Safe scaling factor: " << safeScaling << std::endl;
+    LOG_INFO("{} audio analysis - Max peak: {}, Safe scaling factor: {}", warningType, maxPeak, safeScaling);
     
     return safeScaling;
 }
 
-// Function to play preprocessed sound with continuous playback
-void playPreprocessedSound(const std::vector<float>& buffer, int sampleRate, int channels, int deviceIndex, float volume, int balance) {
-    if (buffer.empty()) {
-        std::cerr << "Error: Audio buffer is empty" << std::endl;
-        return;
+// Function to analyze audio peak levels and calculate safe volume scaling
+float analyzeAudioLevels(const std::vector<float>& buffer, const std::string& warningType) {
+    return scalingForPeak(peakAbsolute(buffer.data(), buffer.size()), warningType);
+}
+
+// Balance baked into a warning clip. Routed warnings are placed by their
+// routing matrix in the mixer instead.
+int clipBalance(int balance, const ChannelRouting& routing) {
+    return routing.routed() ? 0 : balance;
+}
+
+// Warn about routes to channels the warning's device does not have
+void checkRouting(const ChannelRouting& routing, const AudioMixer* mixer, const char* warningType) {
+    if (mixer && routing.outputs > mixer->channels()) {
+        LOG_WARNING("Warning: {} routing uses output channel {}, but device {} has {} channel(s); "
+                    "routes beyond it are not played", warningType, routing.outputs - 1, mixer->deviceIndex(),
+                    mixer->channels());
+    }
+}
+
+// Open a long clip for streaming. Volume and balance are applied as the
+// chunks are decoded, the same way preprocessAudioData treats a whole clip.
+WarningSound loadStreamedSound(const std::string& filePath, float volume, int balance, int deviceRate,
+                               const std::string& warningType) {
+    WarningSound sound;
+    LOG_INFO("Streaming audio file: {}", filePath);
+    float leftVolume = volume * (1.0f - balance / 100.0f);
+    float rightVolume = volume * (1.0f + balance / 100.0f);
+    std::string error;
+    sound.stream = StreamedClip::open(filePath, leftVolume / 100.0f, rightVolume / 100.0f, deviceRate,
+                                      MIXER_SOURCES, error);
+    if (!sound.stream) {
+        LOG_ERROR("Failed to stream audio file {}: {}", filePath, error);
+        return sound;
+    }
+    const ClipFormat& format = sound.stream->format();
+    sound.sampleRate = format.sourceRate;
+    sound.channels = format.channels;
+    sound.scaling = scalingForPeak(sound.stream->peak(), warningType);
+    LOG_INFO("{} streams {} s of audio ({} Hz -> {} Hz)", warningType,
+             static_cast<float>(sound.stream->fileFrames()) / format.sourceRate, format.sourceRate,
+             format.deviceRate);
+    clipStreamer.add(sound.stream);
+    return sound;
+}
+
+// Decode and preprocess one warning clip and convert it to the sample rate
+// of the mixer it plays on. With the PCM cache enabled a previously
+// converted clip is mapped from disk. Files above CLIP_STREAM_MIN_FILE_BYTES
+// are streamed instead and skip both caches.
+WarningSound loadWarningSound(const std::string& file, float volume, int balance, const AudioMixer* mixer,
+                              const std::string& warningType, bool useCache) {
+    WarningSound sound;
+    int deviceRate = mixer ? static_cast<int>(std::lround(mixer->sampleRate())) : 0;
+
+    std::error_code ec;
+    uintmax_t fileSize = std::filesystem::file_size("audio/" + file, ec);
+    if (!ec && fileSize > CLIP_STREAM_MIN_FILE_BYTES) {
+        return loadStreamedSound("audio/" + file, volume, balance, deviceRate, warningType);
+    }
+
+    PcmCacheKey key{"audio/" + file, volume, balance, deviceRate};
+    PcmSourceStamp source;
+    bool cacheable = useCache && deviceRate > 0 && statSourceFile(key.sourcePath, source);
+    PcmCacheEntry cached;
+    if (cacheable && pcmCache.load(key, source, cached)) {
+        sound.sampleRate = cached.sourceRate;
+        sound.channels = cached.channels;
+        sound.scaling = cached.scaling;
+        sound.playback = cached.samples;
+        LOG_INFO("Loaded {} from the PCM cache ({} Hz, scaling {})", key.sourcePath, deviceRate, sound.scaling);
+        return sound;
     }
 
-    // Use different streams for different devices
-    static PaStream* aoa_stream = nullptr;
-    static PaStream* stall_stream = nullptr;
-    static int aoa_device_index = -1;
-    static int stall_device_index = -1;
-    PaStream** currentStream;
-    int* currentDeviceIndex;
+    std::vector<float> buffer;
+    preprocessAudioData(file, volume, balance, buffer, sound.sampleRate, sound.channels);
+    sound.scaling = analyzeAudioLevels(buffer, warningType);
+    if (deviceRate == 0) {
+        deviceRate = sound.sampleRate;
+    }
+    sound.playback = resampledClips.get(buffer, sound.channels, sound.sampleRate, deviceRate);
 
-    // Determine which stream to use based on the buffer being played
-    if (buffer.data() == AOA_warning_buffer.data()) {
-        currentStream = &aoa_stream;
-        currentDeviceIndex = &aoa_device_index;
+    if (cacheable && !sound.playback->empty()) {
+        pcmCache.store(key, source,
+                       PcmCacheEntry{sound.playback, sound.sampleRate, sound.channels, sound.scaling});
+    }
+    return sound;
+}
+
+// Build the profile for a cache key: an airframe (empty name: default.cfg),
+// on the outputs of a Source_<n> route if the key names one. Runs on the
+// profile loader thread, except for the startup profile. Returns null if
+// default.cfg cannot be read.
+AirframeProfileCache::Profile loadAirframeProfile(const std::string& key) {
+    auto profile = std::make_shared<AirframeProfile>();
+    std::string airframe;
+    splitProfileKey(key, airframe, profile->route);
+    profile->airframe = airframe;
+    profile->configPath = resolveConfigPath(airframe);
+    std::string name = airframe.empty() ? "default configuration" : airframe;
+    if (profile->route > 0) {
+        name += " on Source_" + std::to_string(profile->route);
+    }
+
+    // Airframe files are layered over default.cfg
+    if (!readConfig("configuration/default.cfg", profile->config)) {
+        return nullptr;
+    }
+    // Sources are only routed by default.cfg; its profile is loaded again
+    // whenever the file changes, which updates the routes of the receiver
+    std::vector<SourceRoute> routes = profile->config.sources;
+    if (key.empty()) {
+        std::lock_guard<std::mutex> lock(profileSwitchMutex);
+        sourceRoutes = routes;
+        sourceRoutesVersion.fetch_add(1, std::memory_order_release);
+    }
+    // The host API applies to the whole process, so it only comes from default.cfg
+    if (!deviceRegistry.setPreferredHostApi(profile->config.hostApi) && airframe.empty()) {
+        LOG_WARNING("Warning: Audio host API '{}' not found, using {}", profile->config.hostApi,
+                    deviceRegistry.preferredHostApiName());
+    }
+    if (profile->configPath != "configuration/default.cfg") {
+        readConfig(profile->configPath, profile->config);
+    }
+
+    AirframeConfig& config = profile->config;
+    config.sources = routes;
+    if (profile->route > 0) {
+        // The route's outputs replace the devices and channels of both warnings
+        if (const SourceRoute* route = findSourceRoute(routes, profile->route)) {
+            if (!route->deviceName.empty()) {
+                config.aoaWarningDeviceName = route->deviceName;
+                config.stallWarningDeviceName = route->deviceName;
+            } else if (route->deviceIndex >= 0) {
+                config.aoaWarningDeviceName.clear();
+                config.stallWarningDeviceName.clear();
+                config.aoaWarningDeviceIndex = route->deviceIndex;
+                config.stallWarningDeviceIndex = route->deviceIndex;
+            }
+            if (route->routing.routed()) {
+                config.aoaWarningRouting = route->routing;
+                config.stallWarningRouting = route->routing;
+            }
+        } else {
+            LOG_WARNING("Warning: Source_{} is not configured any more, using the outputs of {}",
+                        profile->route, profile->configPath);
+        }
+    }
+    AudioBackendConfig backend = outputs.backend();
+    if (backend.isVirtual()) {
+        // A null or WAV output stands in for every configured device
+        config.aoaWarningDeviceIndex = VIRTUAL_OUTPUT_DEVICE;
+        config.stallWarningDeviceIndex = VIRTUAL_OUTPUT_DEVICE;
+        LOG_INFO("Using the {} output for both warnings", audioBackendName(backend.kind));
     } else {
-        currentStream = &stall_stream;
-        currentDeviceIndex = &stall_device_index;
+        config.aoaWarningDeviceIndex = resolveOutputDevice(config.aoaWarningDeviceName, config.aoaWarningDeviceIndex,
+                                                           "AOA warning");
+        config.stallWarningDeviceIndex = resolveOutputDevice(config.stallWarningDeviceName,
+                                                             config.stallWarningDeviceIndex, "Stall warning");
+        LOG_INFO("Using {} device indices: AOA={}, Stall={}", deviceRegistry.preferredHostApiName(),
+                 config.aoaWarningDeviceIndex, config.stallWarningDeviceIndex);
+    }
+
+    // Both warnings share one stream when they use the same device
+    profile->aoaOutput = outputs.acquire(config.aoaWarningDeviceIndex);
+    profile->stallOutput = outputs.acquire(config.stallWarningDeviceIndex);
+    checkRouting(config.aoaWarningRouting, profile->aoaOutput.get(), "AOA warning");
+    checkRouting(config.stallWarningRouting, profile->stallOutput.get(), "Stall warning");
+    for (const EffectRule& rule : config.effects) {
+        checkRouting(rule.routing, profile->aoaOutput.get(), "Effect");
+    }
+    if (!config.effects.empty()) {
+        profile->effects = std::make_shared<const EffectRuleSet>(config.effects);
+    }
+
+    if (config.synthesis) {
+        // The cue is generated in the audio callback
+        LOG_INFO("Profile loaded for {} (synthesis mode)", name);
+        return profile;
     }
 
-    // Initialize or reinitialize stream if device changed
-    if (*currentStream == nullptr || *currentDeviceIndex != deviceIndex) {
-        // Cleanup existing stream if device changed
-        if (*currentStream != nullptr) {
-            Pa_CloseStream(*currentStream);
-            *currentStream = nullptr;
+    profile->aoaWarning = loadWarningSound(config.aoaWarningAudioFile, config.aoaWarningStartVolume,
+                                           clipBalance(config.aoaWarningBalance, config.aoaWarningRouting),
+                                           profile->aoaOutput.get(), "AOA Warning", config.audioCache);
+    profile->stallWarning = loadWarningSound(config.stallWarningAudioFile, config.stallWarningVolume,
+                                             clipBalance(config.stallWarningBalance, config.stallWarningRouting),
+                                             profile->stallOutput.get(), "Stall Warning", config.audioCache);
+
+    LOG_INFO("Profile loaded for {}", name);
+    return profile;
+}
+
+// Queue every airframe config in configuration/ for loading in the
+// background, so later airframe switches find their profile ready
+void prefetchAirframeProfiles() {
+    size_t requested = 0;
+    try {
+        for (const auto& entry : std::filesystem::directory_iterator("configuration")) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".cfg") continue;
+            std::string airframe = entry.path().stem().string();
+            if (airframe == "default") continue;
+            // Leave room for the default profile
+            if (requested + 1 >= PROFILE_CACHE_CAPACITY) break;
+            airframeProfiles.request(airframe);
+            ++requested;
         }
+    } catch (const std::filesystem::filesystem_error& e) {
+        LOG_ERROR("Error listing configuration files: {}", e.what());
+    }
+    LOG_INFO("Prefetching {} airframe profile(s)", requested);
+}
 
-        Pa_Initialize();
-        
-        // Get the actual device info
-        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(deviceIndex);
-        if (!deviceInfo) {
-            std::cerr << "Error: Could not get device info for index " << deviceIndex << std::endl;
-            return;
+// Release condition for a profile that was replaced by next: every mixer
+// has applied the commands posted while it was current, and no voice is
+// still playing one of its clips that next does not share. Only evaluated
+// once no reader can post new commands for the old profile.
+std::function<bool()> mixersReleased(const AirframeProfile& previous, const AirframeProfile& next) {
+    std::vector<const float*> clips;
+    for (const WarningSound* sound : {&previous.aoaWarning, &previous.stallWarning}) {
+        const float* data = sound->clipData();
+        if (!data) continue;
+        if (next.aoaWarning.clipData() == data || next.stallWarning.clipData() == data) continue;
+        clips.push_back(data);
+    }
+    if (clips.empty()) {
+        return {};
+    }
+
+    // Commands for previous only went to its own mixers, which its leases
+    // keep alive until it is released
+    struct Fence {
+        const AudioMixer* mixer;
+        uint64_t block;
+    };
+    std::vector<Fence> fences;
+    for (const AudioMixer* mixer : {previous.aoaOutput.get(), previous.stallOutput.get()}) {
+        if (mixer && (fences.empty() || fences.front().mixer != mixer)) {
+            fences.push_back(Fence{mixer, 0});
+        }
+    }
+    bool armed = false;
+    return [clips, fences, armed]() mutable {
+        if (!armed) {
+            // Commands already queued are applied within two buffers
+            for (Fence& fence : fences) {
+                fence.block = fence.mixer->blocksRendered() + 2;
+            }
+            armed = true;
+        }
+        for (const Fence& fence : fences) {
+            // A stream that stopped (device lost or rescanned) plays nothing
+            if (!fence.mixer->isRunning()) continue;
+            if (fence.mixer->blocksRendered() < fence.block) return false;
+            for (const float* clip : clips) {
+                if (fence.mixer->isPlayingClip(clip)) return false;
+            }
         }
+        return true;
+    };
+}
 
-        const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
-        std::cout << "Using audio device: " << deviceInfo->name 
-                  << " with API: " << hostApiInfo->name 
-                  << "\nDevice sample rate: " << deviceInfo->defaultSampleRate
-                  << "\nRequested sample rate: " << sampleRate << std::endl;
-
-        // Set up stream parameters
-        PaStreamParameters outputParameters;
-        outputParameters.device = deviceIndex;
-        outputParameters.channelCount = channels;
-        outputParameters.sampleFormat = paFloat32;
-        outputParameters.suggestedLatency = deviceInfo->defaultLowOutputLatency;
-        outputParameters.hostApiSpecificStreamInfo = nullptr;
-
-        // Open stream
-        PaError err = Pa_OpenStream(currentStream,
-                                  nullptr,
-                                  &outputParameters,
-                                  deviceInfo->defaultSampleRate,
-                                  paFramesPerBufferUnspecified,
-                                  paClipOff,
-                                  nullptr,
-                                  nullptr);
-        
-        if (err != paNoError) {
-            std::cerr << "Error opening stream: " << Pa_GetErrorText(err) << std::endl;
-            return;
+void logProfile(const AirframeProfile& profile) {
+    const AirframeConfig& config = profile.config;
+    LOG_INFO("Configuration loaded successfully from {}", profile.configPath);
+    if (profile.route > 0) {
+        LOG_INFO("Playing on the outputs of Source_{}", profile.route);
+    }
+    LOG_INFO("AOA_Warning_Start: {}", config.aoaWarningStart);
+    LOG_INFO("AOA_Warning_End: {}", config.aoaWarningEnd);
+    LOG_INFO("Stall_warning: {}", config.stallWarning);
+    LOG_INFO("AOA_warning_start_volume: {}", config.aoaWarningStartVolume);
+    LOG_INFO("AOA_warning_end_volume: {}", config.aoaWarningEndVolume);
+    LOG_INFO("Stall_warning_volume: {}", config.stallWarningVolume);
+    LOG_INFO("AOA_warning_audio_file: {}", config.aoaWarningAudioFile);
+    LOG_INFO("Stall_warning_audio_file: {}", config.stallWarningAudioFile);
+    LOG_INFO("AOA_warning_device_index: {}", config.aoaWarningDeviceIndex);
+    LOG_INFO("AOA_warning_balance: {}", config.aoaWarningBalance);
+    LOG_INFO("Stall_warning_device_index: {}", config.stallWarningDeviceIndex);
+    LOG_INFO("Stall_warning_balance: {}", config.stallWarningBalance);
+    LOG_INFO("AOA_warning_routing: {}", formatChannelRouting(config.aoaWarningRouting));
+    LOG_INFO("Stall_warning_routing: {}", formatChannelRouting(config.stallWarningRouting));
+    LOG_INFO("AOA_prediction: {}, max lookahead {} s", config.aoaPrediction ? "on" : "off",
+             config.aoaPredictionMaxLookahead);
+    LOG_INFO("AOA_hysteresis: {}", config.aoaHysteresis);
+    LOG_INFO("Telemetry_receive_mode: {}", config.coalescePackets ? "latest" : "all");
+    LOG_INFO("Telemetry_timeout: {} s", config.telemetryTimeout);
+    LOG_INFO("Log_level: {}", logLevelName(Logger::instance().level()));
+    LOG_INFO("Audio_cache: {}", config.audioCache ? "on" : "off");
+    LOG_INFO("Warning_mode: {}", config.synthesis ? "synth" : "clip");
+    for (const EffectRule& rule : config.effects) {
+        LOG_INFO("Effect {}: layer {}, {} condition(s)", rule.name, rule.layer + 1, rule.conditionCount);
+    }
+    for (const SourceRoute& route : config.sources) {
+        std::string address = route.hasAddress ? route.address.to_string() : "none";
+        if (route.port != 0) {
+            address += ":" + std::to_string(route.port);
         }
+        LOG_INFO("Source_{}: address {}, device {}, routing {}", route.number, address,
+                 route.deviceName.empty() ? std::to_string(route.deviceIndex) : route.deviceName,
+                 formatChannelRouting(route.routing));
+    }
+    if (config.synthesis) {
+        LOG_INFO("Synth_waveform: {}", config.synthWaveform == SynthWaveform::Square ? "square" : "sine");
+        LOG_INFO("Synth frequency: {} to {} Hz, stall {} Hz", config.synthStartFrequency,
+                 config.synthEndFrequency, config.synthStallFrequency);
+        LOG_INFO("Synth pulse rate: {} to {} Hz", config.synthStartPulseRate, config.synthEndPulseRate);
+    }
+
+    // Add device name logging
+    LOG_INFO("AOA Warning Device: {} (index: {})", config.aoaWarningDeviceName, config.aoaWarningDeviceIndex);
+    LOG_INFO("Stall Warning Device: {} (index: {})", config.stallWarningDeviceName, config.stallWarningDeviceIndex);
+    LOG_INFO("AOA Warning scaling: {}, Stall Warning scaling: {}",
+             profile.aoaWarning.scaling, profile.stallWarning.scaling);
+}
 
-        err = Pa_StartStream(*currentStream);
-        if (err != paNoError) {
-            std::cerr << "Error starting stream: " << Pa_GetErrorText(err) << std::endl;
+// Apply the Log_level of a profile; the last published profile wins
+void applyLogLevel(const AirframeProfile& profile) {
+    LogLevel level;
+    if (parseLogLevel(profile.config.logLevel, level)) {
+        Logger::instance().setLevel(level);
+    }
+}
+
+// Make a loaded profile the current snapshot of a source with a single
+// pointer swap. Requires profileSwitchMutex; does no file or audio I/O.
+void publishProfile(TelemetrySource& source, const AirframeProfileCache::Profile& profile) {
+    applyLogLevel(*profile);
+    AirframeProfileCache::Profile previous = source.profile.current();
+    source.profile.publish(profile, previous ? mixersReleased(*previous, *profile) : std::function<bool()>());
+    logProfile(*profile);
+}
+
+// Called by the receiver when the airframe of a source changes. A profile
+// that is not loaded yet is requested from the loader thread; the previous
+// profile stays in effect until onProfileLoaded publishes the new one.
+void switchAirframe(TelemetrySource& source, const std::string& key) {
+    std::lock_guard<std::mutex> lock(profileSwitchMutex);
+    // Pin the new profile before releasing the old one, which may be the same
+    airframeProfiles.pin(key);
+    airframeProfiles.unpin(source.wantedProfile);
+    source.wantedProfile = key;
+    if (AirframeProfileCache::Profile profile = airframeProfiles.find(key)) {
+        publishProfile(source, profile);
+        LOG_INFO("Audio buffers reloaded for {} ({})", key, source.name);
+    } else {
+        LOG_INFO("Loading profile for {} in the background...", key);
+        airframeProfiles.request(key);
+    }
+}
+
+// Replays wait for the profile of a new airframe before going on, so the
+// decisions after an airframe change do not depend on how fast it loads
+void awaitAirframeProfile(TelemetrySource& source, const std::string& key) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (true) {
+        {
+            auto profile = source.profile.read(source.reader);
+            if (profile && profile->key() == key) return;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            LOG_WARNING("Warning: Profile for {} not loaded after 10 s, replay continues", key);
             return;
         }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
 
-        *currentDeviceIndex = deviceIndex;
-        std::cout << "Audio stream initialized for device " << deviceInfo->name << std::endl;
+// Called on the loader thread for every finished profile, including
+// reloads after a config file change
+void onProfileLoaded(const AirframeProfileCache::Profile& profile) {
+    std::lock_guard<std::mutex> lock(profileSwitchMutex);
+    std::string key = profile->key();
+    size_t count = telemetrySources.size();
+    for (size_t i = 0; i < count; ++i) {
+        TelemetrySource& source = telemetrySources[i];
+        if (source.wantedProfile != key) continue;
+        publishProfile(source, profile);
+        LOG_INFO("Audio buffers reloaded for {} ({})", key.empty() ? "default configuration" : key, source.name);
     }
+}
 
-    std::cout << "Playing sound with buffer size: " << buffer.size() << ", channels: " << channels << std::endl;
-    
-    // Create a temporary buffer for volume-adjusted samples
-    std::vector<float> adjustedBuffer(buffer.size());
-    
-    // Calculate channel volumes based on balance (-100 to +100)
-    // Convert balance to a ratio between 0 and 1
-    float balanceRatio = (balance + 100.0f) / 200.0f;
-    float leftVolume = volume * (1.0f - balanceRatio);
-    float rightVolume = volume * balanceRatio;
-    
-    // Apply the appropriate scaling factor based on which sound is playing
-    float scaling = (buffer.data() == AOA_warning_buffer.data()) ? aoa_warning_scaling : stall_warning_scaling;
-    
-    std::cout << "Audio parameters - Left vol: " << leftVolume << ", Right vol: " << rightVolume 
-              << ", Scaling: " << scaling << std::endl;
-
-    // Apply volume adjustments
-    for (size_t i = 0; i < buffer.size(); i += channels) {
-        if (channels > 1) {
-            adjustedBuffer[i] = buffer[i] * (leftVolume / 100.0f) * scaling;
-            adjustedBuffer[i + 1] = buffer[i + 1] * (rightVolume / 100.0f) * scaling;
+// Queue a command on a warning's mixer; null if its device failed to open.
+// The command is timestamped for the latency trace as it is queued.
+void postMixerCommand(AudioMixer* mixer, SoundCommand command) {
+    if (!mixer) {
+        return;
+    }
+    if (command.trace.receiveTime != 0) {
+        command.trace.enqueueTime = latencyNow();
+        LatencyTracer::instance().record(LATENCY_RECEIVE_TO_ENQUEUE, command.trace.enqueueTime - command.trace.receiveTime);
+    }
+    mixer->post(command);
+}
+
+// Function to send a play or stop command for a warning of a source to its
+// device mixer. Returns immediately; the audio callback pulls the samples.
+void postSoundCommand(const AirframeProfile& profile, uint8_t source, SoundOp op, WarningId warning, float volume,
+                      const LatencyTrace& trace) {
+    SoundCommand command;
+    command.op = op;
+    command.warning = warning;
+    command.source = source;
+    command.volume = volume;
+    command.trace = trace;
+
+    const WarningSound* sound;
+    AudioMixer* mixer;
+    if (warning == WARNING_AOA) {
+        sound = &profile.aoaWarning;
+        mixer = profile.aoaOutput.get();
+        command.balance = static_cast<int16_t>(profile.config.aoaWarningBalance);
+        command.routing = profile.config.aoaWarningRouting;
+        command.deviceIndex = profile.config.aoaWarningDeviceIndex;
+    } else {
+        sound = &profile.stallWarning;
+        mixer = profile.stallOutput.get();
+        command.balance = static_cast<int16_t>(profile.config.stallWarningBalance);
+        command.routing = profile.config.stallWarningRouting;
+        command.deviceIndex = profile.config.stallWarningDeviceIndex;
+    }
+    command.channels = static_cast<uint16_t>(sound->channels);
+    command.scaling = sound->scaling;
+
+    if (op == SoundOp::Play) {
+        if (sound->empty() || command.channels == 0) {
+            LOG_ERROR("Error: Audio buffer is empty");
+            return;
+        }
+        command.data = sound->clipData();
+        if (sound->stream) {
+            // Each source plays through its own stream of the clip
+            command.stream = sound->stream->stream(source);
         } else {
-            adjustedBuffer[i] = buffer[i] * (volume / 100.0f) * scaling;
+            command.frames = static_cast<uint32_t>(sound->playback->size() / command.channels);
         }
     }
 
-    PaError err = Pa_WriteStream(*currentStream, adjustedBuffer.data(), buffer.size() / channels);
-    if (err != paNoError) {
-        std::cerr << "Error writing to stream: " << Pa_GetErrorText(err) << std::endl;
+    postMixerCommand(mixer, command);
+}
+
+// Synthesis mode: map AoA continuously onto the cue and send it to the
+// device of the warning that applies. Between AOA_Warning_Start and
+// AOA_Warning_End volume, carrier frequency and pulse rate rise together;
+// in the stall band the cue is a continuous tone at the stall settings.
+// Returns true if the cue is playing.
+bool postSynthCommand(const AirframeProfile& profile, uint8_t source, const TelemetrySample& sample,
+                      WarningBand band, bool playing, const LatencyTrace& trace) {
+    const AirframeConfig& config = profile.config;
+    float AoA = sample.AoA;
+    bool warn = band != WarningBand::Idle;
+    if (!warn && !playing) {
+        decisionLog.write(sample, "idle");
+        return false;
+    }
+
+    bool stall = band == WarningBand::Stall;
+    SoundCommand command;
+    command.warning = WARNING_SYNTH;
+    command.source = source;
+    command.waveform = config.synthWaveform;
+    command.trace = trace;
+    command.deviceIndex = stall ? config.stallWarningDeviceIndex : config.aoaWarningDeviceIndex;
+    AudioMixer* mixer = stall ? profile.stallOutput.get() : profile.aoaOutput.get();
+    AudioMixer* otherMixer = stall ? profile.aoaOutput.get() : profile.stallOutput.get();
+
+    if (!warn) {
+        command.op = SoundOp::Stop;
+    } else if (stall) {
+        command.op = SoundOp::Synth;
+        command.volume = config.stallWarningVolume;
+        command.balance = static_cast<int16_t>(config.stallWarningBalance);
+        command.routing = config.stallWarningRouting;
+        command.frequency = config.synthStallFrequency;
+        command.pulseRate = 0.0f;
+    } else {
+        float range = config.aoaWarningEnd - config.aoaWarningStart;
+        float t = range > 0.0f ? (AoA - config.aoaWarningStart) / range : 1.0f;
+        t = std::min(std::max(t, 0.0f), 1.0f);
+        command.op = SoundOp::Synth;
+        command.volume = calculateVolume(AoA, config.aoaWarningStart, config.aoaWarningEnd,
+                                         config.aoaWarningStartVolume, config.aoaWarningEndVolume);
+        command.balance = static_cast<int16_t>(config.aoaWarningBalance);
+        command.routing = config.aoaWarningRouting;
+        command.frequency = config.synthStartFrequency + t * (config.synthEndFrequency - config.synthStartFrequency);
+        command.pulseRate = config.synthStartPulseRate + t * (config.synthEndPulseRate - config.synthStartPulseRate);
+    }
+    LOG_DEBUG("Synth cue for AoA {}: volume {}, frequency {} Hz, pulse rate {} Hz",
+              AoA, command.volume, command.frequency, command.pulseRate);
+    if (warn) {
+        decisionLog.write(sample, "synth", command.volume, command.frequency, command.pulseRate);
+    } else {
+        decisionLog.write(sample, "synth-stop");
+    }
+    postMixerCommand(mixer, command);
+
+    // The cue moves to the stall device at Stall_warning; fade out the other
+    if (otherMixer != mixer) {
+        SoundCommand stop;
+        stop.op = SoundOp::Stop;
+        stop.warning = WARNING_SYNTH;
+        stop.source = source;
+        stop.deviceIndex = stall ? config.aoaWarningDeviceIndex : config.stallWarningDeviceIndex;
+        postMixerCommand(otherMixer, stop);
     }
+    return warn;
 }
 
-// Cleanup function to be called at program exit
+// Test a sample against the profile's effect rules and start, update or
+// stop the cue of each layer on the AOA warning's device. The cues are not
+// latency traced, so the trace keeps measuring the AoA warnings.
+void updateEffects(TelemetrySource& source, const AirframeProfile& profile, const TelemetrySample& sample) {
+    EffectPlayback& playback = source.effects;
+    if (playback.rules != profile.effects || playback.output != profile.aoaOutput) {
+        // Profile switch: silence what the old rules started
+        for (int layer = 0; layer < EFFECT_LAYERS; ++layer) {
+            if (playback.playing[layer] < 0) continue;
+            SoundCommand stop;
+            stop.op = SoundOp::Stop;
+            stop.warning = static_cast<WarningId>(WARNING_EFFECT + layer);
+            stop.source = source.id;
+            postMixerCommand(playback.output.get(), stop);
+            playback.playing[layer] = -1;
+        }
+        playback.rules = profile.effects;
+        playback.output = profile.aoaOutput;
+        playback.evaluator.reset(playback.rules.get());
+    }
+    if (!playback.rules) {
+        return;
+    }
+
+    float values[EFFECT_VALUE_COUNT];
+    effectValues(sample, values);
+    EffectCue cues[EFFECT_LAYERS];
+    playback.evaluator.evaluate(values, sample.captureTime, cues);
+
+    const AirframeConfig& config = profile.config;
+    for (int layer = 0; layer < EFFECT_LAYERS; ++layer) {
+        const EffectCue& cue = cues[layer];
+        if (cue.rule < 0 && playback.playing[layer] < 0) continue;
+
+        SoundCommand command;
+        command.warning = static_cast<WarningId>(WARNING_EFFECT + layer);
+        command.source = source.id;
+        command.deviceIndex = config.aoaWarningDeviceIndex;
+        if (cue.rule < 0) {
+            command.op = SoundOp::Stop;
+            if (decisionLog.isOpen()) {
+                char decision[64];
+                std::snprintf(decision, sizeof(decision), "effect-stop:%s",
+                              playback.rules->rule(playback.playing[layer]).name.c_str());
+                decisionLog.write(sample, decision);
+            }
+        } else {
+            const EffectRule& rule = playback.rules->rule(cue.rule);
+            command.op = SoundOp::Synth;
+            command.volume = cue.volume;
+            command.frequency = cue.frequency;
+            command.pulseRate = cue.pulseRate;
+            command.waveform = rule.waveform;
+            if (rule.routing.routed()) {
+                command.routing = rule.routing;
+            } else {
+                command.balance = static_cast<int16_t>(config.aoaWarningBalance);
+                command.routing = config.aoaWarningRouting;
+            }
+            if (cue.rule != playback.playing[layer] && decisionLog.isOpen()) {
+                char decision[64];
+                std::snprintf(decision, sizeof(decision), "effect:%s", rule.name.c_str());
+                decisionLog.write(sample, decision, cue.volume, cue.frequency, cue.pulseRate);
+            }
+        }
+        playback.playing[layer] = cue.rule;
+        postMixerCommand(profile.aoaOutput.get(), command);
+    }
+}
+
+// Cleanup function to be called at program exit; runs once, at the end of
+// main or from exit() on an early return
 void cleanupAudio() {
+    static bool done = false;
+    if (done) {
+        return;
+    }
+    done = true;
+    LatencyTracer::instance().report();
+    fileWatcher.stop();
+    airframeProfiles.stop();
+    outputs.closeAll();
+    clipStreamer.stop();
     // Simply call Pa_Terminate() - it's safe to call even if PA isn't initialized
     Pa_Terminate();
 }
 
-// Thread function to process sound playback
-void soundPlaybackThread() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        queueCondition.wait(lock, [] { return !soundQueue.empty(); });
+// Copy of a profile with the warning clips that play audio/<file> decoded
+// again. Runs on the profile loader thread; returns null to keep the
+// current profile if the file is gone.
+AirframeProfileCache::Profile reloadWarningClip(const AirframeProfileCache::Profile& current, const std::string& file) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file("audio/" + file, ec)) {
+        LOG_WARNING("Warning: audio/{} was removed, keeping the loaded clip", file);
+        return nullptr;
+    }
+
+    auto profile = std::make_shared<AirframeProfile>(*current);
+    const AirframeConfig& config = profile->config;
+    if (config.aoaWarningAudioFile == file) {
+        profile->aoaWarning = loadWarningSound(file, config.aoaWarningStartVolume,
+                                               clipBalance(config.aoaWarningBalance, config.aoaWarningRouting),
+                                               profile->aoaOutput.get(), "AOA Warning", config.audioCache);
+    }
+    if (config.stallWarningAudioFile == file) {
+        profile->stallWarning = loadWarningSound(file, config.stallWarningVolume,
+                                                 clipBalance(config.stallWarningBalance, config.stallWarningRouting),
+                                                 profile->stallOutput.get(), "Stall Warning", config.audioCache);
+    }
+    LOG_INFO("Reloaded audio/{} for {}", file, profile->airframe.empty() ? "default configuration" : profile->airframe);
+    return profile;
+}
+
+// Called on the watcher thread with each debounced batch of changed files.
+// The work is queued on the profile loader; onProfileLoaded publishes the
+// result if it belongs to the current airframe.
+void onWatchedFilesChanged(const std::set<std::string>& paths) {
+    for (const std::string& path : paths) {
+        std::filesystem::path changed(path);
+        std::string directory = changed.parent_path().string();
+
+        if (path == "configuration" || path == "audio") {
+            // Events were lost, so anything may have changed
+            LOG_INFO("Missed changes in {}/, reloading all profiles...", path);
+            for (const auto& profile : airframeProfiles.profiles()) {
+                airframeProfiles.reload(profile->key());
+            }
+        } else if (directory == "configuration" && changed.extension() == ".cfg") {
+            std::string airframe = changed.stem().string();
+            if (airframe == "default") {
+                // Every airframe file is layered over default.cfg
+                LOG_INFO("Configuration file {} changed, reloading all profiles...", path);
+                for (const auto& profile : airframeProfiles.profiles()) {
+                    airframeProfiles.reload(profile->key());
+                }
+            } else {
+                // The airframe's own profile and those of the routes it flies on
+                bool announced = false;
+                for (const auto& profile : airframeProfiles.profiles()) {
+                    if (profile->airframe != airframe) continue;
+                    if (!announced) {
+                        LOG_INFO("Configuration file {} changed, reloading settings...", path);
+                        announced = true;
+                    }
+                    airframeProfiles.reload(profile->key());
+                }
+            }
+        } else if (path.compare(0, 6, "audio/") == 0) {
+            // Relative to audio/, as the config names it
+            std::string file = path.substr(6);
+            for (const auto& profile : airframeProfiles.profiles()) {
+                const AirframeConfig& config = profile->config;
+                if (config.synthesis) continue;
+                if (config.aoaWarningAudioFile != file && config.stallWarningAudioFile != file) continue;
+                LOG_INFO("Audio file {} changed, reloading it for {}...", path,
+                         profile->airframe.empty() && profile->route == 0 ? "default configuration" : profile->key());
+                airframeProfiles.rebuild(profile->key(), [file](const AirframeProfileCache::Profile& current) {
+                    return reloadWarningClip(current, file);
+                });
+            }
+        }
+    }
+}
 
-        while (!soundQueue.empty()) {
-            auto [file, volume, balance, deviceIndex] = soundQueue.front();
-            soundQueue.pop();
-            lock.unlock();
+// Rescan the audio devices and reload every profile, so they resolve their
+// devices again. PortAudio only sees added or removed devices after it is
+// initialized again, which closes every stream, so this runs on the profile
+// loader thread where no other PortAudio call is in progress.
+void refreshAudioDevices() {
+    LOG_INFO("Rescanning audio devices...");
+    PaError err = paNoError;
+    // No stream may be opened or closed while PortAudio restarts
+    outputs.detachAll([&err] {
+        Pa_Terminate();
+        err = Pa_Initialize();
+    });
+    if (err != paNoError) {
+        LOG_ERROR("Failed to initialize PortAudio: {}", Pa_GetErrorText(err));
+        outputs.retryDevicesLater();
+        return;
+    }
+    deviceRegistry.refresh();
+    listAudioDevices();
+    for (const auto& profile : airframeProfiles.profiles()) {
+        airframeProfiles.reload(profile->key());
+    }
+}
 
-            std::cout << "Processing sound: file=" << file << ", volume=" << volume 
-                     << ", balance=" << balance << ", device=" << deviceIndex << std::endl;
+// Called on the output manager's thread when a stream stopped on its own or
+// a configured device was missing
+void onAudioDevicesChanged(bool streamLost) {
+    // Rescanning interrupts every stream; while only waiting for a device to
+    // come back, do not cut off a warning that is playing
+    if (!streamLost && !outputs.allIdle()) {
+        outputs.retryDevicesLater();
+        return;
+    }
+    airframeProfiles.post(refreshAudioDevices);
+}
 
-            // Remove the audio/ prefix for comparison
-            std::string audioFile = file;
-            if (audioFile.substr(0, 6) == "audio/") {
-                audioFile = audioFile.substr(6);
+// Track the AoA of a sample and extrapolate it to when a warning sent for
+// it is heard: the sender's delay plus the measured receive-to-DAC latency,
+// and one packet interval, for which the cue stands until the next sample
+// corrects it
+float predictAoA(TelemetrySource& source, const TelemetrySample& sample, const AirframeConfig& config) {
+    AoaPrediction& prediction = source.prediction;
+    // Sim time paces binary samples and stops while the sim is paused
+    double time = sample.binary ? sample.modelTime : sample.captureTime / 1e6;
+    prediction.predictor.update(time, sample.AoA);
+    if (!config.aoaPrediction) {
+        return sample.AoA;
+    }
+
+    double lookahead = AOA_PREDICTOR_NOMINAL_LATENCY;
+    if (!replayMode) {
+        // The histogram is scanned now and then, not per packet
+        const LatencyHistogram& measured = LatencyTracer::instance().stage(LATENCY_RECEIVE_TO_DAC);
+        if (prediction.samples++ % 64 == 0 && measured.count() >= 16) {
+            prediction.latency = measured.percentileMicros(0.5) / 1e6;
+        }
+        lookahead = prediction.latency;
+        if (sample.senderDelay >= 0) {
+            lookahead += sample.senderDelay / 1e9;
+        }
+    }
+    lookahead += prediction.predictor.interval();
+    return prediction.predictor.predict(std::min(lookahead, static_cast<double>(config.aoaPredictionMaxLookahead)));
+}
+
+// Match a source against the Source_<n> routes again after default.cfg
+// was reloaded. Returns true if it moved to another route, whose profile
+// it must switch to.
+bool updateSourceRoute(TelemetrySource& source) {
+    uint32_t version = sourceRoutesVersion.load(std::memory_order_acquire);
+    if (source.routesVersion == version) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(profileSwitchMutex);
+    source.routesVersion = sourceRoutesVersion.load(std::memory_order_relaxed);
+    int route = matchSourceRoute(sourceRoutes, source.sender);
+    if (route == source.route) {
+        return false;
+    }
+    if (route > 0) {
+        LOG_INFO("Telemetry from {} plays on the outputs of Source_{}", source.name, route);
+    } else {
+        LOG_INFO("Telemetry from {} plays on the outputs of its airframe config", source.name);
+    }
+    source.route = route;
+    return true;
+}
+
+// Act on one telemetry sample of a source: reload the configuration on an
+// airframe change and send the matching warning commands to the mixers.
+// Returns true if the airframe or route changed.
+bool processTelemetrySample(TelemetrySource& source, const TelemetrySample& received) {
+    const char* airframe = received.airframe;
+    bool airframeChanged = updateSourceRoute(source);
+
+    if (received.binary) {
+        LOG_DEBUG("Received data from {}: IAS={}, AoA={}, Airframe={}, Moving={}, Seq={}", source.name,
+                  received.IAS, received.AoA, airframe, received.IAS >= 10.0f ? "yes" : "no", received.sequence);
+    } else {
+        LOG_DEBUG("Received data from {}: IAS={}, AoA={}, Airframe={}, Moving={}", source.name,
+                  received.IAS, received.AoA, airframe, received.IAS >= 10.0f ? "yes" : "no");
+    }
+
+    // Switch profiles if the airframe changes
+    if (source.airframe != airframe || airframeChanged) {
+        if (source.airframe != airframe) {
+            LOG_INFO("Airframe of {} changed from '{}' to '{}'", source.name, source.airframe, airframe);
+            source.airframe = airframe;
+            source.prediction.predictor.reset();
+        }
+        airframeChanged = true;
+        std::string key = profileKey(source.airframe, source.route);
+        switchAirframe(source, key);
+        if (replayMode) {
+            awaitAirframeProfile(source, key);
+        }
+    }
+
+    auto profile = source.profile.read(source.reader);
+    if (!profile) {
+        // A new source before any profile could be published to it
+        return airframeChanged;
+    }
+    const AirframeConfig& config = profile->config;
+
+    // Warnings and effects act on the predicted AoA, which is also the one
+    // the decision log shows
+    TelemetrySample sample = received;
+    sample.AoA = predictAoA(source, received, config);
+    float AoA = sample.AoA;
+    if (sample.AoA != received.AoA) {
+        LOG_DEBUG("Predicted AoA {} ({} deg/s)", sample.AoA, source.prediction.predictor.rate());
+    }
+    WarningBand band = classifyWarningBand(sample.IAS, AoA, config.aoaWarningStart, config.stallWarning,
+                                           config.aoaHysteresis, source.warningBand);
+    source.warningBand = band;
+
+    LatencyTrace trace;
+    trace.receiveTime = sample.receiveTime;
+    trace.senderDelay = sample.senderDelay;
+
+    if (config.synthesis) {
+        source.soundPlaying = postSynthCommand(*profile, source.id, sample, band, source.soundPlaying, trace);
+        updateEffects(source, *profile, sample);
+        return airframeChanged;
+    }
+
+    if (band == WarningBand::Aoa) {
+        float volume = calculateVolume(AoA, config.aoaWarningStart, config.aoaWarningEnd, 
+                                    config.aoaWarningStartVolume, config.aoaWarningEndVolume);
+        LOG_DEBUG("Calculated AOA warning volume: {} for AoA: {}", volume, AoA);
+        postSoundCommand(*profile, source.id, SoundOp::Stop, WARNING_STALL, 0.0f, trace);
+        postSoundCommand(*profile, source.id, SoundOp::Play, WARNING_AOA, volume, trace);
+        decisionLog.write(sample, "aoa", volume);
+        source.soundPlaying = true;
+    } else if (band == WarningBand::Stall) {
+        LOG_DEBUG("Using stall warning volume: {} for AoA: {}", config.stallWarningVolume, AoA);
+        postSoundCommand(*profile, source.id, SoundOp::Stop, WARNING_AOA, 0.0f, trace);
+        postSoundCommand(*profile, source.id, SoundOp::Play, WARNING_STALL, config.stallWarningVolume, trace);
+        decisionLog.write(sample, "stall", config.stallWarningVolume);
+        source.soundPlaying = true;
+    } else if (source.soundPlaying) {
+        // No warning applies any more, fade out whatever is playing
+        postSoundCommand(*profile, source.id, SoundOp::Stop, WARNING_AOA, 0.0f, trace);
+        postSoundCommand(*profile, source.id, SoundOp::Stop, WARNING_STALL, 0.0f, trace);
+        decisionLog.write(sample, "stop");
+        source.soundPlaying = false;
+    } else {
+        decisionLog.write(sample, "idle");
+    }
+
+    updateEffects(source, *profile, sample);
+    return airframeChanged;
+}
+
+// Fade out every voice of a source, e.g. before its slot is taken over
+void silenceSource(TelemetrySource& source) {
+    auto profile = source.profile.read(source.reader);
+    if (!profile) {
+        return;
+    }
+    for (AudioMixer* mixer : {profile->aoaOutput.get(), profile->stallOutput.get(), source.effects.output.get()}) {
+        for (int warning = 0; warning < WARNING_COUNT; ++warning) {
+            SoundCommand stop;
+            stop.op = SoundOp::Stop;
+            stop.warning = static_cast<WarningId>(warning);
+            stop.source = source.id;
+            postMixerCommand(mixer, stop);
+        }
+    }
+    source.soundPlaying = false;
+    source.warningBand = WarningBand::Idle;
+    for (int& rule : source.effects.playing) {
+        rule = -1;
+    }
+}
+
+// Silence the warnings and effects of every source whose telemetry stopped
+// for longer than its Telemetry_timeout: DCS closed, the mission ended or the
+// network dropped. Times are on the capture clock, so a replay times out
+// at the same samples as the session it recorded.
+void silenceStaleSources(uint64_t captureTime) {
+    size_t count = telemetrySources.size();
+    for (size_t i = 0; i < count; ++i) {
+        TelemetrySource& source = telemetrySources[i];
+        bool playing = source.soundPlaying;
+        for (int rule : source.effects.playing) {
+            playing |= rule >= 0;
+        }
+        if (!playing) continue;
+
+        float timeout;
+        {
+            auto profile = source.profile.read(source.reader);
+            if (!profile) continue;
+            timeout = profile->config.telemetryTimeout;
+        }
+        uint64_t silent = captureTime - source.lastCaptureTime;
+        if (timeout <= 0.0f || captureTime < source.lastCaptureTime || silent < timeout * 1e6f) continue;
+
+        LOG_INFO("No telemetry from {} for {} s, silencing its warnings", source.name, silent / 1e6);
+        silenceSource(source);
+        source.prediction.predictor.reset();
+    }
+}
+
+// Free replaced profiles once the mixers are done with them
+void collectRetiredProfiles() {
+    size_t count = telemetrySources.size();
+    for (size_t i = 0; i < count; ++i) {
+        TelemetrySource& source = telemetrySources[i];
+        if (source.profile.hasRetired()) {
+            source.profile.collect();
+        }
+    }
+}
+
+// Datagrams of senders that found no free source
+uint64_t rejectedDatagrams = 0;
+// Datagrams too long for DatagramBatch, dropped unparsed
+uint64_t truncatedDatagrams = 0;
+
+// Source for the first datagram of a sender. When every source is in use,
+// the one silent the longest is taken over if it has been idle for
+// TELEMETRY_SOURCE_IDLE_NANOS; otherwise returns null. Allocates.
+TelemetrySource* acquireSource(const boost::asio::ip::udp::endpoint& sender, int64_t now) {
+    std::lock_guard<std::mutex> lock(profileSwitchMutex);
+    TelemetrySource* source = telemetrySources.add(sender);
+    if (source) {
+        LOG_INFO("New telemetry source {} ({} of {})", source->name, source->id + 1, MAX_TELEMETRY_SOURCES);
+    } else if ((source = telemetrySources.idlest(now))) {
+        LOG_INFO("Telemetry source {} takes over from {}, which is silent",
+                 sender.address().to_string() + ":" + std::to_string(sender.port()), source->name);
+        silenceSource(*source);
+        source->restart(sender);
+        airframeProfiles.unpin(source->wantedProfile);
+    } else {
+        // Only at powers of two, so a flood of senders does not flood the log
+        uint64_t rejected = ++rejectedDatagrams;
+        if ((rejected & (rejected - 1)) == 0) {
+            LOG_WARNING("Warning: Ignoring telemetry from {}, all {} sources are in use ({} datagram(s) so far)",
+                        sender.address().to_string(), MAX_TELEMETRY_SOURCES, rejected);
+        }
+        return nullptr;
+    }
+
+    source->route = matchSourceRoute(sourceRoutes, sender);
+    source->routesVersion = sourceRoutesVersion.load(std::memory_order_relaxed);
+    if (source->route > 0) {
+        LOG_INFO("Telemetry from {} plays on the outputs of Source_{}", source->name, source->route);
+    }
+    // Until the first sample names its airframe, a new source plays with
+    // the default profile of its outputs. The profile a source wants stays
+    // cached, so file changes are applied to it.
+    source->wantedProfile = profileKey("", source->route);
+    airframeProfiles.pin(source->wantedProfile);
+    if (!source->profile.current()) {
+        AirframeProfileCache::Profile profile = airframeProfiles.find(source->wantedProfile);
+        if (!profile) {
+            airframeProfiles.request(source->wantedProfile);
+            profile = airframeProfiles.find("");
+        }
+        if (profile) {
+            source->profile.publish(profile);
+        }
+    }
+    return source;
+}
+
+// Handle one wakeup of the receive loop: drain the datagrams queued on the
+// socket, or those of the replay's current wakeup, and dispatch each to
+// the source of its sender. Returns false if the socket failed.
+bool handleTelemetryWakeup(boost::asio::ip::udp::socket& socket, TelemetryReplay& replay) {
+    // Datagrams are drained in batches on every wakeup, so a stall on this
+    // thread never leaves a backlog of old samples to play out
+    static DatagramBatch batch;
+    const size_t maxDrainPerWakeup = 1024;
+
+    int64_t wakeupTime = latencyNow();
+    if (firstWakeupTime == 0) {
+        firstWakeupTime = wakeupTime;
+    }
+    uint64_t captureTime = replayMode ? replay.wakeupTime()
+                                      : static_cast<uint64_t>(wakeupTime - firstWakeupTime) / 1000;
+    bool wakeupStart = true;
+    if (replayAudioClock) {
+        // The output catches up with this wakeup before its commands are posted
+        replayAudioClock->advanceTo(captureTime);
+    }
+    silenceStaleSources(captureTime);
+
+    size_t coalescedThisWakeup = 0;
+    size_t drained = 0;
+    size_t received;
+    boost::system::error_code error;
+
+    do {
+        // Datagrams read before a receive error are still handled
+        received = replayMode ? replay.receivePending(batch) : receivePendingDatagrams(socket, batch, error);
+        drained += received;
+        int64_t receiveTime = latencyNow();
+        double receiveWallClock = latencyWallClock();
+
+        datagramsReceived += received;
+
+        for (size_t i = 0; i < received; ++i) {
+            if (batch.truncated[i]) {
+                // Only at powers of two, so a misbehaving sender does not flood the log
+                uint64_t truncated = ++truncatedDatagrams;
+                if ((truncated & (truncated - 1)) == 0) {
+                    LOG_WARNING("Warning: Dropped a datagram from {} longer than {} bytes ({} so far)",
+                                batch.sender[i].address().to_string(), DATAGRAM_MAX_SIZE - 1, truncated);
+                }
+                continue;
             }
+            captureRecorder.record(captureTime, wakeupStart, batch.data[i], batch.length[i]);
+            wakeupStart = false;
 
-            if (audioFile == AOA_warning_audio_file) {
-                if (!AOA_warning_buffer.empty()) {
-                    playPreprocessedSound(AOA_warning_buffer, AOA_warning_sampleRate, 
-                                       AOA_warning_channels, deviceIndex, volume, balance);
-                } else {
-                    std::cerr << "Error: AOA warning buffer is empty" << std::endl;
+            TelemetrySource* source = telemetrySources.find(batch.sender[i]);
+            if (!source) {
+                source = acquireSource(batch.sender[i], receiveTime);
+                if (!source) {
+                    continue;
                 }
-            } else if (audioFile == Stall_warning_audio_file) {
-                if (!Stall_warning_buffer.empty()) {
-                    playPreprocessedSound(Stall_warning_buffer, Stall_warning_sampleRate, 
-                                       Stall_warning_channels, deviceIndex, volume, balance);
-                } else {
-                    std::cerr << "Error: Stall warning buffer is empty" << std::endl;
+            }
+            source->lastReceiveTime = receiveTime;
+            source->lastCaptureTime = captureTime;
+
+            TelemetrySample sample;
+            TelemetryParseResult result = source->parser.parse(batch.data[i], batch.length[i], sample);
+            if (result == TelemetryParseResult::AirframeDeclared) {
+                continue;
+            }
+            if (result != TelemetryParseResult::Sample) {
+                // Samples keep coming until the sender next declares its
+                // airframe, so only every power of two is reported
+                uint64_t ignored = ++source->ignoredPackets;
+                if ((ignored & (ignored - 1)) == 0) {
+                    const char* reason =
+                        result == TelemetryParseResult::UnknownAirframe ? "airframe not declared yet" :
+                        result == TelemetryParseResult::UnsupportedVersion ? "unsupported version" : "malformed";
+                    LOG_WARNING("Ignoring telemetry packet from {}: {} ({} ignored so far)", source->name, reason,
+                                ignored);
                 }
-            } else {
-                std::cerr << "Error: Unknown audio file: " << file << std::endl;
+                continue;
+            }
+
+            // Late or duplicated binary packets are dropped
+            if (sample.binary) {
+                if (source->haveLastSequence && isStaleSequence(sample.sequence, source->lastSequence)) {
+                    ++source->droppedPackets;
+                    continue;
+                }
+                source->haveLastSequence = true;
+                source->lastSequence = sample.sequence;
+
+                // Only meaningful when the sender shares this machine's clock
+                double senderDelay = receiveWallClock - sample.sendTime;
+                if (senderDelay >= 0.0 && senderDelay < 60.0) {
+                    sample.senderDelay = static_cast<int64_t>(senderDelay * 1e9);
+                    LatencyTracer::instance().record(LATENCY_SENDER_TO_RECEIVE, sample.senderDelay);
+                }
+            }
+            sample.receiveTime = receiveTime;
+            sample.captureTime = captureTime;
+
+            // Receive mode: when set only the newest sample of each source is
+            // processed, older queued samples are counted as coalesced and skipped
+            bool coalesce = true;
+            {
+                auto profile = source->profile.read(source->reader);
+                coalesce = !profile || profile->config.coalescePackets;
+            }
+            if (!coalesce) {
+                processTelemetrySample(*source, sample);
+                continue;
+            }
+
+            // Keep only the newest sample; the airframe name is copied because
+            // the parser reuses its storage for the next packet
+            if (source->hasPending) {
+                ++source->coalescedPackets;
+                ++coalescedThisWakeup;
             }
+            source->pending = sample;
+            std::strncpy(source->pendingAirframe, sample.airframe, sizeof(source->pendingAirframe) - 1);
+            source->pendingAirframe[sizeof(source->pendingAirframe) - 1] = '\0';
+            source->pending.airframe = source->pendingAirframe;
+            source->hasPending = true;
+        }
+    } while (!error && received == DATAGRAM_BATCH_SIZE && drained < maxDrainPerWakeup);
 
-            lock.lock();
+    if (coalescedThisWakeup > 0) {
+        LOG_DEBUG("Coalesced {} stale packet(s)", coalescedThisWakeup);
+    }
+    size_t sourceCount = telemetrySources.size();
+    for (size_t i = 0; i < sourceCount; ++i) {
+        TelemetrySource& source = telemetrySources[i];
+        if (source.hasPending) {
+            source.hasPending = false;
+            processTelemetrySample(source, source.pending);
         }
     }
+
+    collectRetiredProfiles();
+    if (error) {
+        LOG_ERROR("Receive failed: {}", error.message());
+        return false;
+    }
+    return true;
 }
 
-// Add this function before main()
-void monitorConfigFile() {
-    using namespace std::chrono_literals;
-    
-    while (!shouldStop) {
+// Interval of the heartbeat timer of the event loop
+constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{250};
+
+// Runs every HEARTBEAT_INTERVAL, also while no telemetry arrives at all:
+// times out sources that went silent and frees the profiles they replaced.
+// Replays time out on their own clock in handleTelemetryWakeup instead.
+void heartbeat(boost::asio::steady_timer& timer) {
+    if (!replayMode && firstWakeupTime != 0) {
+        silenceStaleSources(static_cast<uint64_t>(latencyNow() - firstWakeupTime) / 1000);
+    }
+    collectRetiredProfiles();
+    timer.expires_after(HEARTBEAT_INTERVAL);
+    timer.async_wait([&timer](const boost::system::error_code& error) {
+        if (!error) {
+            heartbeat(timer);
+        }
+    });
+}
+
+// Command line options; without any the program listens on the UDP port
+struct CommandLineOptions {
+    std::string recordPath;      // --record: capture the incoming datagrams
+    std::string replayPath;      // --replay: read telemetry from a capture
+    double syntheticSeconds = 0; // --synthetic: generate a flight of this length
+    std::string syntheticAirframe = "MiG-21Bis";
+    double replaySpeed = 1.0;    // --speed; 0 (--fast) replays as fast as possible
+    std::string decisionsPath;   // --decisions: log every warning decision
+    AudioBackendConfig audio;    // --audio, --audio-speed, --audio-rate, --audio-channels
+};
+
+void printUsage() {
+    LOG_INFO("Usage: DCS_haptic [--record FILE] [--decisions FILE]\n"
+             "                  [--replay FILE | --synthetic SECONDS [--airframe NAME]] [--speed N | --fast]\n"
+             "                  [--audio OUTPUT [--audio-speed N] [--audio-rate HZ] [--audio-channels N]]\n"
+             "  --record FILE      write every received datagram to a capture file\n"
+             "  --replay FILE      read telemetry from a capture instead of UDP port 12345\n"
+             "  --synthetic S      replay a generated flight of S seconds instead\n"
+             "  --airframe NAME    airframe of the generated flight (default MiG-21Bis)\n"
+             "  --speed N          replay N times faster than recorded (default 1)\n"
+             "  --fast             replay as fast as possible\n"
+             "  --decisions FILE   log the warning decision for every sample acted on\n"
+             "  --audio OUTPUT     portaudio (default), null, or wav:FILE to render the mixed output to a file\n"
+             "  --audio-speed N    clock of the null and wav outputs relative to real time, 0 unthrottled\n"
+             "                     (default 1; a replay drives them in step with its telemetry)\n"
+             "  --audio-rate HZ    sample rate of the null and wav outputs (default 48000)\n"
+             "  --audio-channels N channels of the null and wav outputs, up to 8 (default 2)");
+}
+
+bool parseCommandLine(int argc, char** argv, CommandLineOptions& options) {
+    bool audioSpeedGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
         try {
-            auto currentModTime = std::filesystem::last_write_time(currentConfigPath);
-            if (currentModTime != lastConfigModTime) {
-                std::cout << "Configuration file changed, reloading settings..." << std::endl;
-                readConfig(currentAirframe);  // Use currentAirframe instead of currentConfigPath
-                lastConfigModTime = currentModTime;
-                
-                // Reload audio buffers with new settings
-                preprocessAudioData(AOA_warning_audio_file, AOA_warning_start_volume, 
-                                 AOA_warning_balance, AOA_warning_buffer, 
-                                 AOA_warning_sampleRate, AOA_warning_channels);
-                                 
-                preprocessAudioData(Stall_warning_audio_file, Stall_warning_volume, 
-                                 Stall_warning_balance, Stall_warning_buffer,
-                                 Stall_warning_sampleRate, Stall_warning_channels);
+            if (option == "--record" && hasValue) options.recordPath = argv[++i];
+            else if (option == "--replay" && hasValue) options.replayPath = argv[++i];
+            else if (option == "--synthetic" && hasValue) options.syntheticSeconds = std::stod(argv[++i]);
+            else if (option == "--airframe" && hasValue) options.syntheticAirframe = argv[++i];
+            else if (option == "--speed" && hasValue) options.replaySpeed = std::stod(argv[++i]);
+            else if (option == "--fast") options.replaySpeed = 0.0;
+            else if (option == "--decisions" && hasValue) options.decisionsPath = argv[++i];
+            else if (option == "--audio" && hasValue) {
+                if (!parseAudioBackend(argv[++i], options.audio)) {
+                    LOG_ERROR("Unknown audio output: {}", argv[i]);
+                    return false;
+                }
+            }
+            else if (option == "--audio-speed" && hasValue) {
+                options.audio.clockSpeed = std::stod(argv[++i]);
+                audioSpeedGiven = true;
             }
-        } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Error monitoring config file: " << e.what() << std::endl;
+            else if (option == "--audio-rate" && hasValue) options.audio.sampleRate = std::stod(argv[++i]);
+            else if (option == "--audio-channels" && hasValue) options.audio.channels = std::stoi(argv[++i]);
+            else {
+                LOG_ERROR("Unknown or incomplete option: {}", option);
+                return false;
+            }
+        } catch (const std::exception&) {
+            LOG_ERROR("Invalid number for {}: {}", option, argv[i]);
+            return false;
         }
-        
-        // Sleep for 5 seconds before next check
-        std::this_thread::sleep_for(5s);
     }
+    if (!options.replayPath.empty() && options.syntheticSeconds > 0) {
+        LOG_ERROR("--replay and --synthetic cannot be combined");
+        return false;
+    }
+    if (options.audio.sampleRate < 8000.0 || options.audio.clockSpeed < 0.0 || options.audio.channels < 1 ||
+        options.audio.channels > MIX_MAX_OUTPUTS) {
+        LOG_ERROR("--audio-rate must be at least 8000, --audio-speed not negative and --audio-channels 1 to {}",
+                  MIX_MAX_OUTPUTS);
+        return false;
+    }
+    // A rendered replay follows the replayed telemetry unless told
+    // otherwise, so the output is the same at any speed and on every run
+    if (!audioSpeedGiven && (!options.replayPath.empty() || options.syntheticSeconds > 0)) {
+        options.audio.replayClock = std::make_shared<ReplayAudioClock>();
+    }
+    return true;
 }
 
-int main() {
-    std::cout << "Starting program..." << std::endl;
+// bench/pipeline_bench.cpp includes this file with DCS_HAPTIC_NO_MAIN to
+// time the functions above
+#ifndef DCS_HAPTIC_NO_MAIN
+int main(int argc, char** argv) {
+    auto startupBegin = std::chrono::steady_clock::now();
+
+    // Start the background log writer; the exit handler registered first
+    // runs last, so messages from the other exit handlers are still written
+    Logger::instance().start();
+    std::atexit([] { Logger::instance().stop(); });
 
-    // Initialize PortAudio library
+    CommandLineOptions options;
+    if (!parseCommandLine(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    LOG_INFO("Starting program...");
+    LOG_INFO("Audio kernels: {}", simdLevelName(simdLevel()));
+
+    // Telemetry comes from the socket unless a capture or synthetic flight
+    // is replayed
+    TelemetryReplay replay;
+    replayMode = !options.replayPath.empty() || options.syntheticSeconds > 0;
+    replayAudioClock = options.audio.replayClock;
+    if (!options.replayPath.empty() && !replay.load(options.replayPath)) {
+        LOG_ERROR("Could not read telemetry capture {}", options.replayPath);
+        return 1;
+    }
+    if (options.syntheticSeconds > 0) {
+        replay.load(generateSyntheticFlight(options.syntheticAirframe, options.syntheticSeconds,
+                                            SYNTHETIC_PACKET_RATE, latencyWallClock()));
+    }
+    replay.setSpeed(options.replaySpeed);
+    if (!options.recordPath.empty() && !captureRecorder.open(options.recordPath)) {
+        LOG_ERROR("Could not create capture file {}", options.recordPath);
+        return 1;
+    }
+    if (!options.decisionsPath.empty() && !decisionLog.open(options.decisionsPath)) {
+        LOG_ERROR("Could not create decision log {}", options.decisionsPath);
+        return 1;
+    }
+
+    // Initialize PortAudio library; the null and WAV outputs work without it
+    outputs.setBackend(options.audio);
     PaError err = Pa_Initialize();
     if (err != paNoError) {
-        std::cerr << "Failed to initialize PortAudio: " << Pa_GetErrorText(err) << std::endl;
-        return 1;
+        if (!options.audio.isVirtual()) {
+            LOG_ERROR("Failed to initialize PortAudio: {}", Pa_GetErrorText(err));
+            return 1;
+        }
+        LOG_WARNING("Warning: PortAudio unavailable ({}), continuing with the {} output", Pa_GetErrorText(err),
+                    audioBackendName(options.audio.kind));
     }
 
     // Register cleanup function to be called at exit
     std::atexit(cleanupAudio);
 
-    // List available audio devices
-    listAudioDevices();
-
-    readConfig();
-
-    // Convert device indices to actual WASAPI device indices
-    AOA_warning_device_index = findWasapiDevice(AOA_warning_device_index);
-    Stall_warning_device_index = findWasapiDevice(Stall_warning_device_index);
+    deviceRegistry.refresh();
 
-    std::cout << "Using WASAPI device indices: AOA=" << AOA_warning_device_index 
-              << ", Stall=" << Stall_warning_device_index << std::endl;
+    // The default profile is loaded on this thread, which also opens the
+    // output streams up front so the first warning does not pay for it
+    AirframeProfileCache::Profile startupProfile = loadAirframeProfile("");
 
-    // Preprocess audio data with additional error checking
-    std::cout << "\nPreprocessing AOA warning audio..." << std::endl;
-    preprocessAudioData(AOA_warning_audio_file, AOA_warning_start_volume, 
-                       AOA_warning_balance, AOA_warning_buffer, 
-                       AOA_warning_sampleRate, AOA_warning_channels);
-    
-    if (AOA_warning_buffer.empty()) {
-        std::cerr << "Error: AOA warning buffer is empty after preprocessing" << std::endl;
-        return 1;
-    }
+    // List available audio devices of the configured host API
+    listAudioDevices();
 
-    std::cout << "\nPreprocessing Stall warning audio..." << std::endl;
-    preprocessAudioData(Stall_warning_audio_file, Stall_warning_volume, 
-                       Stall_warning_balance, Stall_warning_buffer,
-                       Stall_warning_sampleRate, Stall_warning_channels);
-    
-    if (Stall_warning_buffer.empty()) {
-        std::cerr << "Error: Stall warning buffer is empty after preprocessing" << std::endl;
+    if (!startupProfile) {
+        LOG_ERROR("Error: Could not load the default configuration");
         return 1;
     }
-
-    // Analyze both audio files and calculate safe scaling factors
-    std::cout << "\nAnalyzing warning sound levels..." << std::endl;
-    aoa_warning_scaling = analyzeAudioLevels(AOA_warning_buffer, "AOA Warning");
-    stall_warning_scaling = analyzeAudioLevels(Stall_warning_buffer, "Stall Warning");
-    
-    std::cout << "\nFinal scaling factors:" << std::endl;
-    std::cout << "AOA Warning scaling: " << aoa_warning_scaling << std::endl;
-    std::cout << "Stall Warning scaling: " << stall_warning_scaling << std::endl;
-
-    // Add debug output for buffer state after preprocessing
-    std::cout << "Buffer states after preprocessing:" << std::endl;
-    std::cout << "AOA Warning buffer size: " << AOA_warning_buffer.size() 
-              << ", channels: " << AOA_warning_channels << std::endl;
-    std::cout << "Stall Warning buffer size: " << Stall_warning_buffer.size() 
-              << ", channels: " << Stall_warning_channels << std::endl;
-
-    // Start sound playback thread
-    std::thread playbackThread(soundPlaybackThread);
-    playbackThread.detach();
-
-    // Start configuration file monitoring thread
-    std::thread configMonitor(monitorConfigFile);
-    configMonitor.detach();
-
-    boost::asio::io_context io_context;
-    boost::asio::ip::udp::socket socket(io_context);
-    boost::asio::ip::udp::endpoint local_endpoint(boost::asio::ip::udp::v4(), 12345);
-    boost::system::error_code ec;
-    socket.open(local_endpoint.protocol(), ec);
-    if (ec) {
-        std::cerr << "Failed to open socket: " << ec.message() << std::endl;
-        return 1;
+    if (!startupProfile->config.synthesis) {
+        if (startupProfile->aoaWarning.empty()) {
+            LOG_ERROR("Error: AOA warning buffer is empty after preprocessing");
+            return 1;
+        }
+        if (startupProfile->stallWarning.empty()) {
+            LOG_ERROR("Error: Stall warning buffer is empty after preprocessing");
+            return 1;
+        }
     }
-    socket.bind(local_endpoint, ec);
-    if (ec) {
-        std::cerr << "Failed to bind socket: " << ec.message() << std::endl;
-        return 1;
+    airframeProfiles.insert(startupProfile);
+    // Sources get their profiles as their telemetry arrives
+    applyLogLevel(*startupProfile);
+    logProfile(*startupProfile);
+
+    if (!startupProfile->config.synthesis) {
+        LOG_DEBUG("Buffer states after preprocessing:");
+        LOG_DEBUG("AOA Warning buffer size: {}, channels: {}",
+                  startupProfile->aoaWarning.residentSamples(), startupProfile->aoaWarning.channels);
+        LOG_DEBUG("Stall Warning buffer size: {}, channels: {}",
+                  startupProfile->stallWarning.residentSamples(), startupProfile->stallWarning.channels);
     }
-    std::cout << "Socket opened and bound successfully." << std::endl;
 
-    char recv_buf[1024];
-    boost::asio::ip::udp::endpoint sender_endpoint;
+    // Every other airframe is loaded in the background
+    airframeProfiles.start(loadAirframeProfile, onProfileLoaded);
+    outputs.setDeviceChangeHandler(onAudioDevicesChanged);
+    prefetchAirframeProfiles();
+
+    // Apply edits to the configuration and audio files as they are saved
+    fileWatcher.start(eventLoop, {"configuration", "audio"}, onWatchedFilesChanged);
+    LOG_INFO("Watching configuration/ and audio/ for changes ({})", fileWatcher.backend());
+
+    // Press Enter to log the warning latency measured so far; it is also
+    // logged at exit. Ends quietly when stdin is not a console.
+    std::thread([] {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            LatencyTracer::instance().report();
+        }
+    }).detach();
 
-    while (true) {
-        std::cout << "Waiting to receive data..." << std::endl;
-        boost::system::error_code error;
-        size_t len = socket.receive_from(boost::asio::buffer(recv_buf), sender_endpoint, 0, error);
-        if (error && error != boost::asio::error::message_size) {
-            std::cerr << "Receive failed: " << error.message() << std::endl;
-            break;
-        }
-
-        if (len > 0) {
-            std::string data(recv_buf, len);
-            float IAS, AoA;
-            char airframe[256];
-            sscanf(data.c_str(), "%f,%f,%255s", &IAS, &AoA, airframe);
-            std::cout << "Received data: IAS=" << IAS << ", AoA=" << AoA 
-                      << ", Airframe=" << airframe 
-                      << ", Moving=" << (IAS >= 10.0f ? "yes" : "no") << std::endl;
-
-            // Reload configuration if airframe changes
-            if (currentAirframe != airframe) {
-                std::cout << "Airframe changed from '" << currentAirframe << "' to '" << airframe << "'" << std::endl;
-                currentAirframe = airframe;
-                readConfig(currentAirframe);
-
-                // Reload audio buffers with new configuration
-                std::cout << "Reloading audio buffers for new airframe..." << std::endl;
-                
-                // Clear existing buffers
-                AOA_warning_buffer.clear();
-                Stall_warning_buffer.clear();
-                
-                // Preprocess audio data with the new configuration
-                preprocessAudioData(AOA_warning_audio_file, AOA_warning_start_volume, 
-                                 AOA_warning_balance, AOA_warning_buffer, 
-                                 AOA_warning_sampleRate, AOA_warning_channels);
-                
-                preprocessAudioData(Stall_warning_audio_file, Stall_warning_volume, 
-                                 Stall_warning_balance, Stall_warning_buffer,
-                                 Stall_warning_sampleRate, Stall_warning_channels);
-                
-                // Recalculate scaling factors
-                aoa_warning_scaling = analyzeAudioLevels(AOA_warning_buffer, "AOA Warning");
-                stall_warning_scaling = analyzeAudioLevels(Stall_warning_buffer, "Stall Warning");
-                
-                std::cout << "Audio buffers reloaded for " << currentAirframe << std::endl;
-            }
+    boost::asio::ip::udp::socket socket(eventLoop);
+    if (replayMode) {
+        LOG_INFO("Replaying {} at {}", options.replayPath.empty() ? "a synthetic flight" : options.replayPath,
+                 options.replaySpeed > 0.0 ? std::to_string(options.replaySpeed) + "x speed" : "full speed");
+    } else {
+        boost::asio::ip::udp::endpoint local_endpoint(boost::asio::ip::udp::v4(), 12345);
+        boost::system::error_code ec;
+        socket.open(local_endpoint.protocol(), ec);
+        if (ec) {
+            LOG_ERROR("Failed to open socket: {}", ec.message());
+            return 1;
+        }
+        socket.bind(local_endpoint, ec);
+        if (ec) {
+            LOG_ERROR("Failed to bind socket: {}", ec.message());
+            return 1;
+        }
+        LOG_INFO("Socket opened and bound successfully.");
+    }
 
-            {
-                std::lock_guard<std::mutex> lock(queueMutex);
-                if (soundPlaying) {
-                    stopCurrentSound = true; // Stop the current sound
-                }
-                soundQueue = {}; // Clear the sound queue
+    double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    LOG_INFO("Startup took {} ms (audio cache {}: {} hit(s), {} miss(es)), resident memory: {} KiB",
+             startupMs, startupProfile->config.audioCache ? "on" : "off", pcmCache.hits(), pcmCache.misses(),
+             residentMemoryBytes() / 1024);
+
+    // Telemetry is received on the event loop: each wakeup drains what is
+    // queued and dispatches it by sender, then waits again. A replay waits
+    // for its wakeups on a timer instead and stops the loop at its end.
+    auto receiveBegin = std::chrono::steady_clock::now();
+    std::function<void()> receiveNext;
+    boost::asio::steady_timer replayTimer(eventLoop);
+    if (replayMode) {
+        receiveNext = [&] {
+            if (!replay.nextWakeup()) {
+                eventLoop.stop();
+                return;
             }
-
-            // Only process warnings when aircraft is moving (IAS >= 10)
-            if (IAS >= 10.0f) {
-                if (AoA > AOA_Warning_Start && AoA < Stall_warning) {
-                    float volume = calculateVolume(AoA, AOA_Warning_Start, AOA_Warning_End, 
-                                                AOA_warning_start_volume, AOA_warning_end_volume);
-                    std::cout << "Calculated AOA warning volume: " << volume << " for AoA: " << AoA << std::endl;
-                    {
-                        std::lock_guard<std::mutex> lock(queueMutex);
-                        soundQueue.emplace("audio/" + AOA_warning_audio_file, volume, 
-                                         AOA_warning_balance, AOA_warning_device_index);
-                    }
-                    queueCondition.notify_one();
-                } else if (AoA >= Stall_warning) {
-                    std::cout << "Using stall warning volume: " << Stall_warning_volume << " for AoA: " << AoA << std::endl;
-                    {
-                        std::lock_guard<std::mutex> lock(queueMutex);
-                        soundQueue.emplace("audio/" + Stall_warning_audio_file, Stall_warning_volume, 
-                                         Stall_warning_balance, Stall_warning_device_index);
+            auto replayWakeup = [&] {
+                handleTelemetryWakeup(socket, replay);
+                receiveNext();
+            };
+            // Wakeups that are already due skip the timer, which is most of
+            // them when replaying as fast as possible
+            if (replay.wakeupDue() <= std::chrono::steady_clock::now()) {
+                boost::asio::post(eventLoop, replayWakeup);
+                return;
+            }
+            replayTimer.expires_at(replay.wakeupDue());
+            replayTimer.async_wait([replayWakeup](const boost::system::error_code& error) {
+                if (!error) {
+                    replayWakeup();
+                }
+            });
+        };
+    } else {
+        receiveNext = [&] {
+            LOG_DEBUG("Waiting to receive data...");
+            socket.async_wait(boost::asio::ip::udp::socket::wait_read, [&](const boost::system::error_code& error) {
+                // A reported ICMP error leaves the socket usable; drain it as usual
+                if (error && !isTransientReceiveError(error)) {
+                    if (error != boost::asio::error::operation_aborted) {
+                        LOG_ERROR("Receive failed: {}", error.message());
+                        eventLoop.stop();
                     }
-                    queueCondition.notify_one();
+                    return;
                 }
-            }
-        }
+                if (handleTelemetryWakeup(socket, replay)) {
+                    receiveNext();
+                } else {
+                    eventLoop.stop();
+                }
+            });
+        };
     }
+    receiveNext();
+
+    boost::asio::steady_timer heartbeatTimer(eventLoop);
+    heartbeat(heartbeatTimer);
+
+    // Ctrl+C, SIGTERM and on Windows Ctrl+Break or closing the console end
+    // the loop, so the streams are closed below instead of being cut off
+    boost::asio::signal_set signals(eventLoop, SIGINT, SIGTERM);
+#ifdef SIGBREAK
+    signals.add(SIGBREAK);
+#endif
+    signals.async_wait([](const boost::system::error_code& error, int signal) {
+        if (error) {
+            return;
+        }
+        LOG_INFO("Signal {} received, shutting down...", signal);
+        eventLoop.stop();
+    });
 
-    std::cout << "Program exiting..." << std::endl;
+    eventLoop.run();
 
-    // When exiting, stop the monitoring thread
-    shouldStop = true;
+    if (replayMode) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - receiveBegin).count();
+        if (replay.malformed()) {
+            LOG_WARNING("Warning: The capture ends with a truncated record");
+        }
+        LOG_INFO("Replay finished: {} datagrams in {} s ({} packets/s), {} decisions",
+                 datagramsReceived, seconds, seconds > 0.0 ? datagramsReceived / seconds : 0.0,
+                 decisionLog.decisions());
+    }
+    if (captureRecorder.isOpen()) {
+        LOG_INFO("Recorded {} datagrams to {}", captureRecorder.datagrams(), options.recordPath);
+    }
+    captureRecorder.close();
+    decisionLog.close();
+
+    uint64_t coalescedPackets = 0;
+    uint64_t droppedPackets = 0;
+    for (size_t i = 0; i < telemetrySources.size(); ++i) {
+        coalescedPackets += telemetrySources[i].coalescedPackets;
+        droppedPackets += telemetrySources[i].droppedPackets;
+    }
+    LOG_INFO("Program exiting... ({} telemetry source(s), coalesced packets: {}, dropped packets: {})",
+             telemetrySources.size(), coalescedPackets, droppedPackets);
 
+    // Stop the helper threads and close the streams while everything they
+    // use still exists
+    cleanupAudio();
     return 0;
 }
+#endif  // DCS_HAPTIC_NO_MAIN
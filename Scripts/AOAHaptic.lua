@@ -4,6 +4,131 @@ local socket = require("socket")
 local host, port = "127.0.0.1", 12345
 local udp = socket.udp()
 
+-- Wire format: "binary" (compact, full precision) or "csv" (legacy text)
+local protocol = "binary"
+
+-- Packets per second. DCS Haptic extrapolates AoA from the recent samples,
+-- so a higher rate lets the stall cue start closer to the actual crossing.
+local sendRate = 50
+
+-- Binary format constants, must match telemetry_packet.h
+local MAGIC, VERSION = 0xDC, 1
+local TYPE_SAMPLE, TYPE_AIRFRAME = 1, 2
+local airframeResendInterval = 2.0 -- seconds, so a restarted app relearns the airframe
+
+local sequence = 0
+local airframeIds = {}
+local nextAirframeId = 0
+local currentAirframe = ""
+local lastAirframeSent = -math.huge
+
+-- Little-endian encoders (Lua 5.1 has no string.pack)
+local function encodeU16(n)
+    return string.char(n % 256, math.floor(n / 256) % 256)
+end
+
+local function encodeU32(n)
+    return string.char(n % 256, math.floor(n / 256) % 256,
+                       math.floor(n / 65536) % 256, math.floor(n / 16777216) % 256)
+end
+
+local function encodeF32(x)
+    local sign = 0
+    if x < 0 or (x == 0 and 1 / x < 0) then sign = 0x80; x = -x end
+    local exponent, mantissa
+    if x ~= x then
+        exponent, mantissa = 0xFF, 0x400000
+    elseif x == math.huge then
+        exponent, mantissa = 0xFF, 0
+    elseif x == 0 then
+        exponent, mantissa = 0, 0
+    else
+        local m, e = math.frexp(x)
+        exponent = e + 126
+        if exponent <= 0 then
+            mantissa = math.floor(m * 2 ^ (23 + exponent) + 0.5)
+            exponent = 0
+        elseif exponent >= 0xFF then
+            exponent, mantissa = 0xFF, 0
+        else
+            mantissa = math.floor((m * 2 - 1) * 2 ^ 23 + 0.5)
+            if mantissa == 2 ^ 23 then mantissa = 0; exponent = exponent + 1 end
+        end
+    end
+    return string.char(mantissa % 256, math.floor(mantissa / 256) % 256,
+                       math.floor(mantissa / 65536) % 128 + (exponent % 2) * 128,
+                       sign + math.floor(exponent / 2))
+end
+
+local function encodeF64(x)
+    local sign = 0
+    if x < 0 then sign = 0x80; x = -x end
+    local exponent, mantissa = 0, 0
+    if x ~= 0 then
+        local m, e = math.frexp(x)
+        exponent = e + 1022
+        mantissa = (m * 2 - 1) * 2 ^ 52
+    end
+    local bytes = {}
+    for i = 1, 6 do
+        bytes[i] = mantissa % 256
+        mantissa = math.floor(mantissa / 256)
+    end
+    bytes[7] = mantissa % 16 + (exponent % 16) * 16
+    bytes[8] = sign + math.floor(exponent / 16)
+    return string.char(unpack(bytes))
+end
+
+local function encodeHeader(packetType, airframeId, simTime, payloadLength)
+    return string.char(MAGIC, VERSION, packetType, airframeId) ..
+           encodeU32(sequence) .. encodeF64(socket.gettime()) .. encodeF32(simTime) ..
+           encodeU16(payloadLength) .. encodeU16(0)
+end
+
+local function airframeId(airframe)
+    local id = airframeIds[airframe]
+    if not id then
+        id = nextAirframeId
+        nextAirframeId = (nextAirframeId + 1) % 256
+        airframeIds[airframe] = id
+    end
+    return id
+end
+
+-- Fields after IAS and AoA, in the order of telemetry_packet.h; NaN when
+-- the module does not provide one
+local NaN = 0 / 0
+
+local function extraFields()
+    local accel = LoGetAccelerationUnits()
+    local mech = LoGetMechInfo()
+    local engine = LoGetEngineInfo()
+    local G = accel and accel.y or NaN
+    local gear = mech and mech.gear and mech.gear.value or NaN
+    local flaps = mech and mech.flaps and mech.flaps.value or NaN
+    local rpm = NaN
+    if engine and engine.RPM then
+        rpm = math.max(engine.RPM.left or 0, engine.RPM.right or 0)
+    end
+    return G, gear, flaps, rpm, LoGetVerticalVelocity() or NaN, LoGetAltitudeAboveGroundLevel() or NaN
+end
+
+local function sendBinary(IAS, AoA, airframe, simTime)
+    local id = airframeId(airframe)
+    if airframe ~= currentAirframe or simTime - lastAirframeSent >= airframeResendInterval then
+        local name = string.sub(airframe, 1, 255)
+        udp:send(encodeHeader(TYPE_AIRFRAME, id, simTime, #name) .. name)
+        currentAirframe = airframe
+        lastAirframeSent = simTime
+    end
+    local payload = encodeF32(IAS) .. encodeF32(AoA)
+    for _, value in ipairs({extraFields()}) do
+        payload = payload .. encodeF32(value)
+    end
+    udp:send(encodeHeader(TYPE_SAMPLE, id, simTime, #payload) .. payload)
+    sequence = (sequence + 1) % 4294967296
+end
+
 -- Store original export functions
 local originalLuaExportStart = LuaExportStart
 local originalLuaExportStop = LuaExportStop
@@ -23,9 +148,9 @@ end
 
 -- Modify LuaExportActivityNextEvent
 function LuaExportActivityNextEvent(t)
-    local tNext = t
-    
-    if originalLuaExportActivityNextEvent then 
+    local tNext
+
+    if originalLuaExportActivityNextEvent then
         tNext = originalLuaExportActivityNextEvent(t)
     end
 
@@ -35,11 +160,20 @@ function LuaExportActivityNextEvent(t)
     local airframe = selfData and selfData.Name or ""
 
     if IAS and AoA and airframe ~= "" then
-        local data = string.format("%.2f,%.2f,%s", IAS, AoA, airframe)
-        udp:send(data)
+        if protocol == "binary" then
+            sendBinary(IAS, AoA, airframe, LoGetModelTime() or t)
+        else
+            local data = string.format("%.2f,%.2f,%s", IAS, AoA, airframe)
+            udp:send(data)
+        end
     end
 
-    return tNext or (t + 0.5)
+    -- Keep our rate even if another export script asked for a later call
+    local tOurs = t + 1 / sendRate
+    if tNext == nil or tNext > tOurs then
+        tNext = tOurs
+    end
+    return tNext
 end
 
--- END Export telemetry to own haptic app
\ No newline at end of file
+-- END Export telemetry to own haptic app
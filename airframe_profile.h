@@ -0,0 +1,364 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "channel_routing.h"
+#include "clip_stream.h"
+#include "effect_rules.h"
+#include "haptic_synth.h"
+#include "output_manager.h"
+#include "resampler.h"
+#include "source_route.h"
+
+// Settings parsed from one .cfg file. Keys missing from an airframe file
+// keep the value from default.cfg.
+struct AirframeConfig {
+    float aoaWarningStart = 0.0f;
+    float aoaWarningEnd = 0.0f;
+    float stallWarning = 0.0f;
+    float aoaWarningStartVolume = 0.0f;
+    float aoaWarningEndVolume = 0.0f;
+    float stallWarningVolume = 0.0f;
+    std::string aoaWarningAudioFile;
+    std::string stallWarningAudioFile;
+    int aoaWarningDeviceIndex = 0;
+    int stallWarningDeviceIndex = 0;
+    std::string aoaWarningDeviceName;
+    std::string stallWarningDeviceName;
+    int aoaWarningBalance = 0;
+    int stallWarningBalance = 0;
+    // Output channels per warning on multichannel devices; replaces the balance
+    ChannelRouting aoaWarningRouting;
+    ChannelRouting stallWarningRouting;
+    // AoA extrapolated to when a warning is heard, see aoa_predictor.h
+    bool aoaPrediction = true;
+    float aoaPredictionMaxLookahead = 0.3f;  // seconds
+    float aoaHysteresis = 0.5f;              // degrees below a band edge a warning stops
+    bool coalescePackets = true;
+    // Warnings of a source stop when its telemetry stops for this long; 0 never
+    float telemetryTimeout = 0.5f;  // seconds
+    std::string logLevel;
+    bool audioCache = true;
+    std::string hostApi;  // only read from default.cfg
+    // Source_<n>_* outputs per telemetry sender; only read from default.cfg
+    std::vector<SourceRoute> sources;
+    // Warning_mode=synth replaces the clips with the procedural cue
+    bool synthesis = false;
+    SynthWaveform synthWaveform = SynthWaveform::Sine;
+    float synthStartFrequency = 35.0f;
+    float synthEndFrequency = 55.0f;
+    float synthStartPulseRate = 3.0f;
+    float synthEndPulseRate = 10.0f;
+    float synthStallFrequency = 70.0f;
+    // Effect= lines; those of an airframe file replace the default ones
+    std::vector<EffectRule> effects;
+};
+
+// Cache key of an airframe's profile; the profile of a Source_<n> route
+// gets "@<n>" appended, as it plays on other outputs
+inline std::string profileKey(const std::string& airframe, int route) {
+    return route > 0 ? airframe + "@" + std::to_string(route) : airframe;
+}
+
+// Inverse of profileKey
+inline void splitProfileKey(const std::string& key, std::string& airframe, int& route) {
+    size_t at = key.rfind('@');
+    route = 0;
+    if (at != std::string::npos && at + 1 < key.size() &&
+        key.find_first_not_of("0123456789", at + 1) == std::string::npos) {
+        route = std::atoi(key.c_str() + at + 1);
+    }
+    airframe = route > 0 ? key.substr(0, at) : key;
+}
+
+// One warning clip, ready to play: resident, or streamed from disk if the
+// file is longer than CLIP_STREAM_MIN_FILE_BYTES
+struct WarningSound {
+    int sampleRate = 0;                   // rate of the source file
+    int channels = 0;
+    float scaling = 1.0f;
+    ResampledClipCache::Buffer playback;  // preprocessed, at the device rate
+    std::shared_ptr<StreamedClip> stream;  // set instead of playback
+
+    // Start of the clip as the mixers know it, null if none was loaded
+    const float* clipData() const {
+        if (stream) return stream->head();
+        return playback && !playback->empty() ? playback->data() : nullptr;
+    }
+    bool empty() const { return clipData() == nullptr; }
+    // Samples kept in memory
+    size_t residentSamples() const {
+        if (stream) return stream->headFrames() * channels;
+        return playback ? playback->size() : 0;
+    }
+};
+
+// Everything needed to act on telemetry for one airframe. Built on the
+// loader thread and never modified once published.
+struct AirframeProfile {
+    std::string airframe;  // empty for default.cfg
+    int route = 0;         // Source_<n> route whose outputs it plays on, 0 for none
+    std::string configPath;
+    AirframeConfig config;
+    WarningSound aoaWarning;    // left empty in synthesis mode
+    WarningSound stallWarning;
+    // Streams of the warning devices, kept open while the profile exists
+    OutputLease aoaOutput;
+    OutputLease stallOutput;
+    // config.effects compiled for the receiver; effects play on aoaOutput
+    std::shared_ptr<const EffectRuleSet> effects;
+
+    std::string key() const { return profileKey(airframe, route); }
+};
+
+// Profiles kept in memory; beyond this the least recently used one that no
+// source is pinned to is dropped
+constexpr size_t PROFILE_CACHE_CAPACITY = 16;
+
+// In-memory cache of airframe profiles with a background loader thread.
+//
+// request(), reload() and rebuild() queue work and return immediately; the
+// loader thread reads the config, decodes and converts the audio, stores
+// the finished profile under the cache lock and passes it to the listener.
+// The receiver only ever looks up finished profiles, so switching airframes
+// costs no file or audio I/O on its thread. Profiles are keyed by
+// AirframeProfile::key(), so the "airframe" arguments below may name the
+// profile of a route as well.
+class AirframeProfileCache {
+public:
+    using Profile = std::shared_ptr<const AirframeProfile>;
+    using Loader = std::function<Profile(const std::string& airframe)>;
+    // Derives a new profile from the cached one; returns null to keep it
+    using Rebuild = std::function<Profile(const Profile& current)>;
+    // Called on the loader thread after each profile is stored
+    using Listener = std::function<void(const Profile& profile)>;
+
+    ~AirframeProfileCache() { stop(); }
+
+    void start(Loader loader, Listener listener) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_) return;
+        loader_ = std::move(loader);
+        listener_ = std::move(listener);
+        running_ = true;
+        worker_ = std::thread(&AirframeProfileCache::workerLoop, this);
+    }
+
+    // Stop the loader thread after the load in progress, if any
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            running_ = false;
+            queue_.clear();
+            queued_.clear();
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    // Add a profile that was loaded on the calling thread
+    void insert(const Profile& profile) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        store(profile);
+    }
+
+    // Finished profile for an airframe, or null if it is not loaded yet
+    Profile find(const std::string& airframe) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(airframe);
+        if (it == entries_.end()) {
+            return nullptr;
+        }
+        recent_.splice(recent_.begin(), recent_, it->second.recent);
+        return it->second.profile;
+    }
+
+    // Load an airframe in the background unless it is cached or queued
+    void request(const std::string& airframe) {
+        enqueue(airframe, false);
+    }
+
+    // Load an airframe again, e.g. after its config file changed. The cached
+    // profile stays in use until the new one is published.
+    void reload(const std::string& airframe) {
+        enqueue(airframe, true);
+    }
+
+    // Replace part of a cached profile, e.g. one clip whose audio file
+    // changed, without loading it again. Skipped if the airframe is no
+    // longer cached by the time the loader gets to it.
+    void rebuild(const std::string& airframe, Rebuild rebuild) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_ || entries_.count(airframe) == 0) return;
+            queue_.push_back(Job{airframe, std::move(rebuild), {}});
+        }
+        wake_.notify_one();
+    }
+
+    // Run a task on the loader thread, in order with the queued loads
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            queue_.push_back(Job{std::string(), {}, std::move(task)});
+        }
+        wake_.notify_one();
+    }
+
+    // Keep an airframe's profile cached while a source plays with it, so
+    // reloads after its files change still reach it. Pins are counted and
+    // may be taken before the profile is loaded.
+    void pin(const std::string& airframe) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pins_[airframe];
+    }
+
+    void unpin(const std::string& airframe) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pins_.find(airframe);
+        if (it == pins_.end() || --it->second > 0) return;
+        pins_.erase(it);
+        if (entries_.size() > PROFILE_CACHE_CAPACITY) {
+            evictLeastRecent();
+        }
+    }
+
+    bool contains(const std::string& airframe) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.count(airframe) != 0;
+    }
+
+    // Cached profiles, most recently used first
+    std::vector<Profile> profiles() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Profile> result;
+        for (const std::string& airframe : recent_) {
+            result.push_back(entries_.at(airframe).profile);
+        }
+        return result;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    struct Entry {
+        Profile profile;
+        std::list<std::string>::iterator recent;
+    };
+
+    struct Job {
+        std::string airframe;
+        Rebuild rebuild;              // empty for a full load
+        std::function<void()> task;   // set for post()
+    };
+
+    void enqueue(const std::string& airframe, bool force) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!running_) return;
+            if (!force && entries_.count(airframe) != 0) return;
+            if (!queued_.insert(airframe).second) return;
+            queue_.push_back(Job{airframe, {}, {}});
+        }
+        wake_.notify_one();
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_) {
+            if (queue_.empty()) {
+                wake_.wait(lock);
+                continue;
+            }
+            Job job = std::move(queue_.front());
+            queue_.pop_front();
+
+            if (job.task) {
+                lock.unlock();
+                job.task();
+                lock.lock();
+                continue;
+            }
+
+            Profile profile;
+            if (job.rebuild) {
+                auto it = entries_.find(job.airframe);
+                if (it == entries_.end()) continue;
+                Profile current = it->second.profile;
+                lock.unlock();
+                profile = job.rebuild(current);
+                lock.lock();
+                // A full load queued meanwhile supersedes the rebuild
+                if (queued_.count(job.airframe) != 0) continue;
+            } else {
+                lock.unlock();
+                profile = loader_(job.airframe);
+                lock.lock();
+                queued_.erase(job.airframe);
+            }
+
+            if (profile && running_) {
+                store(profile);
+                lock.unlock();
+                if (listener_) listener_(profile);
+                lock.lock();
+            }
+        }
+    }
+
+    // Requires mutex_
+    void store(const Profile& profile) {
+        const std::string key = profile->key();
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            it->second.profile = profile;
+            recent_.splice(recent_.begin(), recent_, it->second.recent);
+        } else {
+            recent_.push_front(key);
+            entries_[key] = Entry{profile, recent_.begin()};
+            if (entries_.size() > PROFILE_CACHE_CAPACITY) {
+                evictLeastRecent();
+            }
+        }
+    }
+
+    // Requires mutex_. Pinned profiles stay, even beyond the capacity.
+    void evictLeastRecent() {
+        for (auto it = recent_.end(); it != recent_.begin();) {
+            --it;
+            if (pins_.count(*it) != 0) continue;
+            entries_.erase(*it);
+            recent_.erase(it);
+            return;
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::map<std::string, Entry> entries_;
+    std::list<std::string> recent_;  // most recently used first
+    std::deque<Job> queue_;
+    std::set<std::string> queued_;  // airframes with a full load queued
+    std::map<std::string, size_t> pins_;
+    Loader loader_;
+    Listener listener_;
+    bool running_ = false;
+    std::thread worker_;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+// Heap allocation counter used to check that the packet -> sound hot path
+// stays allocation free. Only bench/pipeline_bench.cpp includes it, with
+// DCS_HAPTIC_COUNT_ALLOCATIONS set to 1; the program itself keeps the
+// standard allocator and does not count.
+//
+// When enabled this header replaces the global operator new/delete, so it
+// must only be included from a single translation unit.
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#ifndef DCS_HAPTIC_COUNT_ALLOCATIONS
+#define DCS_HAPTIC_COUNT_ALLOCATIONS 0
+#endif
+
+// The replacements are kept out of line: inlined, free() would meet the
+// pointer from operator new and trip -Wmismatched-new-delete
+#if defined(__GNUC__)
+#define DCS_HAPTIC_NOINLINE __attribute__((noinline))
+#else
+#define DCS_HAPTIC_NOINLINE
+#endif
+
+#if DCS_HAPTIC_COUNT_ALLOCATIONS
+
+// Allocations made by the calling thread
+inline thread_local uint64_t threadAllocationCount = 0;
+
+inline uint64_t allocationCount() {
+    return threadAllocationCount;
+}
+
+// The array, sized and nothrow forms default to these two
+DCS_HAPTIC_NOINLINE void* operator new(std::size_t size) {
+    ++threadAllocationCount;
+    if (size == 0) size = 1;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+DCS_HAPTIC_NOINLINE void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+DCS_HAPTIC_NOINLINE void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+#else
+
+inline uint64_t allocationCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Gains of the alpha-beta tracker. DCS reports AoA with little noise, so
+// the filter follows the measurement closely and mostly serves to estimate
+// the rate.
+constexpr float AOA_PREDICTOR_ALPHA = 0.7f;
+constexpr float AOA_PREDICTOR_BETA = 0.25f;
+// Samples further apart than this restart the tracker (pause, reconnect)
+constexpr double AOA_PREDICTOR_MAX_GAP = 1.0;
+// Receive-to-DAC latency assumed until the latency trace has measured it,
+// and always in replays so their decisions stay reproducible
+constexpr double AOA_PREDICTOR_NOMINAL_LATENCY = 0.04;
+
+// Alpha-beta tracker of the AoA of one telemetry source and its rate, used
+// to extrapolate the AoA to when a warning sent now is heard
+class AoaPredictor {
+public:
+    // Forget the previous flight, so predict() before the next update()
+    // does not extrapolate with its rate
+    void reset() {
+        initialized_ = false;
+        time_ = 0.0;
+        angle_ = 0.0f;
+        rate_ = 0.0f;
+        interval_ = 0.0;
+    }
+
+    // Feed a sample taken at time seconds on the sender's clock
+    void update(double time, float AoA) {
+        double dt = time - time_;
+        if (!initialized_ || dt <= 0.0 || dt > AOA_PREDICTOR_MAX_GAP || !std::isfinite(AoA)) {
+            initialized_ = std::isfinite(AoA);
+            time_ = time;
+            angle_ = AoA;
+            rate_ = 0.0f;
+            interval_ = 0.0;
+            return;
+        }
+        float predicted = angle_ + rate_ * static_cast<float>(dt);
+        float residual = AoA - predicted;
+        angle_ = predicted + AOA_PREDICTOR_ALPHA * residual;
+        rate_ += AOA_PREDICTOR_BETA * residual / static_cast<float>(dt);
+        // The first interval seeds the average
+        interval_ = interval_ > 0.0 ? interval_ + 0.1 * (dt - interval_) : dt;
+        time_ = time;
+    }
+
+    // AoA lookahead seconds after the last sample; the last sample itself
+    // until the rate is known
+    float predict(double lookahead) const {
+        if (interval_ <= 0.0) return angle_;
+        return angle_ + rate_ * static_cast<float>(lookahead);
+    }
+
+    float rate() const { return rate_; }
+    // Average time between samples, 0 until two have arrived
+    double interval() const { return interval_; }
+
+private:
+    bool initialized_ = false;
+    double time_ = 0.0;
+    float angle_ = 0.0f;
+    float rate_ = 0.0f;      // degrees per second
+    double interval_ = 0.0;
+};
+
+// Which warning applies to an AoA
+enum class WarningBand : unsigned char {
+    Idle,
+    Aoa,
+    Stall
+};
+
+// Band for AoA given the band of the previous sample. A warning keeps
+// playing until AoA drops hysteresis degrees below the edge that started
+// it, so AoA hovering at an edge does not toggle the cue every packet.
+inline WarningBand classifyWarningBand(float IAS, float AoA, float aoaWarningStart, float stallWarning,
+                                       float hysteresis, WarningBand previous) {
+    // Only warn when the aircraft is moving
+    if (IAS < 10.0f) return WarningBand::Idle;
+    float stallEdge = previous == WarningBand::Stall ? stallWarning - hysteresis : stallWarning;
+    if (AoA >= stallEdge) return WarningBand::Stall;
+    float warningEdge = previous != WarningBand::Idle ? aoaWarningStart - hysteresis : aoaWarningStart;
+    if (AoA > warningEdge) return WarningBand::Aoa;
+    return WarningBand::Idle;
+}
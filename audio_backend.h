@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "portaudio.h"
+#include "sndfile.h"
+#include "dsp_kernels.h"
+#include "logger.h"
+
+// Producer of the samples a backend plays; implemented by AudioMixer
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+    // Fill frames of interleaved output. dacDelay is how long after this
+    // call the block is heard, in nanoseconds, or 0 if unknown.
+    virtual void render(float* out, unsigned long frameCount, int64_t dacDelay = 0) = 0;
+};
+
+// Where a mixer's output goes. open() settles the format, start() begins
+// pulling blocks from the source on the backend's own thread, close() stops
+// and waits for it.
+class AudioBackend {
+public:
+    virtual ~AudioBackend() = default;
+    virtual bool open(int deviceIndex) = 0;
+    // onStreamLost is called from the backend's thread if the output stops
+    // without close(), e.g. because the device was unplugged
+    virtual bool start(AudioSource& source, std::function<void()> onStreamLost) = 0;
+    virtual void close() = 0;
+    virtual int channels() const = 0;
+    virtual double sampleRate() const = 0;
+};
+
+enum class AudioBackendKind : uint8_t {
+    PortAudio,  // the configured output devices
+    Null,       // discard the output
+    WavFile     // write the mixed output to a file
+};
+
+// Device index of the single output the virtual backends provide; every
+// warning is routed to it
+constexpr int VIRTUAL_OUTPUT_DEVICE = 0;
+// Block size of the backends that run on a virtual clock
+constexpr unsigned long VIRTUAL_BLOCK_FRAMES = 256;
+
+// Clock of a replay, which the virtual backends follow instead of real time
+// so a rendered replay does not depend on thread scheduling. Before each
+// wakeup is handled the replay advances it to the wakeup's capture time; a
+// following backend renders exactly the blocks that start before that time
+// and then waits, so the commands of a sample always reach the same block.
+class ReplayAudioClock {
+public:
+    // Replay side: let the followers render up to micros and wait until
+    // they have
+    void advanceTo(uint64_t micros) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        nowMicros_ = micros;
+        changed_.notify_all();
+        changed_.wait(lock, [this] {
+            for (const Follower& follower : followers_) {
+                if (follower.active && follower.nextMicros < nowMicros_) return false;
+            }
+            return true;
+        });
+    }
+
+    // Render side. A follower starts at the clock's current time; the id
+    // is passed to the calls below.
+    size_t follow() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t id = 0;
+        while (id < followers_.size() && followers_[id].active) ++id;
+        if (id == followers_.size()) followers_.emplace_back();
+        followers_[id] = Follower{true, nowMicros_, nowMicros_};
+        return id;
+    }
+
+    // Wait until the block starting offsetMicros after the follower's start
+    // may be rendered. Returns false once the follower was removed.
+    bool awaitBlock(size_t id, uint64_t offsetMicros) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // By index: follow() may move the followers while this one waits
+        followers_[id].nextMicros = followers_[id].startMicros + offsetMicros;
+        changed_.notify_all();
+        changed_.wait(lock, [&] { return !followers_[id].active || followers_[id].nextMicros < nowMicros_; });
+        return followers_[id].active;
+    }
+
+    // Stop waiting for a follower and release its render thread
+    void unfollow(size_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        followers_[id].active = false;
+        changed_.notify_all();
+    }
+
+private:
+    struct Follower {
+        bool active = false;
+        uint64_t startMicros = 0;
+        uint64_t nextMicros = 0;  // start of the next block to render
+    };
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    uint64_t nowMicros_ = 0;
+    std::vector<Follower> followers_;
+};
+
+struct AudioBackendConfig {
+    AudioBackendKind kind = AudioBackendKind::PortAudio;
+    std::string wavPath;         // WavFile only
+    double clockSpeed = 1.0;     // virtual clock relative to real time; 0 renders unthrottled
+    std::shared_ptr<ReplayAudioClock> replayClock;  // replaces clockSpeed when set
+    double sampleRate = 48000.0; // format of the virtual backends
+    int channels = 2;            // 1 to MIX_MAX_OUTPUTS
+
+    bool isVirtual() const { return kind != AudioBackendKind::PortAudio; }
+};
+
+// Parse "portaudio", "null" or "wav:<file>"
+inline bool parseAudioBackend(const std::string& spec, AudioBackendConfig& config) {
+    if (spec == "portaudio") {
+        config.kind = AudioBackendKind::PortAudio;
+    } else if (spec == "null") {
+        config.kind = AudioBackendKind::Null;
+    } else if (spec.compare(0, 4, "wav:") == 0 && spec.size() > 4) {
+        config.kind = AudioBackendKind::WavFile;
+        config.wavPath = spec.substr(4);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* audioBackendName(AudioBackendKind kind) {
+    switch (kind) {
+        case AudioBackendKind::PortAudio: return "PortAudio";
+        case AudioBackendKind::Null: return "null sink";
+        case AudioBackendKind::WavFile: return "WAV file";
+        default: return "?";
+    }
+}
+
+// One callback stream on a PortAudio output device
+class PortAudioBackend : public AudioBackend {
+public:
+    ~PortAudioBackend() override { close(); }
+
+    bool open(int deviceIndex) override {
+        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(deviceIndex);
+        if (!deviceInfo) {
+            LOG_ERROR("Error: Could not get device info for index {}", deviceIndex);
+            return false;
+        }
+
+        const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
+        LOG_INFO("Using audio device: {} with API: {}\nDevice sample rate: {}",
+                 deviceInfo->name, hostApiInfo->name, deviceInfo->defaultSampleRate);
+
+        deviceIndex_ = deviceIndex;
+        deviceName_ = deviceInfo->name;
+        // Every channel up to 7.1, so routed warnings reach each transducer
+        // through this one stream
+        channels_ = std::min(std::max(deviceInfo->maxOutputChannels, 1), MIX_MAX_OUTPUTS);
+
+        PaStreamParameters outputParameters;
+        outputParameters.device = deviceIndex;
+        outputParameters.channelCount = channels_;
+        outputParameters.sampleFormat = paFloat32;
+        outputParameters.suggestedLatency = deviceInfo->defaultLowOutputLatency;
+        outputParameters.hostApiSpecificStreamInfo = nullptr;
+
+        PaError err = Pa_OpenStream(&stream_,
+                                    nullptr,
+                                    &outputParameters,
+                                    deviceInfo->defaultSampleRate,
+                                    paFramesPerBufferUnspecified,
+                                    paClipOff,
+                                    &PortAudioBackend::streamCallback,
+                                    this);
+        if (err != paNoError) {
+            LOG_ERROR("Error opening stream: {}", Pa_GetErrorText(err));
+            stream_ = nullptr;
+            return false;
+        }
+
+        // Clips are resampled to the rate the stream actually runs at
+        const PaStreamInfo* streamInfo = Pa_GetStreamInfo(stream_);
+        sampleRate_ = streamInfo && streamInfo->sampleRate > 0.0 ? streamInfo->sampleRate
+                                                                 : deviceInfo->defaultSampleRate;
+        return true;
+    }
+
+    bool start(AudioSource& source, std::function<void()> onStreamLost) override {
+        source_ = &source;
+        onStreamLost_ = std::move(onStreamLost);
+        closing_.store(false, std::memory_order_relaxed);
+        Pa_SetStreamFinishedCallback(stream_, &PortAudioBackend::streamFinished);
+
+        PaError err = Pa_StartStream(stream_);
+        if (err != paNoError) {
+            LOG_ERROR("Error starting stream: {}", Pa_GetErrorText(err));
+            close();
+            return false;
+        }
+
+        LOG_INFO("Audio stream initialized for device {} ({} channels)", deviceName_, channels_);
+        return true;
+    }
+
+    void close() override {
+        if (stream_ != nullptr) {
+            closing_.store(true, std::memory_order_relaxed);
+            Pa_StopStream(stream_);
+            Pa_CloseStream(stream_);
+            stream_ = nullptr;
+        }
+    }
+
+    int channels() const override { return channels_; }
+    double sampleRate() const override { return sampleRate_; }
+
+private:
+    static int streamCallback(const void*, void* output, unsigned long frameCount,
+                              const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags, void* userData) {
+        // Some host APIs report no DAC time; the trace then ends at the callback
+        int64_t dacDelay = 0;
+        if (timeInfo && timeInfo->outputBufferDacTime > timeInfo->currentTime && timeInfo->currentTime > 0.0) {
+            dacDelay = static_cast<int64_t>((timeInfo->outputBufferDacTime - timeInfo->currentTime) * 1e9);
+        }
+        static_cast<PortAudioBackend*>(userData)->source_->render(static_cast<float*>(output), frameCount, dacDelay);
+        return paContinue;
+    }
+
+    static void streamFinished(void* userData) {
+        auto* backend = static_cast<PortAudioBackend*>(userData);
+        if (!backend->closing_.load(std::memory_order_relaxed)) {
+            LOG_WARNING("Warning: Output stream for device {} stopped unexpectedly", backend->deviceIndex_);
+            if (backend->onStreamLost_) backend->onStreamLost_();
+        }
+    }
+
+    PaStream* stream_ = nullptr;
+    int deviceIndex_ = -1;
+    std::string deviceName_;
+    int channels_ = 2;
+    double sampleRate_ = 0.0;
+    AudioSource* source_ = nullptr;
+    std::function<void()> onStreamLost_;
+    std::atomic<bool> closing_{false};
+};
+
+// Backend without hardware: a thread renders VIRTUAL_BLOCK_FRAMES at a time
+// and paces itself on a virtual clock running clockSpeed times real time,
+// or as fast as it can with a clock speed of 0, or follows a replay's
+// clock. Subclasses consume the rendered blocks.
+class VirtualClockBackend : public AudioBackend {
+public:
+    explicit VirtualClockBackend(const AudioBackendConfig& config)
+        : channels_(config.channels), sampleRate_(config.sampleRate), clockSpeed_(config.clockSpeed),
+          replayClock_(config.replayClock) {}
+
+    bool open(int) override { return true; }
+
+    bool start(AudioSource& source, std::function<void()>) override {
+        block_.assign(VIRTUAL_BLOCK_FRAMES * channels_, 0.0f);
+        running_.store(true, std::memory_order_relaxed);
+        if (replayClock_) {
+            follower_ = replayClock_->follow();
+        }
+        thread_ = std::thread([this, &source] { renderLoop(source); });
+        return true;
+    }
+
+    void close() override {
+        running_.store(false, std::memory_order_relaxed);
+        if (thread_.joinable()) {
+            if (replayClock_) {
+                replayClock_->unfollow(follower_);
+            }
+            thread_.join();
+        }
+    }
+
+    int channels() const override { return channels_; }
+    double sampleRate() const override { return sampleRate_; }
+
+    uint64_t framesRendered() const { return framesRendered_.load(std::memory_order_relaxed); }
+
+protected:
+    // Called on the render thread with every block
+    virtual void consume(const float* block, unsigned long frames) = 0;
+
+private:
+    void renderLoop(AudioSource& source) {
+        if (replayClock_) {
+            // Block start times come from the frame count, so they do not
+            // drift with rounding
+            for (uint64_t frames = 0;; frames += VIRTUAL_BLOCK_FRAMES) {
+                if (!replayClock_->awaitBlock(follower_, static_cast<uint64_t>(frames * 1e6 / sampleRate_))) break;
+                source.render(block_.data(), VIRTUAL_BLOCK_FRAMES);
+                consume(block_.data(), VIRTUAL_BLOCK_FRAMES);
+                framesRendered_.fetch_add(VIRTUAL_BLOCK_FRAMES, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        auto blockDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(clockSpeed_ > 0.0 ? VIRTUAL_BLOCK_FRAMES / (sampleRate_ * clockSpeed_) : 0.0));
+        auto next = std::chrono::steady_clock::now();
+        while (running_.load(std::memory_order_relaxed)) {
+            source.render(block_.data(), VIRTUAL_BLOCK_FRAMES);
+            consume(block_.data(), VIRTUAL_BLOCK_FRAMES);
+            framesRendered_.fetch_add(VIRTUAL_BLOCK_FRAMES, std::memory_order_relaxed);
+            if (clockSpeed_ > 0.0) {
+                next += blockDuration;
+                std::this_thread::sleep_until(next);
+            }
+        }
+    }
+
+    int channels_;
+    double sampleRate_;
+    double clockSpeed_;
+    std::shared_ptr<ReplayAudioClock> replayClock_;
+    size_t follower_ = 0;
+    std::vector<float> block_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> framesRendered_{0};
+    std::thread thread_;
+};
+
+// Discards the output; for running without audio hardware and for
+// measuring throughput
+class NullAudioBackend : public VirtualClockBackend {
+public:
+    using VirtualClockBackend::VirtualClockBackend;
+    ~NullAudioBackend() override { close(); }
+
+protected:
+    void consume(const float*, unsigned long) override {}
+};
+
+// Writes the exact mixed output to a 32-bit float WAV file. The file is
+// started again whenever the stream is opened.
+class WavFileBackend : public VirtualClockBackend {
+public:
+    explicit WavFileBackend(const AudioBackendConfig& config) : VirtualClockBackend(config), path_(config.wavPath) {}
+    ~WavFileBackend() override { close(); }
+
+    bool open(int deviceIndex) override {
+        SF_INFO info = {};
+        info.samplerate = static_cast<int>(sampleRate());
+        info.channels = channels();
+        info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+        file_ = sf_open(path_.c_str(), SFM_WRITE, &info);
+        if (!file_) {
+            LOG_ERROR("Error: Could not create {}: {}", path_, sf_strerror(nullptr));
+            return false;
+        }
+        LOG_INFO("Rendering output to {} ({} Hz, {} channels)", path_, info.samplerate, info.channels);
+        return VirtualClockBackend::open(deviceIndex);
+    }
+
+    void close() override {
+        VirtualClockBackend::close();
+        if (file_) {
+            sf_close(file_);
+            file_ = nullptr;
+        }
+    }
+
+protected:
+    void consume(const float* block, unsigned long frames) override {
+        sf_writef_float(file_, block, static_cast<sf_count_t>(frames));
+    }
+
+private:
+    std::string path_;
+    SNDFILE* file_ = nullptr;
+};
+
+inline std::unique_ptr<AudioBackend> createAudioBackend(const AudioBackendConfig& config) {
+    switch (config.kind) {
+        case AudioBackendKind::Null: return std::make_unique<NullAudioBackend>(config);
+        case AudioBackendKind::WavFile: return std::make_unique<WavFileBackend>(config);
+        default: return std::make_unique<PortAudioBackend>();
+    }
+}
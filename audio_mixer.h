@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "audio_backend.h"
+#include "channel_routing.h"
+#include "clip_stream.h"
+#include "command_ring.h"
+#include "dsp_kernels.h"
+#include "haptic_synth.h"
+#include "latency_trace.h"
+#include "logger.h"
+
+// Warning ids, also used as the voice slot in each device mixer. Clips use
+// the slots below WARNING_SYNTH, synthesized cues the rest.
+enum WarningId : uint8_t {
+    WARNING_AOA = 0,
+    WARNING_STALL = 1,
+    WARNING_SYNTH = 2,   // procedural cue, see HapticSynth
+    WARNING_EFFECT = 3,  // first of the effect cues, see effect_rules.h
+    WARNING_COUNT = WARNING_EFFECT + 4
+};
+
+// Telemetry sources a mixer keeps apart: each source has its own voice per
+// warning, so cockpits sharing a device do not cut off each other's cues
+constexpr int MIXER_SOURCES = 4;
+
+constexpr int MIXER_CLIP_VOICES = WARNING_SYNTH;  // per source
+constexpr int MIXER_SYNTH_VOICES = WARNING_COUNT - WARNING_SYNTH;
+constexpr int MIXER_EFFECT_VOICES = WARNING_COUNT - WARNING_EFFECT;
+// Voice v of a mixer is warning v % WARNING_COUNT of source v / WARNING_COUNT
+constexpr int MIXER_MAX_VOICES = MIXER_SOURCES * WARNING_COUNT;
+static_assert(MIXER_MAX_VOICES <= 32, "voice masks are 32 bits");
+
+// Frames of the routed synth cue rendered at a time before routing
+constexpr size_t MIXER_SYNTH_BLOCK_FRAMES = 256;
+
+enum class SoundOp : uint8_t {
+    Play,
+    Stop,
+    Synth  // set the targets of the synthesized cue
+};
+
+// Command sent from the UDP receiver to a device mixer. Plain data so it can
+// travel through the voice's lock-free slot; the clip fields point at the
+// preprocessed warning buffer to play, or the head of a streamed clip with
+// stream set to the source's stream of it; the synth fields drive
+// WARNING_SYNTH and the effect cues.
+struct SoundCommand {
+    SoundOp op = SoundOp::Stop;
+    uint8_t warning = WARNING_AOA;
+    uint8_t source = 0;  // telemetry source, below MIXER_SOURCES
+    int16_t balance = 0;
+    float volume = 0.0f;
+    int deviceIndex = -1;
+    const float* data = nullptr;
+    uint32_t frames = 0;
+    ClipStream* stream = nullptr;  // streamed clip, played until stopped
+    uint16_t channels = 0;
+    float scaling = 1.0f;
+    float frequency = 0.0f;
+    float pulseRate = 0.0f;
+    SynthWaveform waveform = SynthWaveform::Sine;
+    ChannelRouting routing;  // replaces balance when routed
+    LatencyTrace trace;
+};
+
+// Voice state, only touched from the audio callback
+struct Voice {
+    bool active = false;
+    bool stopping = false;
+    const float* data = nullptr;
+    size_t frames = 0;
+    ClipStream* stream = nullptr;  // data and frames unused when set
+    int channels = 0;
+    size_t position = 0;
+    // Routing matrices, see mixMatrixRamp; balance is a matrix onto the
+    // first two outputs
+    float gain[MIX_MATRIX_SIZE] = {};
+    float target[MIX_MATRIX_SIZE] = {};
+};
+
+// Synthesized cue, only touched from the audio callback. A routed cue is
+// rendered mono and spread over the outputs through its matrix.
+struct SynthVoice {
+    HapticSynth synth;
+    bool routed = false;
+    float gain[MIX_MATRIX_SIZE] = {};
+    float target[MIX_MATRIX_SIZE] = {};
+};
+
+// Mixer owning one persistent output stream on a single device, played
+// through an AudioBackend. Voices are pulled block by block, so gain changes
+// and stops take effect within one audio buffer instead of at the end of a
+// clip.
+class AudioMixer : public AudioSource {
+public:
+    ~AudioMixer() override { close(); }
+
+    // Open the backend for a device and start it. onStreamLost is called
+    // from the backend's thread if the stream stops without close(), e.g.
+    // because the device was unplugged.
+    bool open(std::unique_ptr<AudioBackend> backend, int deviceIndex, std::function<void()> onStreamLost = {}) {
+        deviceIndex_ = deviceIndex;
+        if (!backend->open(deviceIndex)) {
+            return false;
+        }
+
+        // The format is settled before the first block is rendered
+        channels_ = backend->channels();
+        sampleRate_ = backend->sampleRate();
+        for (SynthVoice& synth : synths_) {
+            synth.synth.prepare(sampleRate_);
+        }
+        onStreamLost_ = std::move(onStreamLost);
+        running_.store(true, std::memory_order_release);
+
+        backend_ = std::move(backend);
+        if (!backend_->start(*this, [this] { streamLost(); })) {
+            running_.store(false, std::memory_order_release);
+            backend_.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (backend_) {
+            backend_->close();
+            backend_.reset();
+            running_.store(false, std::memory_order_release);
+        }
+    }
+
+    // Hand a command to the audio callback. Must only be called from the
+    // single producer thread. It replaces a command for the same voice that
+    // was not applied yet, so the newest one always wins and none is lost.
+    void post(const SoundCommand& command) {
+        if (command.warning < WARNING_COUNT && command.source < MIXER_SOURCES) {
+            commands_[command.source * WARNING_COUNT + command.warning].store(command);
+        }
+    }
+
+    bool isPlaying(int voice) const {
+        return (activeMask_.load(std::memory_order_acquire) & (1u << voice)) != 0;
+    }
+
+    bool isIdle() const {
+        return activeMask_.load(std::memory_order_acquire) == 0;
+    }
+
+    // Number of buffers rendered so far, used to wait for commands to be applied
+    uint64_t blocksRendered() const {
+        return blocksRendered_.load(std::memory_order_acquire);
+    }
+
+    // True if a voice was playing the clip starting at data after the last
+    // rendered buffer
+    bool isPlayingClip(const float* data) const {
+        for (const auto& voiceData : voiceData_) {
+            if (voiceData.load(std::memory_order_acquire) == data) return true;
+        }
+        return false;
+    }
+
+    bool isOpen() const { return backend_ != nullptr; }
+    // False once the stream was closed or stopped on its own; a stopped
+    // mixer renders no more blocks and plays nothing
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    int deviceIndex() const { return deviceIndex_; }
+    int channels() const { return channels_; }
+    double sampleRate() const { return sampleRate_; }
+
+    // Mix all active voices into an interleaved output buffer. dacDelay is
+    // how long after this call the buffer is played, in nanoseconds, and
+    // only feeds the latency trace.
+    void render(float* out, unsigned long frameCount, int64_t dacDelay = 0) override {
+        int64_t callbackTime = latencyNow();
+        applyPendingCommands();
+
+        for (unsigned long i = 0; i < frameCount * channels_; ++i) {
+            out[i] = 0.0f;
+        }
+
+        unsigned mask = 0;
+        for (int c = 0; c < MIXER_SOURCES * MIXER_CLIP_VOICES; ++c) {
+            Voice& voice = voices_[c];
+            if (!voice.active) continue;
+
+            // Ramp gains linearly across the block to avoid zipper noise
+            float step[MIX_MATRIX_SIZE];
+            for (int i = 0; i < MIX_MATRIX_SIZE; ++i) {
+                if (voice.stopping) voice.target[i] = 0.0f;
+                step[i] = (voice.target[i] - voice.gain[i]) / frameCount;
+            }
+
+            if (voice.stream) {
+                renderStream(voice, out, frameCount, step);
+            } else {
+                size_t frames = voice.frames - voice.position;
+                if (frames > frameCount) frames = frameCount;
+                mixMatrixRamp(out, channels_, voice.data + voice.position * voice.channels, voice.channels,
+                              frames, voice.gain, step);
+                voice.position += frames;
+            }
+
+            std::copy(voice.target, voice.target + MIX_MATRIX_SIZE, voice.gain);
+            if (voice.stopping || (!voice.stream && voice.position >= voice.frames)) {
+                voice.active = false;
+                voice.stopping = false;
+            } else {
+                mask |= 1u << clipVoice(c);
+            }
+        }
+
+        for (int s = 0; s < MIXER_SOURCES * MIXER_SYNTH_VOICES; ++s) {
+            SynthVoice& synth = synths_[s];
+            if (synth.routed) {
+                renderRoutedSynth(synth, out, frameCount);
+            } else {
+                synth.synth.render(out, channels_, frameCount);
+            }
+            if (synth.synth.active()) {
+                mask |= 1u << synthVoice(s);
+            }
+        }
+
+        for (int c = 0; c < MIXER_SOURCES * MIXER_CLIP_VOICES; ++c) {
+            voiceData_[c].store(voices_[c].active ? voices_[c].data : nullptr, std::memory_order_release);
+        }
+
+        activeMask_.store(mask, std::memory_order_release);
+        blocksRendered_.fetch_add(1, std::memory_order_release);
+
+        if (tracedMask_ != 0) {
+            int64_t writtenTime = latencyNow();
+            for (int v = 0; v < MIXER_MAX_VOICES; ++v) {
+                if (tracedMask_ & (1u << v)) {
+                    LatencyTracer::instance().recordPlayback(latest_[v].trace, callbackTime, writtenTime, dacDelay);
+                }
+            }
+            tracedMask_ = 0;
+        }
+    }
+
+private:
+    // Voice numbers of the clip and synth voice slots
+    static int clipVoice(int clip) {
+        return clip / MIXER_CLIP_VOICES * WARNING_COUNT + clip % MIXER_CLIP_VOICES;
+    }
+    static int synthVoice(int synth) {
+        return synth / MIXER_SYNTH_VOICES * WARNING_COUNT + WARNING_SYNTH + synth % MIXER_SYNTH_VOICES;
+    }
+
+    // Render the synth cue mono and spread it over the outputs through its
+    // routing, ramping the matrix across the whole buffer
+    void renderRoutedSynth(SynthVoice& voice, float* out, unsigned long frameCount) {
+        if (!voice.synth.active()) {
+            std::copy(voice.target, voice.target + MIX_MATRIX_SIZE, voice.gain);
+            return;
+        }
+        float step[MIX_MATRIX_SIZE];
+        for (int i = 0; i < MIX_MATRIX_SIZE; ++i) {
+            step[i] = (voice.target[i] - voice.gain[i]) / frameCount;
+        }
+        for (unsigned long done = 0; done < frameCount;) {
+            size_t frames = frameCount - done;
+            if (frames > MIXER_SYNTH_BLOCK_FRAMES) frames = MIXER_SYNTH_BLOCK_FRAMES;
+            std::fill(synthBlock_, synthBlock_ + frames, 0.0f);
+            voice.synth.render(synthBlock_, 1, frames);
+            // Continue the ramp where the previous chunk ended
+            float gain[MIX_MATRIX_SIZE];
+            for (int i = 0; i < MIX_MATRIX_SIZE; ++i) {
+                gain[i] = voice.gain[i] + step[i] * done;
+            }
+            mixMatrixRamp(out + done * channels_, channels_, synthBlock_, 1, frames, gain, step);
+            done += frames;
+        }
+        std::copy(voice.target, voice.target + MIX_MATRIX_SIZE, voice.gain);
+    }
+
+    // Mix a streamed clip in the pieces its stream hands out, continuing the
+    // ramp across them. If the next chunk is not decoded yet the rest of the
+    // buffer stays silent.
+    void renderStream(Voice& voice, float* out, unsigned long frameCount, const float* step) {
+        for (unsigned long done = 0; done < frameCount;) {
+            const float* data = nullptr;
+            size_t frames = voice.stream->peek(data, frameCount - done);
+            if (frames == 0) break;
+            float gain[MIX_MATRIX_SIZE];
+            for (int i = 0; i < MIX_MATRIX_SIZE; ++i) {
+                gain[i] = voice.gain[i] + step[i] * done;
+            }
+            mixMatrixRamp(out + done * channels_, channels_, data, voice.channels, frames, gain, step);
+            voice.stream->advance(frames);
+            done += frames;
+        }
+    }
+
+    void streamLost() {
+        running_.store(false, std::memory_order_release);
+        if (onStreamLost_) onStreamLost_();
+    }
+
+    // Take the newest command posted for each voice since the last buffer,
+    // so a burst of packets never queues up stale playback
+    void applyPendingCommands() {
+        bool pending[MIXER_MAX_VOICES];
+        for (int v = 0; v < MIXER_MAX_VOICES; ++v) {
+            pending[v] = commands_[v].take(latest_[v]);
+            // Traced once its block is written
+            if (pending[v]) tracedMask_ |= 1u << v;
+        }
+
+        for (int s = 0; s < MIXER_SOURCES * MIXER_SYNTH_VOICES; ++s) {
+            SynthVoice& synth = synths_[s];
+            if (!pending[synthVoice(s)]) continue;
+
+            const SoundCommand& latest = latest_[synthVoice(s)];
+            if (latest.op != SoundOp::Synth) {
+                synth.synth.stop();
+                continue;
+            }
+            float balance = latest.balance / 100.0f;
+            float gain = latest.volume / 100.0f;
+            synth.routed = latest.routing.routed();
+            if (synth.routed) {
+                // Volume stays with the synth's smoothing, the routing
+                // only places the cue
+                latest.routing.matrixFor(1, 1.0f, synth.target);
+                synth.synth.setTarget(gain, gain, latest.frequency, latest.pulseRate, latest.waveform);
+            } else {
+                synth.synth.setTarget(gain * (balance > 0.0f ? 1.0f - balance : 1.0f),
+                                      gain * (balance < 0.0f ? 1.0f + balance : 1.0f),
+                                      latest.frequency, latest.pulseRate, latest.waveform);
+            }
+        }
+
+        for (int c = 0; c < MIXER_SOURCES * MIXER_CLIP_VOICES; ++c) {
+            Voice& voice = voices_[c];
+            if (!pending[clipVoice(c)]) continue;
+
+            const SoundCommand& latest = latest_[clipVoice(c)];
+            if (latest.op == SoundOp::Stop) {
+                voice.stopping = voice.active;
+                continue;
+            }
+
+            // Restart only when the voice is idle or the buffer changed,
+            // otherwise just follow the new gain
+            if (!voice.active || voice.stopping || voice.data != latest.data) {
+                voice.data = latest.data;
+                voice.frames = latest.frames;
+                voice.stream = latest.stream;
+                voice.channels = latest.channels;
+                voice.position = 0;
+                if (voice.stream) {
+                    voice.stream->start();
+                }
+                if (!voice.active) {
+                    std::fill(voice.gain, voice.gain + MIX_MATRIX_SIZE, 0.0f);
+                }
+                voice.active = true;
+                voice.stopping = false;
+            }
+
+            float level = latest.volume / 100.0f * latest.scaling;
+            if (latest.routing.routed()) {
+                latest.routing.matrixFor(latest.channels, level, voice.target);
+                continue;
+            }
+
+            // Calculate channel gains based on balance (-100 to +100)
+            std::fill(voice.target, voice.target + MIX_MATRIX_SIZE, 0.0f);
+            if (latest.channels > 1) {
+                float balanceRatio = (latest.balance + 100.0f) / 200.0f;
+                voice.target[0] = level * (1.0f - balanceRatio);
+                voice.target[MIX_MAX_OUTPUTS + 1] = level * balanceRatio;
+            } else {
+                voice.target[0] = voice.target[1] = level;
+            }
+        }
+    }
+
+    std::unique_ptr<AudioBackend> backend_;
+    int deviceIndex_ = -1;
+    int channels_ = 2;
+    double sampleRate_ = 0.0;
+    std::function<void()> onStreamLost_;
+    std::atomic<bool> running_{false};
+
+    LatestSlot<SoundCommand> commands_[MIXER_MAX_VOICES];
+    SoundCommand latest_[MIXER_MAX_VOICES];
+    // Per source: the clip voices, then WARNING_SYNTH and the effects
+    Voice voices_[MIXER_SOURCES * MIXER_CLIP_VOICES];
+    SynthVoice synths_[MIXER_SOURCES * MIXER_SYNTH_VOICES];
+    float synthBlock_[MIXER_SYNTH_BLOCK_FRAMES];
+    unsigned tracedMask_ = 0;  // voices whose command latency is recorded after this block
+    std::atomic<unsigned> activeMask_{0};
+    std::atomic<const float*> voiceData_[MIXER_SOURCES * MIXER_CLIP_VOICES] = {};
+    std::atomic<uint64_t> blocksRendered_{0};
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal timing harness shared by the benchmark programs
+
+struct BenchResult {
+    std::string name;
+    size_t iterations = 0;
+    double nsPerOp = 0.0;
+    double itemsPerSecond = 0.0;
+};
+
+// Keeps a computed value alive so the optimizer cannot drop the work
+inline volatile char benchSink;
+
+template <typename T>
+inline void benchKeep(const T& value) {
+    benchSink = *reinterpret_cast<const volatile char*>(&value);
+}
+
+// Run fn repeatedly for about targetMs per round and keep the best of
+// several rounds. itemsPerOp is used to report throughput (samples, packets...).
+template <typename F>
+BenchResult runBenchmark(const std::string& name, double itemsPerOp, F&& fn, double targetMs = 100.0, int rounds = 5) {
+    using clock = std::chrono::steady_clock;
+
+    // Calibrate the iteration count for one round
+    size_t iterations = 1;
+    for (;;) {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) fn();
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+        if (ms >= targetMs / 4 || iterations >= (size_t(1) << 30)) {
+            if (ms > 0.0) {
+                iterations = std::max<size_t>(1, static_cast<size_t>(iterations * targetMs / ms));
+            }
+            break;
+        }
+        iterations *= 4;
+    }
+
+    double bestNs = 0.0;
+    for (int round = 0; round < rounds; ++round) {
+        auto start = clock::now();
+        for (size_t i = 0; i < iterations; ++i) fn();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+        if (round == 0 || ns < bestNs) bestNs = ns;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nsPerOp = bestNs;
+    result.itemsPerSecond = bestNs > 0.0 ? itemsPerOp * 1e9 / bestNs : 0.0;
+    return result;
+}
+
+inline void printBenchResult(const BenchResult& result) {
+    std::printf("%-44s %12.1f ns/op %14.1f M items/s\n", result.name.c_str(), result.nsPerOp,
+                result.itemsPerSecond / 1e6);
+}
+
+// Results of one benchmark program, printed as they come in and optionally
+// written as JSON so runs of different releases can be compared
+class BenchReport {
+public:
+    explicit BenchReport(std::string suite) : suite_(std::move(suite)) {}
+
+    void add(const BenchResult& result) {
+        printBenchResult(result);
+        results_.push_back(result);
+    }
+
+    // Extra top-level string field, e.g. the SIMD level the run used
+    void setInfo(const std::string& key, const std::string& value) {
+        info_.emplace_back(key, value);
+    }
+
+    bool writeJson(const std::string& path) const {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::printf("Could not write %s\n", path.c_str());
+            return false;
+        }
+        std::fprintf(file, "{\n  \"suite\": \"%s\",\n", escape(suite_).c_str());
+        for (const auto& [key, value] : info_) {
+            std::fprintf(file, "  \"%s\": \"%s\",\n", escape(key).c_str(), escape(value).c_str());
+        }
+        std::fprintf(file, "  \"results\": [\n");
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const BenchResult& result = results_[i];
+            std::fprintf(file, "    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_op\": %.3f, \"items_per_second\": %.1f}%s\n",
+                         escape(result.name).c_str(), result.iterations, result.nsPerOp, result.itemsPerSecond,
+                         i + 1 < results_.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+        std::fclose(file);
+        std::printf("Results written to %s\n", path.c_str());
+        return true;
+    }
+
+private:
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') escaped += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+        return escaped;
+    }
+
+    std::string suite_;
+    std::vector<std::pair<std::string, std::string>> info_;
+    std::vector<BenchResult> results_;
+};
+
+// Path given with --json <path> on the command line, empty if none
+inline std::string benchJsonPath(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) return argv[i + 1];
+    }
+    return "";
+}
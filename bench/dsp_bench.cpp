@@ -0,0 +1,144 @@
+// Micro-benchmark and self-check for the sample processing kernels.
+//
+// For every SIMD level the CPU supports, the kernel output is first compared
+// bit for bit against the scalar reference, then timed. Exits non-zero on a
+// mismatch. Pass --json <path> to also write the timings as JSON.
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "../dsp_kernels.h"
+#include "bench_util.h"
+
+// One second of 48 kHz stereo audio
+constexpr size_t BENCH_FRAMES = 48000;
+
+static std::vector<float> makeNoise(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.2f, 1.2f);
+    std::vector<float> data(count);
+    for (auto& sample : data) sample = dist(rng);
+    return data;
+}
+
+static bool sameBits(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// Compare each kernel at the current SIMD level against the scalar code.
+// Odd lengths exercise the scalar tails.
+static bool checkKernels(const char* level) {
+    bool ok = true;
+    auto report = [&](const char* kernel, bool passed) {
+        if (!passed) {
+            std::printf("MISMATCH: %s (%s)\n", kernel, level);
+            ok = false;
+        }
+    };
+
+    for (size_t frames : {size_t(0), size_t(1), size_t(7), size_t(33), BENCH_FRAMES + 3}) {
+        for (int channels : {1, 2, 3}) {
+            std::vector<float> reference = makeNoise(frames * channels, 1);
+            std::vector<float> actual = reference;
+            applyGainScalar(reference.data(), frames, channels, 0.35f, 1.7f);
+            applyInterleavedGain(actual.data(), frames, channels, 0.35f, 1.7f);
+            report("applyInterleavedGain", sameBits(reference, actual));
+        }
+
+        std::vector<float> reference = makeNoise(frames * 2, 2);
+        std::vector<float> actual = reference;
+        clampScalar(reference.data(), reference.size(), 0.9f);
+        clampSamples(actual.data(), actual.size(), 0.9f);
+        report("clampSamples", sameBits(reference, actual));
+
+        std::vector<float> samples = makeNoise(frames * 2, 3);
+        float expected = peakScalar(samples.data(), samples.size());
+        float peak = peakAbsolute(samples.data(), samples.size());
+        report("peakAbsolute", std::memcmp(&expected, &peak, sizeof(float)) == 0);
+
+        for (int srcChannels : {1, 2}) {
+            for (int outChannels : {1, 2}) {
+                std::vector<float> src = makeNoise(frames * srcChannels, 4);
+                std::vector<float> expectedOut = makeNoise(frames * outChannels, 5);
+                std::vector<float> actualOut = expectedOut;
+                mixRampScalar(expectedOut.data(), outChannels, src.data(), srcChannels, frames,
+                              0.2f, 0.6f, 0.0001f, -0.00002f);
+                mixInterleavedRamp(actualOut.data(), outChannels, src.data(), srcChannels, frames,
+                                   0.2f, 0.6f, 0.0001f, -0.00002f);
+                report("mixInterleavedRamp", sameBits(expectedOut, actualOut));
+            }
+        }
+
+        // Routing matrices onto every layout up to 7.1
+        std::vector<float> gain = makeNoise(MIX_MATRIX_SIZE, 6);
+        std::vector<float> step(MIX_MATRIX_SIZE, 0.00003f);
+        for (int srcChannels : {1, 2, 3}) {
+            for (int outChannels = 1; outChannels <= MIX_MAX_OUTPUTS; ++outChannels) {
+                std::vector<float> src = makeNoise(frames * srcChannels, 4);
+                std::vector<float> expectedOut = makeNoise(frames * outChannels, 5);
+                std::vector<float> actualOut = expectedOut;
+                mixMatrixRampScalar(expectedOut.data(), outChannels, src.data(), srcChannels, frames,
+                                    gain.data(), step.data());
+                mixMatrixRamp(actualOut.data(), outChannels, src.data(), srcChannels, frames,
+                              gain.data(), step.data());
+                report("mixMatrixRamp", sameBits(expectedOut, actualOut));
+            }
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    SimdLevel best = detectSimdLevel();
+    std::printf("Detected SIMD level: %s\n\n", simdLevelName(best));
+    BenchReport report("dsp");
+    report.setInfo("simd", simdLevelName(best));
+
+    bool ok = true;
+    std::vector<float> source = makeNoise(BENCH_FRAMES * 2, 7);
+    std::vector<float> work = source;
+    std::vector<float> out(BENCH_FRAMES * 2, 0.0f);
+
+    for (int level = 0; level <= static_cast<int>(best); ++level) {
+        forceSimdLevel(static_cast<SimdLevel>(level));
+        const char* name = simdLevelName(simdLevel());
+        ok &= checkKernels(name);
+
+        std::string suffix = std::string(" [") + name + "]";
+        report.add(runBenchmark("gain stereo, 1 s 48 kHz" + suffix, BENCH_FRAMES * 2, [&] {
+            applyInterleavedGain(work.data(), BENCH_FRAMES, 2, 1.0f, -1.0f);
+        }));
+        report.add(runBenchmark("gain mono, 2 s 48 kHz" + suffix, BENCH_FRAMES * 2, [&] {
+            applyInterleavedGain(work.data(), BENCH_FRAMES * 2, 1, -1.0f, -1.0f);
+        }));
+        report.add(runBenchmark("limiter, 1 s 48 kHz stereo" + suffix, BENCH_FRAMES * 2, [&] {
+            work = source;
+            clampSamples(work.data(), work.size(), 0.9f);
+        }));
+        report.add(runBenchmark("peak scan, 1 s 48 kHz stereo" + suffix, BENCH_FRAMES * 2, [&] {
+            benchKeep(peakAbsolute(source.data(), source.size()));
+        }));
+        report.add(runBenchmark("mix with gain ramp, 256 frames" + suffix, 256 * 2, [&] {
+            mixInterleavedRamp(out.data(), 2, source.data(), 2, 256, 0.5f, 0.5f, 0.0001f, -0.0001f);
+        }));
+        for (int outChannels : {6, 8}) {
+            // Left and right each to two shakers
+            float gain[MIX_MATRIX_SIZE] = {};
+            float step[MIX_MATRIX_SIZE] = {};
+            gain[0] = gain[2] = gain[MIX_MAX_OUTPUTS + 1] = gain[MIX_MAX_OUTPUTS + 3] = 0.5f;
+            step[0] = step[MIX_MAX_OUTPUTS + 1] = 0.0001f;
+            report.add(runBenchmark("routed mix to " + std::to_string(outChannels) + " channels, 256 frames" +
+                                    suffix, 256 * outChannels, [&] {
+                mixMatrixRamp(out.data(), outChannels, source.data(), 2, 256, gain, step);
+            }));
+        }
+        std::printf("\n");
+    }
+
+    std::printf(ok ? "All kernels match the scalar reference\n" : "Kernel mismatch detected\n");
+    std::string jsonPath = benchJsonPath(argc, argv);
+    if (!jsonPath.empty()) ok &= report.writeJson(jsonPath);
+    return ok ? 0 : 1;
+}
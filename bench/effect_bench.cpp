@@ -0,0 +1,175 @@
+// Cost per telemetry packet of the effect rule engine, for rule sets of 2 to
+// 200 rules.
+//
+// Each set is generated from a fixed seed as the text of Effect lines,
+// parsed and compiled as a profile load does, then evaluated over a stream
+// of pre-generated packets. The compiled evaluation is first checked
+// against a rule-by-rule reference on the same stream; exits non-zero on a
+// mismatch. Pass --json <path> to also write the timings as JSON.
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../effect_rules.h"
+#include "bench_util.h"
+
+// Packets per stream, 20 s at the sender's 100 Hz
+constexpr size_t BENCH_PACKETS = 2000;
+
+// Telemetry values sweeping through the ranges the generated rules test
+static std::vector<float> makePackets(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> values(BENCH_PACKETS * EFFECT_VALUE_COUNT);
+    for (size_t p = 0; p < BENCH_PACKETS; ++p) {
+        float* v = &values[p * EFFECT_VALUE_COUNT];
+        v[EFFECT_IAS] = 200.0f * unit(rng);
+        v[EFFECT_AOA] = 25.0f * unit(rng);
+        v[EFFECT_G] = -2.0f + 11.0f * unit(rng);
+        v[EFFECT_GEAR] = unit(rng) < 0.5f ? 0.0f : 1.0f;
+        v[EFFECT_FLAPS] = unit(rng);
+        v[EFFECT_RPM] = 100.0f * unit(rng);
+        v[EFFECT_VERTICAL_SPEED] = -20.0f + 40.0f * unit(rng);
+        // Missing from some senders
+        v[EFFECT_ALTITUDE_AGL] = p % 7 == 0 ? NAN : 1000.0f * unit(rng);
+        v[EFFECT_ALWAYS] = 0.0f;
+    }
+    return values;
+}
+
+// Upper ends of the values above, for picking condition ranges
+static float parameterSpan(int parameter) {
+    static const float spans[EFFECT_PARAMETER_COUNT] = {200.0f, 25.0f, 9.0f, 1.0f, 1.0f, 100.0f, 20.0f, 1000.0f};
+    return spans[parameter];
+}
+
+// count Effect lines with one to four conditions, open and closed ranges,
+// interpolated cues and some one-shots, spread over all layers
+static std::vector<std::string> makeRuleText(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> parameter(0, EFFECT_PARAMETER_COUNT - 1);
+    std::uniform_int_distribution<int> conditions(1, EFFECT_MAX_CONDITIONS);
+    std::uniform_int_distribution<int> layer(1, EFFECT_LAYERS);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<std::string> lines;
+    char buffer[128];
+    for (size_t i = 0; i < count; ++i) {
+        std::string line = "rule" + std::to_string(i) + " when";
+        int n = conditions(rng);
+        for (int c = 0; c < n; ++c) {
+            int p = parameter(rng);
+            const char* name = effectParameterName(static_cast<EffectParameter>(p));
+            float low = parameterSpan(p) * unit(rng);
+            float high = low + parameterSpan(p) * 0.6f * unit(rng);
+            int shape = static_cast<int>(3.0f * unit(rng));
+            if (shape == 0) std::snprintf(buffer, sizeof(buffer), " %s %.2f..", name, low);
+            else if (shape == 1) std::snprintf(buffer, sizeof(buffer), " %s ..%.2f", name, high);
+            else std::snprintf(buffer, sizeof(buffer), " %s %.2f..%.2f", name, low, high);
+            line += (c > 0 ? " and" : "") + std::string(buffer);
+        }
+        int by = parameter(rng);
+        std::snprintf(buffer, sizeof(buffer), " play 30..60 Hz pulse 0..8 Hz volume 20..80 by %s 0..%.2f layer %d",
+                      effectParameterName(static_cast<EffectParameter>(by)), parameterSpan(by), layer(rng));
+        line += buffer;
+        if (i % 5 == 4) line += " for 0.2 s";
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// The rules as declared, tested one by one; the semantics the compiled
+// columns must reproduce
+class ReferenceEvaluator {
+public:
+    explicit ReferenceEvaluator(const std::vector<EffectRule>& rules)
+        : rules_(rules), armed_(rules.size(), true), holdUntil_(rules.size(), 0) {}
+
+    void evaluate(const float* values, uint64_t timeMicros, int* winners) {
+        for (int l = 0; l < EFFECT_LAYERS; ++l) winners[l] = -1;
+        for (size_t i = 0; i < rules_.size(); ++i) {
+            const EffectRule& rule = rules_[i];
+            bool match = true;
+            for (int c = 0; c < rule.conditionCount; ++c) {
+                float value = values[rule.conditions[c].parameter];
+                match = match && value >= rule.conditions[c].low && value <= rule.conditions[c].high;
+            }
+            if (rule.duration > 0.0f) {
+                if (match && armed_[i]) holdUntil_[i] = timeMicros + static_cast<uint64_t>(rule.duration * 1e6);
+                armed_[i] = !match;
+                match = timeMicros < holdUntil_[i];
+            }
+            if (match && winners[rule.layer] < 0) winners[rule.layer] = static_cast<int>(i);
+        }
+    }
+
+private:
+    const std::vector<EffectRule>& rules_;
+    std::vector<bool> armed_;
+    std::vector<uint64_t> holdUntil_;
+};
+
+static bool parseRules(const std::vector<std::string>& lines, std::vector<EffectRule>& rules) {
+    for (const std::string& line : lines) {
+        EffectRule rule;
+        std::string error;
+        if (!parseEffectRule(line, rule, error)) {
+            std::printf("Generated rule rejected: %s\n  %s\n", error.c_str(), line.c_str());
+            return false;
+        }
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+static bool checkAgainstReference(const std::vector<EffectRule>& rules, const EffectRuleSet& compiled,
+                                  const std::vector<float>& packets) {
+    EffectEvaluator evaluator;
+    evaluator.reset(&compiled);
+    ReferenceEvaluator reference(rules);
+    for (size_t p = 0; p < BENCH_PACKETS; ++p) {
+        const float* values = &packets[p * EFFECT_VALUE_COUNT];
+        uint64_t time = p * 10000;
+        EffectCue cues[EFFECT_LAYERS];
+        int winners[EFFECT_LAYERS];
+        evaluator.evaluate(values, time, cues);
+        reference.evaluate(values, time, winners);
+        for (int l = 0; l < EFFECT_LAYERS; ++l) {
+            if (cues[l].rule != winners[l]) {
+                std::printf("Mismatch with %zu rules at packet %zu, layer %d: rule %d, expected %d\n",
+                            rules.size(), p, l + 1, cues[l].rule, winners[l]);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("effect");
+    std::vector<float> packets = makePackets(3);
+    bool ok = true;
+
+    for (size_t count : {2, 5, 10, 20, 50, 100, 200}) {
+        std::vector<EffectRule> rules;
+        if (!parseRules(makeRuleText(count, static_cast<unsigned>(count)), rules)) return 1;
+        EffectRuleSet compiled(rules);
+        ok &= checkAgainstReference(rules, compiled, packets);
+
+        EffectEvaluator evaluator;
+        evaluator.reset(&compiled);
+        size_t next = 0;
+        report.add(runBenchmark("evaluate " + std::to_string(count) + " rules, one packet", 1, [&] {
+            size_t p = next++ % BENCH_PACKETS;
+            EffectCue cues[EFFECT_LAYERS];
+            evaluator.evaluate(&packets[p * EFFECT_VALUE_COUNT], p * 10000, cues);
+            benchKeep(cues[0].volume);
+        }));
+    }
+
+    std::printf(ok ? "Compiled rules match the reference\n" : "Rule evaluation mismatch detected\n");
+    std::string jsonPath = benchJsonPath(argc, argv);
+    if (!jsonPath.empty()) ok &= report.writeJson(jsonPath);
+    return ok ? 0 : 1;
+}
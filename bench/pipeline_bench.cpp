@@ -0,0 +1,264 @@
+// Benchmarks of the telemetry and audio pipeline of DCS_haptic.cpp: packet
+// parsing, volume mapping, clip preprocessing on the shipped audio files,
+// the receiver-to-mixer command handoff, config parsing and an end-to-end
+// packets-per-second run into mixers with no audio device behind them.
+// Heap allocations are counted, and the bench exits non-zero if handling a
+// steady-state packet allocates.
+//
+// Includes the program itself, so it is built with the same libraries:
+//   g++ -std=c++17 -O2 -DNDEBUG bench/pipeline_bench.cpp -lportaudio -lsndfile -lws2_32
+// Run from the repository root, where configuration/ and audio/ are found.
+// Pass --json <path> to also write the results as JSON.
+
+#define DCS_HAPTIC_NO_MAIN
+#define DCS_HAPTIC_COUNT_ALLOCATIONS 1
+#include "../alloc_counter.h"
+#include "../DCS_haptic.cpp"
+#include "bench_util.h"
+
+// Shipped clips used for the preprocessing benchmarks
+static std::vector<std::string> audioFiles() {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("audio", ec)) {
+        if (entry.path().extension() == ".wav") files.push_back(entry.path().filename().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Binary packets as AOAHaptic.lua sends them
+static std::vector<char> encodeAirframe(const char* airframe) {
+    unsigned char packet[TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_AIRFRAME_NAME];
+    size_t length = encodeTelemetryAirframe(packet, 1, 0, latencyWallClock(), 0.0f, airframe);
+    return std::vector<char>(packet, packet + length);
+}
+
+static std::vector<char> encodeSample(uint32_t sequence, float IAS, float AoA) {
+    unsigned char packet[TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_PAYLOAD_SIZE];
+    size_t length = encodeTelemetrySample(packet, 1, sequence, latencyWallClock(), 0.0f, IAS, AoA);
+    return std::vector<char>(packet, packet + length);
+}
+
+// Commands stored by one thread and taken by another through the slot the
+// receiver uses to reach a mixer voice. The consumer only sees the newest
+// command each time it looks, like the audio callback does.
+static BenchResult benchmarkHandoff(size_t commands) {
+    LatestSlot<SoundCommand> slot;
+    std::atomic<bool> start{false};
+    std::thread consumer([&] {
+        while (!start.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        // The last command carries the count, so it is never mistaken for
+        // an earlier one
+        SoundCommand command;
+        size_t taken = 0;
+        while (command.frames != commands) {
+            if (slot.take(command)) {
+                ++taken;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        benchKeep(taken);
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    SoundCommand command;
+    command.op = SoundOp::Play;
+    for (size_t i = 1; i <= commands; ++i) {
+        command.frames = static_cast<uint32_t>(i);
+        slot.store(command);
+    }
+    consumer.join();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    BenchResult result;
+    result.name = "command handoff across threads";
+    result.iterations = commands;
+    result.nsPerOp = ns / commands;
+    result.itemsPerSecond = commands * 1e9 / ns;
+    return result;
+}
+
+// Add count telemetry sources flying the MiG-21Bis, whose warnings play
+// into a mixer that has no stream; the caller renders it in place of the
+// audio callback
+static void addNullSinkSources(AudioMixer& mixer, size_t count) {
+    auto profile = std::make_shared<AirframeProfile>();
+    profile->airframe = "MiG-21Bis";
+    profile->configPath = "configuration/default.cfg";
+    readConfig(profile->configPath, profile->config);
+    profile->config.audioCache = false;
+    const AirframeConfig& config = profile->config;
+    profile->aoaWarning = loadWarningSound(config.aoaWarningAudioFile, config.aoaWarningStartVolume,
+                                           config.aoaWarningBalance, nullptr, "AOA Warning", false);
+    profile->stallWarning = loadWarningSound(config.stallWarningAudioFile, config.stallWarningVolume,
+                                             config.stallWarningBalance, nullptr, "Stall Warning", false);
+    profile->aoaOutput = OutputLease(&mixer, [](AudioMixer*) {});
+    profile->stallOutput = profile->aoaOutput;
+
+    std::vector<char> declare = encodeAirframe("MiG-21Bis");
+    for (size_t i = 0; i < count; ++i) {
+        boost::asio::ip::udp::endpoint sender(boost::asio::ip::address_v4::loopback(),
+                                              static_cast<unsigned short>(50001 + i));
+        TelemetrySource* source = telemetrySources.add(sender);
+        source->profile.publish(profile);
+        source->airframe = profile->airframe;
+        source->wantedProfile = profile->key();
+        TelemetrySample sample;
+        source->parser.parse(declare.data(), declare.size(), sample);
+    }
+}
+
+int main(int argc, char** argv) {
+    Logger::instance().setLevel(LogLevel::Off);
+    BenchReport report("pipeline");
+    report.setInfo("simd", simdLevelName(simdLevel()));
+
+    // Packet parsing
+    TelemetryParser parser;
+    const char csvPacket[] = "152.4,17.25,MiG-21Bis";
+    TelemetrySample sample;
+    report.add(runBenchmark("parse CSV packet (sscanf)", 1, [&] {
+        parser.parse(csvPacket, sizeof(csvPacket) - 1, sample);
+        benchKeep(sample.AoA);
+    }));
+    std::vector<char> declare = encodeAirframe("MiG-21Bis");
+    parser.parse(declare.data(), declare.size(), sample);
+    std::vector<char> binaryPacket = encodeSample(1, 152.4f, 17.25f);
+    report.add(runBenchmark("parse binary packet", 1, [&] {
+        parser.parse(binaryPacket.data(), binaryPacket.size(), sample);
+        benchKeep(sample.AoA);
+    }));
+
+    // Volume mapping over a sweep through the warning band
+    const size_t sweepLength = 1024;
+    float sweep[sweepLength];
+    for (size_t i = 0; i < sweepLength; ++i) sweep[i] = 10.0f + 15.0f * i / sweepLength;
+    report.add(runBenchmark("calculateVolume, 1024 AoA values", sweepLength, [&] {
+        float sum = 0.0f;
+        for (float AoA : sweep) sum += calculateVolume(AoA, 16.0f, 20.0f, 40.0f, 70.0f);
+        benchKeep(sum);
+    }));
+
+    // Clip preprocessing on every shipped audio file; decoding is part of
+    // preprocessAudioData
+    for (const std::string& file : audioFiles()) {
+        std::vector<float> buffer;
+        int sampleRate = 0;
+        int channels = 0;
+        preprocessAudioData(file, 70.0f, 0, buffer, sampleRate, channels);
+        if (buffer.empty()) continue;
+        double samples = static_cast<double>(buffer.size());
+
+        report.add(runBenchmark("preprocessAudioData " + file, samples, [&] {
+            std::vector<float> processed;
+            preprocessAudioData(file, 70.0f, 0, processed, sampleRate, channels);
+            benchKeep(processed[0]);
+        }));
+        std::vector<float> work = buffer;
+        report.add(runBenchmark("applyLimiter " + file, samples, [&] {
+            applyLimiter(work, 0.9f);
+            benchKeep(work[0]);
+        }));
+        report.add(runBenchmark("analyzeAudioLevels " + file, samples, [&] {
+            benchKeep(analyzeAudioLevels(buffer, "AOA Warning"));
+        }));
+    }
+
+    // Receiver to mixer handoff
+    LatestSlot<SoundCommand> slot;
+    SoundCommand command;
+    report.add(runBenchmark("command store + take, one thread", 1, [&] {
+        slot.store(command);
+        slot.take(command);
+        benchKeep(command.volume);
+    }));
+    report.add(benchmarkHandoff(size_t(1) << 20));
+
+    // Config parsing
+    report.add(runBenchmark("readConfig default.cfg", 1, [&] {
+        AirframeConfig config;
+        readConfig("configuration/default.cfg", config);
+        benchKeep(config.stallWarning);
+    }));
+
+    // End to end: parse, act on the sample, then render one 256-frame block
+    // as the audio callback would, with AoA sweeping through every warning
+    AudioMixer mixer;
+    addNullSinkSources(mixer, MAX_TELEMETRY_SOURCES);
+    TelemetrySource& source = telemetrySources[0];
+    const size_t packetCount = 256;
+    std::vector<std::vector<char>> binaryPackets;
+    std::vector<std::string> csvPackets;
+    for (size_t i = 0; i < packetCount; ++i) {
+        float AoA = 10.0f + 15.0f * i / packetCount;
+        binaryPackets.push_back(encodeSample(static_cast<uint32_t>(i + 2), 152.4f, AoA));
+        csvPackets.push_back("152.4," + std::to_string(AoA) + ",MiG-21Bis");
+    }
+    std::vector<float> block(256 * 2);
+    size_t next = 0;
+    report.add(runBenchmark("end to end, binary packet + 256-frame block", 1, [&] {
+        const std::vector<char>& packet = binaryPackets[next++ % packetCount];
+        TelemetrySample received;
+        source.parser.parse(packet.data(), packet.size(), received);
+        received.receiveTime = latencyNow();
+        processTelemetrySample(source, received);
+        mixer.render(block.data(), 256);
+    }));
+    report.add(runBenchmark("end to end, CSV packet + 256-frame block", 1, [&] {
+        const std::string& packet = csvPackets[next++ % packetCount];
+        TelemetrySample received;
+        source.parser.parse(packet.data(), packet.size(), received);
+        received.receiveTime = latencyNow();
+        processTelemetrySample(source, received);
+        mixer.render(block.data(), 256);
+    }));
+    // The same with every source sending in turn, each on its own voices;
+    // the cost per packet should not grow with the number of sources
+    report.add(runBenchmark("end to end, binary packet + 256-frame block, " +
+                                std::to_string(MAX_TELEMETRY_SOURCES) + " sources", 1, [&] {
+        size_t n = next++;
+        TelemetrySource& sender = telemetrySources[n % MAX_TELEMETRY_SOURCES];
+        const std::vector<char>& packet = binaryPackets[(n / MAX_TELEMETRY_SOURCES) % packetCount];
+        TelemetrySample received;
+        sender.parser.parse(packet.data(), packet.size(), received);
+        received.receiveTime = latencyNow();
+        processTelemetrySample(sender, received);
+        mixer.render(block.data(), 256);
+    }));
+
+    // Once every source has played every warning, packets must be handled
+    // without touching the heap, in either format
+    bool ok = true;
+    uint64_t allocations = allocationCount();
+    for (size_t n = 0; n < packetCount * MAX_TELEMETRY_SOURCES; ++n) {
+        TelemetrySource& sender = telemetrySources[n % MAX_TELEMETRY_SOURCES];
+        TelemetrySample received;
+        if (n % 2 == 0) {
+            const std::vector<char>& packet = binaryPackets[(n / MAX_TELEMETRY_SOURCES) % packetCount];
+            sender.parser.parse(packet.data(), packet.size(), received);
+        } else {
+            const std::string& packet = csvPackets[(n / MAX_TELEMETRY_SOURCES) % packetCount];
+            sender.parser.parse(packet.data(), packet.size(), received);
+        }
+        received.receiveTime = latencyNow();
+        processTelemetrySample(sender, received);
+        mixer.render(block.data(), 256);
+    }
+    allocations = allocationCount() - allocations;
+    if (allocations > 0) {
+        std::printf("Steady-state packet path made %llu heap allocation(s)\n",
+                    static_cast<unsigned long long>(allocations));
+        ok = false;
+    } else {
+        std::printf("Steady-state packet path is allocation free\n");
+    }
+
+    std::string jsonPath = benchJsonPath(argc, argv);
+    if (!jsonPath.empty()) ok &= report.writeJson(jsonPath);
+    return ok ? 0 : 1;
+}
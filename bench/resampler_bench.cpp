@@ -0,0 +1,149 @@
+// Throughput benchmark and quality check for the resamplers.
+//
+// Each rate pair first converts a 1 kHz sine and compares the middle of the
+// result with an ideal sine generated at the output rate, and checks that
+// the streaming resampler fed in uneven pieces reproduces the whole-clip
+// conversion exactly. It then times the conversion of one second of stereo
+// noise both ways. Exits non-zero if the error is above the limit, the
+// output length is wrong or the streamed output differs. Pass --json <path> to also
+// write the timings as JSON.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../resampler.h"
+#include "bench_util.h"
+
+// Required signal-to-error ratio for the sine check
+constexpr double MIN_SINE_SNR_DB = 80.0;
+
+static std::vector<float> makeSine(size_t frames, int channels, double frequency, int rate) {
+    const double pi = 3.14159265358979323846;
+    std::vector<float> data(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        float value = static_cast<float>(0.5 * std::sin(2.0 * pi * frequency * i / rate));
+        for (int ch = 0; ch < channels; ++ch) data[i * channels + ch] = value;
+    }
+    return data;
+}
+
+static std::vector<float> makeNoise(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<float> data(count);
+    for (auto& sample : data) sample = dist(rng);
+    return data;
+}
+
+// Convert a 1 kHz sine and measure the error against the ideal output,
+// skipping the filter edges at both ends
+static bool checkSine(int inputRate, int outputRate) {
+    PolyphaseResampler resampler(inputRate, outputRate);
+    size_t frames = static_cast<size_t>(inputRate);
+    std::vector<float> input = makeSine(frames, 2, 1000.0, inputRate);
+    std::vector<float> output = resampler.process(input.data(), frames, 2);
+    std::vector<float> ideal = makeSine(resampler.outputFrames(frames), 2, 1000.0, outputRate);
+
+    size_t expectedFrames = (frames * outputRate + inputRate - 1) / inputRate;
+    if (output.size() != expectedFrames * 2) {
+        std::printf("LENGTH MISMATCH: %d -> %d Hz, %zu frames, expected %zu\n", inputRate, outputRate,
+                    output.size() / 2, expectedFrames);
+        return false;
+    }
+
+    double signal = 0.0, error = 0.0;
+    size_t margin = RESAMPLER_TAPS * 2;
+    for (size_t i = margin * 2; i + margin * 2 < output.size(); ++i) {
+        signal += static_cast<double>(ideal[i]) * ideal[i];
+        double diff = static_cast<double>(output[i]) - ideal[i];
+        error += diff * diff;
+    }
+    double snr = error > 0.0 ? 10.0 * std::log10(signal / error) : 200.0;
+    std::printf("%6d -> %6d Hz: 1 kHz sine SNR %.1f dB\n", inputRate, outputRate, snr);
+    return snr >= MIN_SINE_SNR_DB;
+}
+
+// Feed input to a streaming resampler in pieces of varying size and pull
+// output in other sizes, as a streamed clip is decoded
+static std::vector<float> resampleInPieces(std::shared_ptr<const PolyphaseResampler> filter,
+                                           const std::vector<float>& input, size_t outputFrames) {
+    StreamingResampler resampler(std::move(filter), 2);
+    std::vector<float> output(outputFrames * 2);
+    size_t fed = 0, done = 0, piece = 0;
+    while (done < outputFrames) {
+        size_t wanted = std::min<size_t>(700 + 300 * (piece % 3), outputFrames - done);
+        done += resampler.pull(output.data() + done * 2, wanted);
+        size_t frames = std::min<size_t>(512 + 1024 * (piece % 2), input.size() / 2 - fed);
+        resampler.push(input.data() + fed * 2, frames);
+        fed += frames;
+        ++piece;
+        if (frames == 0) {
+            // Pad the end with silence, as process() does
+            std::vector<float> zeros(RESAMPLER_TAPS * 2, 0.0f);
+            resampler.push(zeros.data(), RESAMPLER_TAPS);
+        }
+    }
+    return output;
+}
+
+static bool checkStreaming(int inputRate, int outputRate) {
+    auto filter = std::make_shared<const PolyphaseResampler>(inputRate, outputRate);
+    size_t frames = static_cast<size_t>(inputRate) / 2;
+    std::vector<float> input = makeNoise(frames * 2, 2);
+    std::vector<float> whole = filter->process(input.data(), frames, 2);
+    std::vector<float> streamed = resampleInPieces(filter, input, filter->outputFrames(frames));
+    if (streamed != whole) {
+        std::printf("STREAMING MISMATCH: %d -> %d Hz\n", inputRate, outputRate);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchReport report("resampler");
+    const int ratePairs[][2] = {
+        {44100, 48000}, {48000, 44100}, {44100, 96000}, {22050, 48000}, {48000, 32000}, {44100, 47999}
+    };
+
+    bool ok = true;
+    for (const auto& pair : ratePairs) {
+        ok &= checkSine(pair[0], pair[1]);
+        ok &= checkStreaming(pair[0], pair[1]);
+    }
+    std::printf("\n");
+
+    for (const auto& pair : ratePairs) {
+        int inputRate = pair[0];
+        int outputRate = pair[1];
+        std::vector<float> source = makeNoise(static_cast<size_t>(inputRate) * 2, 1);
+        PolyphaseResampler resampler(inputRate, outputRate);
+        size_t outputSamples = resampler.outputFrames(inputRate) * 2;
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "resample 1 s stereo %d -> %d", inputRate, outputRate);
+        report.add(runBenchmark(name, static_cast<double>(outputSamples), [&] {
+            benchKeep(resampler.process(source.data(), inputRate, 2)[0]);
+        }));
+
+        auto filter = std::make_shared<const PolyphaseResampler>(inputRate, outputRate);
+        std::snprintf(name, sizeof(name), "stream 1 s stereo %d -> %d", inputRate, outputRate);
+        report.add(runBenchmark(name, static_cast<double>(outputSamples), [&] {
+            benchKeep(resampleInPieces(filter, source, outputSamples / 2)[0]);
+        }));
+
+        std::snprintf(name, sizeof(name), "filter design %d -> %d", inputRate, outputRate);
+        report.add(runBenchmark(name, static_cast<double>(resampler.coefficientCount()), [&] {
+            PolyphaseResampler designed(inputRate, outputRate);
+            benchKeep(designed.outputFrames(1));
+        }));
+    }
+
+    std::printf(ok ? "\nAll rate pairs within %.0f dB\n" : "\nResampler quality check failed (limit %.0f dB)\n",
+                MIN_SINE_SNR_DB);
+    std::string jsonPath = benchJsonPath(argc, argv);
+    if (!jsonPath.empty()) ok &= report.writeJson(jsonPath);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include "dsp_kernels.h"
+
+// Which output channels a warning plays on, for multichannel devices with
+// one transducer per channel. Written in the .cfg files as a list of
+// routes, each source channel > output channel with an optional gain in
+// percent:
+//
+//   AOA_warning_routing=0>0 1>1 0>2:80 1>3:80
+//
+// Source channels are those of the audio file (0 = left, 1 = right; a mono
+// file feeds both) or of the synthesized cue, which is mono. Output
+// channels count from 0 in the device's order, e.g. FL FR C LFE SL SR for
+// 5.1. A warning without routing, or with routing=off, uses its balance.
+struct ChannelRouting {
+    float gain[MIX_MATRIX_SIZE] = {};  // linear, gain[source * MIX_MAX_OUTPUTS + output]
+    int outputs = 0;                   // highest routed output + 1; 0 when not routed
+
+    bool routed() const { return outputs > 0; }
+
+    // Matrix for a source with the given channel count. Mono sources and
+    // the synth cue take the routes of both source channels.
+    void matrixFor(int sourceChannels, float level, float* matrix) const {
+        for (int o = 0; o < MIX_MAX_OUTPUTS; ++o) {
+            if (sourceChannels == 1) {
+                matrix[o] = (gain[o] + gain[MIX_MAX_OUTPUTS + o]) * level;
+                matrix[MIX_MAX_OUTPUTS + o] = 0.0f;
+            } else {
+                matrix[o] = gain[o] * level;
+                matrix[MIX_MAX_OUTPUTS + o] = gain[MIX_MAX_OUTPUTS + o] * level;
+            }
+        }
+    }
+};
+
+// Parse a routing value. Returns false with error set on a malformed route;
+// "off" clears the routing.
+inline bool parseChannelRouting(const std::string& value, ChannelRouting& routing, std::string& error) {
+    ChannelRouting parsed;
+    if (value != "off") {
+        std::string text = value;
+        for (char& c : text) {
+            if (c == ',') c = ' ';
+        }
+        std::istringstream routes(text);
+        std::string route;
+        while (routes >> route) {
+            int source = -1;
+            int output = -1;
+            float percent = 100.0f;
+            char extra = 0;
+            int fields = std::sscanf(route.c_str(), "%d>%d:%f%c", &source, &output, &percent, &extra);
+            if (fields < 2 || fields > 3 || (fields == 2 && route.find(':') != std::string::npos)) {
+                error = "expected source>output[:percent], got '" + route + "'";
+                return false;
+            }
+            if (source < 0 || source >= MIX_MAX_SOURCES || output < 0 || output >= MIX_MAX_OUTPUTS) {
+                error = "route '" + route + "' needs a source channel 0-" + std::to_string(MIX_MAX_SOURCES - 1) +
+                        " and an output channel 0-" + std::to_string(MIX_MAX_OUTPUTS - 1);
+                return false;
+            }
+            if (percent < 0.0f || percent > 100.0f) {
+                error = "gain of route '" + route + "' must be 0-100%";
+                return false;
+            }
+            parsed.gain[source * MIX_MAX_OUTPUTS + output] = percent / 100.0f;
+            if (output + 1 > parsed.outputs) parsed.outputs = output + 1;
+        }
+    }
+    routing = parsed;
+    return true;
+}
+
+// Routing in the .cfg syntax, or "off"
+inline std::string formatChannelRouting(const ChannelRouting& routing) {
+    if (!routing.routed()) return "off";
+    std::string text;
+    for (int s = 0; s < MIX_MAX_SOURCES; ++s) {
+        for (int o = 0; o < MIX_MAX_OUTPUTS; ++o) {
+            float gain = routing.gain[s * MIX_MAX_OUTPUTS + o];
+            if (gain == 0.0f) continue;
+            if (!text.empty()) text += ' ';
+            text += std::to_string(s) + '>' + std::to_string(o);
+            int percent = static_cast<int>(gain * 100.0f + 0.5f);
+            if (percent != 100) text += ':' + std::to_string(percent);
+        }
+    }
+    return text;
+}
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sndfile.h"
+#include "dsp_kernels.h"
+#include "logger.h"
+#include "resampler.h"
+
+// Clip files larger than this are streamed from disk instead of decoded
+// whole, about 24 s of 16-bit stereo at 44.1 kHz
+constexpr uint64_t CLIP_STREAM_MIN_FILE_BYTES = 4 * 1024 * 1024;
+// Frames per chunk at the device rate, 170 ms at 48 kHz. A streamed clip
+// keeps its first chunk resident, plus two per source that has played it.
+constexpr size_t CLIP_STREAM_CHUNK_FRAMES = 8192;
+// Frames of the file decoded per read
+constexpr size_t CLIP_STREAM_READ_FRAMES = 2048;
+// How often the refill thread tops up the rings; well under a chunk
+constexpr auto CLIP_STREAM_REFILL_INTERVAL = std::chrono::milliseconds(20);
+// Limiter threshold, as preprocessAudioData applies to resident clips
+constexpr float CLIP_STREAM_LIMIT = 0.9f;
+
+// File and processing of a streamed clip
+struct ClipFormat {
+    std::string path;
+    int channels = 0;
+    int sourceRate = 0;
+    int deviceRate = 0;
+    float gainLeft = 1.0f;  // volume and balance of the warning
+    float gainRight = 1.0f;
+};
+
+// Reads a clip file piece by piece and prepares it for the mixer: the
+// warning's gain and limiter are applied as for resident clips, then the
+// rate is converted. At the end of the file it carries on from the start
+// with the resampler state intact, so a clip loops without a gap or click.
+class ClipDecoder {
+public:
+    // Position to return to with resume()
+    struct Mark {
+        sf_count_t frame;
+        StreamingResampler resampler;
+    };
+
+    // Takes ownership of file, opened at its first frame
+    ClipDecoder(SNDFILE* file, const ClipFormat& format, std::shared_ptr<const PolyphaseResampler> filter)
+        : file_(file), format_(format), resampler_(std::move(filter), format.channels),
+          input_(CLIP_STREAM_READ_FRAMES * format.channels) {}
+
+    ~ClipDecoder() { sf_close(file_); }
+
+    ClipDecoder(const ClipDecoder&) = delete;
+    ClipDecoder& operator=(const ClipDecoder&) = delete;
+
+    // Fill frames interleaved frames at the device rate. Returns false if
+    // the file cannot be read or has no frames.
+    bool read(float* output, size_t frames) {
+        size_t done = 0;
+        bool rewound = false;
+        while (true) {
+            done += resampler_.pull(output + done * format_.channels, frames - done);
+            if (done == frames) return true;
+
+            sf_count_t count = sf_readf_float(file_, input_.data(), CLIP_STREAM_READ_FRAMES);
+            if (count <= 0) {
+                if (rewound || sf_seek(file_, 0, SEEK_SET) < 0) return false;
+                rewound = true;
+                frame_ = 0;
+                continue;
+            }
+            rewound = false;
+            frame_ += count;
+            applyInterleavedGain(input_.data(), static_cast<size_t>(count), format_.channels,
+                                 format_.gainLeft, format_.gainRight);
+            clampSamples(input_.data(), static_cast<size_t>(count) * format_.channels, CLIP_STREAM_LIMIT);
+            resampler_.push(input_.data(), static_cast<size_t>(count));
+        }
+    }
+
+    Mark mark() const { return Mark{frame_, resampler_}; }
+
+    bool resume(const Mark& mark) {
+        if (sf_seek(file_, mark.frame, SEEK_SET) < 0) return false;
+        frame_ = mark.frame;
+        resampler_ = mark.resampler;
+        return true;
+    }
+
+private:
+    SNDFILE* file_;
+    const ClipFormat& format_;
+    StreamingResampler resampler_;
+    std::vector<float> input_;
+    sf_count_t frame_ = 0;  // next frame of the file
+};
+
+// What the streams of a clip share; immutable once the clip is open
+struct ClipSource {
+    ClipFormat format;
+    std::shared_ptr<const PolyphaseResampler> filter;  // null at equal rates
+    std::vector<float> head;                           // first chunk, at the device rate
+    ClipDecoder::Mark afterHead{0, StreamingResampler(nullptr, 0)};
+};
+
+// One source's playback of a streamed clip. The audio callback plays the
+// resident head, then the chunks the refill thread decodes into a ring of
+// two: one is played while the other is filled. A slot belongs to the
+// callback while its tag is the generation of the current playback and to
+// the refill thread otherwise, so restarting playback, which starts a new
+// generation, hands both slots back at once. Ring memory is allocated the
+// first time the refill thread fills it.
+class ClipStream {
+public:
+    explicit ClipStream(const ClipSource& source) : source_(source) {}
+
+    // --- Audio callback
+
+    // Play from the start of the clip
+    void start() {
+        if (++playing_ == 0) playing_ = 1;
+        generation_.store(playing_, std::memory_order_release);
+        inHead_ = true;
+        slot_ = 0;
+        position_ = 0;
+    }
+
+    // Set data to the next frames to play and return how many there are, at
+    // most maxFrames. Returns 0 if the refill thread has fallen behind; the
+    // caller plays silence until the chunk is ready.
+    size_t peek(const float*& data, size_t maxFrames) {
+        size_t channels = static_cast<size_t>(source_.format.channels);
+        if (inHead_) {
+            size_t headFrames = source_.head.size() / channels;
+            if (position_ < headFrames) {
+                data = source_.head.data() + position_ * channels;
+                return std::min(headFrames - position_, maxFrames);
+            }
+            inHead_ = false;
+            position_ = 0;
+        }
+        const Slot& slot = slots_[slot_];
+        if (slot.tag.load(std::memory_order_acquire) != playing_) {
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+        data = slot.samples.get() + position_ * channels;
+        return std::min(CLIP_STREAM_CHUNK_FRAMES - position_, maxFrames);
+    }
+
+    // Move past frames returned by peek()
+    void advance(size_t frames) {
+        position_ += frames;
+        if (!inHead_ && position_ == CLIP_STREAM_CHUNK_FRAMES) {
+            slots_[slot_].tag.store(0, std::memory_order_release);
+            slot_ ^= 1;
+            position_ = 0;
+        }
+    }
+
+    // Blocks that found the next chunk missing
+    uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+    // --- Refill thread
+
+    // Decode chunks into the slots the callback is done with. Returns false
+    // if the file could not be read; the stream then stays silent past its
+    // head.
+    bool refill() {
+        if (failed_) return false;
+        uint32_t wanted = generation_.load(std::memory_order_acquire);
+        if (wanted == 0) return true;  // never played
+        if (wanted != producing_) {
+            producing_ = wanted;
+            fill_ = 0;
+            if (!decoder_ && !openDecoder()) return fail();
+            if (!decoder_->resume(source_.afterHead)) return fail();
+        }
+
+        while (slots_[fill_].tag.load(std::memory_order_acquire) != producing_) {
+            // Restarted meanwhile; the next pass starts over
+            if (generation_.load(std::memory_order_acquire) != producing_) return true;
+            Slot& slot = slots_[fill_];
+            if (!slot.samples) {
+                slot.samples.reset(new float[CLIP_STREAM_CHUNK_FRAMES * source_.format.channels]);
+            }
+            if (!decoder_->read(slot.samples.get(), CLIP_STREAM_CHUNK_FRAMES)) return fail();
+            slot.tag.store(producing_, std::memory_order_release);
+            fill_ ^= 1;
+        }
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::unique_ptr<float[]> samples;
+        std::atomic<uint32_t> tag{0};  // generation it was filled for, 0 when free
+    };
+
+    bool openDecoder() {
+        SF_INFO info{};
+        SNDFILE* file = sf_open(source_.format.path.c_str(), SFM_READ, &info);
+        if (!file) return false;
+        if (info.channels != source_.format.channels) {
+            sf_close(file);
+            return false;
+        }
+        decoder_ = std::make_unique<ClipDecoder>(file, source_.format, source_.filter);
+        return true;
+    }
+
+    bool fail() {
+        failed_ = true;
+        LOG_ERROR("Error streaming audio file: {}", source_.format.path);
+        return false;
+    }
+
+    const ClipSource& source_;
+    Slot slots_[2];
+    std::atomic<uint32_t> generation_{0};  // playback the callback wants, 0 before the first
+    std::atomic<uint64_t> underruns_{0};
+
+    // Audio callback only
+    uint32_t playing_ = 0;
+    bool inHead_ = true;
+    int slot_ = 0;
+    size_t position_ = 0;  // frames into the head or the current slot
+
+    // Refill thread only
+    uint32_t producing_ = 0;
+    int fill_ = 0;
+    std::unique_ptr<ClipDecoder> decoder_;
+    bool failed_ = false;
+};
+
+// A clip too long to keep decoded in memory. Only its first chunk stays
+// resident; the rest is decoded from disk as it plays, by one stream per
+// source so sources sharing the clip each keep their own position. Memory
+// is the head plus two chunks and a decoder per stream that has played,
+// whatever the length of the file. Streams loop until the voice stops.
+class StreamedClip {
+public:
+    // Open a clip file for streaming at deviceRate (0: the file's rate) with
+    // one stream per reader. The file is scanned once for its peak level
+    // and its head decoded. Returns null with error set on failure.
+    static std::shared_ptr<StreamedClip> open(const std::string& path, float gainLeft, float gainRight,
+                                              int deviceRate, size_t readers, std::string& error) {
+        SF_INFO info{};
+        SNDFILE* file = sf_open(path.c_str(), SFM_READ, &info);
+        if (!file) {
+            error = "cannot open the file";
+            return nullptr;
+        }
+        if (info.channels <= 0 || info.frames <= 0 || info.samplerate <= 0) {
+            sf_close(file);
+            error = "no audio frames";
+            return nullptr;
+        }
+
+        std::shared_ptr<StreamedClip> clip(new StreamedClip());
+        ClipSource& source = clip->source_;
+        source.format = ClipFormat{path, info.channels, info.samplerate,
+                                   deviceRate > 0 ? deviceRate : info.samplerate, gainLeft, gainRight};
+        if (source.format.deviceRate != source.format.sourceRate) {
+            source.filter = std::make_shared<const PolyphaseResampler>(source.format.sourceRate,
+                                                                       source.format.deviceRate);
+        }
+        clip->fileFrames_ = info.frames;
+
+        // Peak after gain and limiter, as analyzeAudioLevels measures
+        // resident clips before conversion
+        std::vector<float> block(CLIP_STREAM_READ_FRAMES * info.channels);
+        sf_count_t count;
+        while ((count = sf_readf_float(file, block.data(), CLIP_STREAM_READ_FRAMES)) > 0) {
+            size_t samples = static_cast<size_t>(count) * info.channels;
+            applyInterleavedGain(block.data(), static_cast<size_t>(count), info.channels, gainLeft, gainRight);
+            clampSamples(block.data(), samples, CLIP_STREAM_LIMIT);
+            clip->peak_ = std::max(clip->peak_, peakAbsolute(block.data(), samples));
+        }
+        if (sf_seek(file, 0, SEEK_SET) < 0) {
+            sf_close(file);
+            error = "the file cannot be rewound";
+            return nullptr;
+        }
+
+        ClipDecoder decoder(file, source.format, source.filter);
+        source.head.resize(CLIP_STREAM_CHUNK_FRAMES * info.channels);
+        if (!decoder.read(source.head.data(), CLIP_STREAM_CHUNK_FRAMES)) {
+            error = "read error";
+            return nullptr;
+        }
+        source.afterHead = decoder.mark();
+
+        for (size_t i = 0; i < readers; ++i) {
+            clip->streams_.push_back(std::make_unique<ClipStream>(source));
+        }
+        clip->reportedUnderruns_.assign(readers, 0);
+        return clip;
+    }
+
+    // Start of the head; identifies the clip in the mixers
+    const float* head() const { return source_.head.data(); }
+    size_t headFrames() const { return CLIP_STREAM_CHUNK_FRAMES; }
+    const ClipFormat& format() const { return source_.format; }
+    // Length of the file at its own rate
+    sf_count_t fileFrames() const { return fileFrames_; }
+    float peak() const { return peak_; }
+
+    ClipStream* stream(size_t reader) { return streams_[reader].get(); }
+
+    // Decode ahead for every stream that is playing. Refill thread only.
+    void refill() {
+        for (size_t i = 0; i < streams_.size(); ++i) {
+            streams_[i]->refill();
+            uint64_t underruns = streams_[i]->underruns();
+            if (underruns != reportedUnderruns_[i]) {
+                LOG_WARNING("Warning: streaming {} fell behind playback ({} block(s) silent)",
+                            source_.format.path, underruns - reportedUnderruns_[i]);
+                reportedUnderruns_[i] = underruns;
+            }
+        }
+    }
+
+private:
+    StreamedClip() = default;
+
+    ClipSource source_;
+    sf_count_t fileFrames_ = 0;
+    float peak_ = 0.0f;
+    std::vector<std::unique_ptr<ClipStream>> streams_;
+    std::vector<uint64_t> reportedUnderruns_;
+};
+
+// Background thread keeping the streams of every open streamed clip ahead
+// of playback. Clips are held weakly and drop out once their profile is
+// freed; the thread starts with the first clip.
+class ClipStreamer {
+public:
+    ~ClipStreamer() { stop(); }
+
+    void add(const std::shared_ptr<StreamedClip>& clip) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_) return;
+            clips_.push_back(clip);
+            if (!worker_.joinable()) {
+                worker_ = std::thread(&ClipStreamer::workerLoop, this);
+            }
+        }
+        wake_.notify_one();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+private:
+    void workerLoop() {
+        std::vector<std::shared_ptr<StreamedClip>> live;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopped_) {
+            for (auto it = clips_.begin(); it != clips_.end();) {
+                if (auto clip = it->lock()) {
+                    live.push_back(std::move(clip));
+                    ++it;
+                } else {
+                    it = clips_.erase(it);
+                }
+            }
+            if (live.empty()) {
+                wake_.wait(lock, [this] { return stopped_ || !clips_.empty(); });
+                continue;
+            }
+
+            // Clips whose profile went away meanwhile are freed here, off the lock
+            lock.unlock();
+            for (const auto& clip : live) {
+                clip->refill();
+            }
+            live.clear();
+            lock.lock();
+            wake_.wait_for(lock, CLIP_STREAM_REFILL_INTERVAL, [this] { return stopped_; });
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::weak_ptr<StreamedClip>> clips_;
+    bool stopped_ = false;
+    std::thread worker_;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Size used to keep producer and consumer indices on separate cache lines
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+// Wait-free single-producer/single-consumer slot holding the latest value
+// stored (triple buffer). store() may only be called from one thread and
+// take() from one other thread. store() never fails: a value not taken yet
+// is replaced by the newer one. Neither side locks or allocates, so the
+// consumer can be an audio callback.
+template <typename T>
+class LatestSlot {
+    static_assert(std::is_trivially_copyable<T>::value, "Slot values must be trivially copyable");
+
+public:
+    // Producer side
+    void store(const T& value) {
+        buffers_[back_] = value;
+        uint8_t previous = middle_.exchange(static_cast<uint8_t>(back_ | FRESH), std::memory_order_acq_rel);
+        back_ = previous & INDEX;
+    }
+
+    // Consumer side. Returns false if nothing was stored since the last take.
+    bool take(T& value) {
+        if ((middle_.load(std::memory_order_acquire) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & INDEX;
+        value = buffers_[front_];
+        return true;
+    }
+
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;  // set while middle_ holds an untaken value
+
+    // Buffer handed between the sides, exchanged for the producer's back
+    // buffer on store() and the consumer's front buffer on take()
+    std::atomic<uint8_t> middle_{1};
+    uint8_t back_ = 0;   // written by the producer
+    uint8_t front_ = 2;  // read by the consumer
+    T buffers_[3];
+};
+
+// Fixed-capacity, lock-free multi-producer/single-consumer ring (bounded
+// queue with per-slot sequence numbers). Any thread may push(); pop() may
+// only be called from one thread. push() never blocks: it fails when full.
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "Ring elements must be trivially copyable");
+
+public:
+    MpscRing() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const T& item) {
+        size_t position = enqueuePosition_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[position & (Capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = item;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        Cell* cell = &cells_[dequeuePosition_ & (Capacity - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePosition_ + 1) {
+            return false;
+        }
+        item = cell->item;
+        cell->sequence.store(dequeuePosition_ + Capacity, std::memory_order_release);
+        ++dequeuePosition_;
+        return true;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueuePosition_{0};
+    alignas(CACHE_LINE_SIZE) size_t dequeuePosition_ = 0;
+    alignas(CACHE_LINE_SIZE) Cell cells_[Capacity];
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include "telemetry_packet.h"
+
+// Text log of what the receiver decided for every telemetry sample it acted
+// on, one line each:
+//
+//   <capture time s> <airframe> IAS=<m/s> AoA=<deg> <decision> [volume=<%>] [frequency=<Hz> pulse=<Hz>]
+//
+// Times are relative to the first datagram of the run or capture, so the
+// log of a replay can be diffed against the live run it was recorded from
+// and against replays of other builds. Written on the receiver thread
+// through a fixed stdio buffer.
+class DecisionLog {
+public:
+    ~DecisionLog() { close(); }
+
+    bool open(const std::string& path) {
+        file_ = std::fopen(path.c_str(), "w");
+        if (!file_) return false;
+        std::setvbuf(file_, buffer_, _IOFBF, sizeof(buffer_));
+        return true;
+    }
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    // decision is one of aoa, stall, stop, idle, synth, synth-stop, or
+    // effect:<name> and effect-stop:<name> when an effect cue starts and ends
+    void write(const TelemetrySample& sample, const char* decision, float volume = -1.0f,
+               float frequency = 0.0f, float pulseRate = 0.0f) {
+        if (!file_) return;
+        std::fprintf(file_, "%.6f %s IAS=%.2f AoA=%.2f %s", sample.captureTime / 1e6, sample.airframe,
+                     sample.IAS, sample.AoA, decision);
+        if (volume >= 0.0f) std::fprintf(file_, " volume=%.2f", volume);
+        if (frequency > 0.0f) std::fprintf(file_, " frequency=%.2f pulse=%.2f", frequency, pulseRate);
+        std::fputc('\n', file_);
+        ++decisions_;
+        // Bound what an abrupt exit loses to about a second of decisions
+        if (sample.captureTime >= flushedMicros_ + 1000000) {
+            std::fflush(file_);
+            flushedMicros_ = sample.captureTime;
+        }
+    }
+
+    uint64_t decisions() const { return decisions_; }
+
+    void close() {
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+private:
+    FILE* file_ = nullptr;
+    char buffer_[64 * 1024];
+    uint64_t flushedMicros_ = 0;
+    uint64_t decisions_ = 0;
+};
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "portaudio.h"
+#include "logger.h"
+
+// Host API used when the configuration does not name one
+#ifdef _WIN32
+constexpr const char* DEFAULT_HOST_API = "WASAPI";
+#else
+constexpr const char* DEFAULT_HOST_API = "";  // PortAudio's default host API
+#endif
+
+// One output device as PortAudio reported it
+struct AudioDeviceEntry {
+    int index = -1;          // PortAudio device index
+    std::string name;
+    int hostApi = -1;        // PortAudio host API index
+    std::string hostApiName;
+    int ordinal = 0;         // position among the host API's output devices
+    int outputChannels = 0;
+    double defaultSampleRate = 0.0;
+};
+
+// Output devices of every host API, scanned once per refresh() and looked
+// up through hash tables by name and by (host API, ordinal). Lookups prefer
+// the configured host API. PortAudio only rescans devices when it is
+// initialized, so the caller re-initializes it before refresh() to pick up
+// devices that were plugged in or removed. Safe to use from any thread.
+class DeviceRegistry {
+public:
+    // Rebuild the tables from the devices PortAudio currently reports
+    void refresh() {
+        std::vector<AudioDeviceEntry> devices;
+        std::unordered_map<int, int> ordinals;
+        int count = Pa_GetDeviceCount();
+        for (int i = 0; i < count; ++i) {
+            const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(i);
+            if (!deviceInfo || deviceInfo->maxOutputChannels <= 0) continue;
+            const PaHostApiInfo* hostApiInfo = Pa_GetHostApiInfo(deviceInfo->hostApi);
+
+            AudioDeviceEntry entry;
+            entry.index = i;
+            entry.name = deviceInfo->name ? deviceInfo->name : "";
+            entry.hostApi = deviceInfo->hostApi;
+            entry.hostApiName = hostApiInfo && hostApiInfo->name ? hostApiInfo->name : "";
+            entry.ordinal = ordinals[deviceInfo->hostApi]++;
+            entry.outputChannels = deviceInfo->maxOutputChannels;
+            entry.defaultSampleRate = deviceInfo->defaultSampleRate;
+            devices.push_back(std::move(entry));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        devices_ = std::move(devices);
+        ++generation_;
+        rebuildLocked();
+    }
+
+    // Select the host API by (part of) its name, case-insensitively; empty
+    // selects the platform default. Returns false if no host API matches,
+    // in which case PortAudio's default host API is used.
+    bool setPreferredHostApi(const std::string& name) {
+        std::string wanted = name.empty() ? DEFAULT_HOST_API : name;
+        int hostApi = Pa_GetDefaultHostApi();
+        bool found = wanted.empty();
+        for (int i = 0; !found && i < Pa_GetHostApiCount(); ++i) {
+            const PaHostApiInfo* info = Pa_GetHostApiInfo(i);
+            if (info && info->name && containsIgnoringCase(info->name, wanted)) {
+                hostApi = i;
+                found = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (hostApi != preferredHostApi_) {
+            preferredHostApi_ = hostApi;
+            rebuildLocked();
+        }
+        return found;
+    }
+
+    std::string preferredHostApiName() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const PaHostApiInfo* info = Pa_GetHostApiInfo(preferredHostApi_);
+        return info && info->name ? info->name : "";
+    }
+
+    // Device with this name, on the preferred host API if it has one.
+    // Returns -1 if no output device has the name.
+    int findByName(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = preferredByName_.find(name);
+        if (it != preferredByName_.end()) return it->second;
+        it = anyByName_.find(name);
+        return it != anyByName_.end() ? it->second : -1;
+    }
+
+    // The nth output device of the preferred host API, or -1
+    int findByOrdinal(int ordinal) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = byOrdinal_.find(ordinalKey(preferredHostApi_, ordinal));
+        return it != byOrdinal_.end() ? it->second : -1;
+    }
+
+    // First output device of the preferred host API, or of any, or -1
+    int defaultOutput() const {
+        int device = findByOrdinal(0);
+        if (device >= 0) return device;
+        std::lock_guard<std::mutex> lock(mutex_);
+        return devices_.empty() ? -1 : devices_.front().index;
+    }
+
+    bool isOutputDevice(int index) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return byIndex_.count(index) != 0;
+    }
+
+    // Name of an output device, empty if the index is not one
+    std::string deviceName(int index) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = byIndex_.find(index);
+        return it != byIndex_.end() ? devices_[it->second].name : std::string();
+    }
+
+    // Output devices of the preferred host API, in PortAudio order
+    std::vector<AudioDeviceEntry> preferredDevices() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<AudioDeviceEntry> result;
+        for (const AudioDeviceEntry& entry : devices_) {
+            if (entry.hostApi == preferredHostApi_) result.push_back(entry);
+        }
+        return result;
+    }
+
+    // Bumped by every refresh(); device indices from older generations are stale
+    uint64_t generation() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return generation_;
+    }
+
+private:
+    static uint64_t ordinalKey(int hostApi, int ordinal) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(hostApi)) << 32) | static_cast<uint32_t>(ordinal);
+    }
+
+    static bool containsIgnoringCase(const std::string& text, const std::string& part) {
+        auto it = std::search(text.begin(), text.end(), part.begin(), part.end(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        });
+        return it != text.end();
+    }
+
+    // Requires mutex_
+    void rebuildLocked() {
+        preferredByName_.clear();
+        anyByName_.clear();
+        byOrdinal_.clear();
+        byIndex_.clear();
+        for (size_t i = 0; i < devices_.size(); ++i) {
+            const AudioDeviceEntry& entry = devices_[i];
+            // The first device with a name wins, as a linear scan would pick it
+            anyByName_.emplace(entry.name, entry.index);
+            if (entry.hostApi == preferredHostApi_) preferredByName_.emplace(entry.name, entry.index);
+            byOrdinal_.emplace(ordinalKey(entry.hostApi, entry.ordinal), entry.index);
+            byIndex_.emplace(entry.index, i);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<AudioDeviceEntry> devices_;
+    std::unordered_map<std::string, int> preferredByName_;
+    std::unordered_map<std::string, int> anyByName_;
+    std::unordered_map<uint64_t, int> byOrdinal_;
+    std::unordered_map<int, size_t> byIndex_;  // device index -> devices_ position
+    int preferredHostApi_ = -1;
+    uint64_t generation_ = 0;
+};
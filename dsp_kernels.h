@@ -0,0 +1,487 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Sample processing kernels with SSE2/AVX2 paths and scalar fallbacks.
+//
+// The SIMD level is detected once at runtime; functions compiled for AVX2
+// use target attributes, so no extra compiler flags are needed. Channel
+// layouts are handled by specializing the kernel templates on the number of
+// interleaved channels; layouts without a specialization use the generic
+// scalar code. The scalar versions are the reference: the SIMD paths
+// produce bit-identical results.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define DCS_HAPTIC_X86_SIMD 1
+#include <immintrin.h>
+#define DCS_HAPTIC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DCS_HAPTIC_X86_SIMD 0
+#endif
+
+enum class SimdLevel : int {
+    Scalar = 0,
+    SSE2 = 1,
+    AVX2 = 2
+};
+
+inline const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+inline SimdLevel detectSimdLevel() {
+#if DCS_HAPTIC_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+inline std::atomic<int>& simdLevelOverride() {
+    static std::atomic<int> level{-1};
+    return level;
+}
+
+// SIMD level used by the kernels
+inline SimdLevel simdLevel() {
+    static const SimdLevel detected = detectSimdLevel();
+    int forced = simdLevelOverride().load(std::memory_order_relaxed);
+    if (forced >= 0 && forced < static_cast<int>(detected)) {
+        return static_cast<SimdLevel>(forced);
+    }
+    return detected;
+}
+
+// Cap the SIMD level (used by the benchmarks to compare implementations).
+// Levels above what the CPU supports are ignored.
+inline void forceSimdLevel(SimdLevel level) {
+    simdLevelOverride().store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+// Routing matrices map up to MIX_MAX_SOURCES source channels onto up to
+// MIX_MAX_OUTPUTS output channels (7.1). Gains are stored source-major,
+// gain[s * MIX_MAX_OUTPUTS + o], so one source's column is contiguous.
+constexpr int MIX_MAX_OUTPUTS = 8;
+constexpr int MIX_MAX_SOURCES = 2;
+constexpr int MIX_MATRIX_SIZE = MIX_MAX_SOURCES * MIX_MAX_OUTPUTS;
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+
+// Scale the first channel by gainLeft and the second by gainRight, leaving
+// any further channels untouched
+inline void applyGainScalar(float* data, size_t frames, int channels, float gainLeft, float gainRight) {
+    for (size_t i = 0; i < frames * channels; i += channels) {
+        data[i] *= gainLeft;
+        if (channels > 1) {
+            data[i + 1] *= gainRight;
+        }
+    }
+}
+
+inline void clampScalar(float* data, size_t count, float threshold) {
+    for (size_t i = 0; i < count; ++i) {
+        if (data[i] > threshold) {
+            data[i] = threshold;
+        } else if (data[i] < -threshold) {
+            data[i] = -threshold;
+        }
+    }
+}
+
+inline float peakScalar(const float* data, size_t count) {
+    float maxPeak = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        float absSample = data[i] < 0.0f ? -data[i] : data[i];
+        if (absSample > maxPeak) {
+            maxPeak = absSample;
+        }
+    }
+    return maxPeak;
+}
+
+// Mix the first two source channels into the output with a linear gain ramp:
+// frame k uses gain + step * (k + 1). Mono sources feed both outputs, extra
+// output channels are left untouched.
+inline void mixRampScalar(float* out, int outChannels, const float* src, int srcChannels, size_t frames,
+                          float gainLeft, float gainRight, float stepLeft, float stepRight) {
+    for (size_t k = 0; k < frames; ++k) {
+        float left = src[k * srcChannels];
+        float right = srcChannels > 1 ? src[k * srcChannels + 1] : left;
+        float ramp = static_cast<float>(k + 1);
+        float gl = gainLeft + stepLeft * ramp;
+        float gr = gainRight + stepRight * ramp;
+        if (outChannels > 1) {
+            out[k * outChannels] += left * gl;
+            out[k * outChannels + 1] += right * gr;
+        } else {
+            out[k] += left * gl;
+        }
+    }
+}
+
+// Mix a source clip through a routing matrix with a linear gain ramp: output
+// channel o of frame k gets the sum over sources s of
+// src[s] * (gain[s][o] + step[s][o] * (k + 1)), added in source order. Only
+// the first min(srcChannels, MIX_MAX_SOURCES) source channels are read.
+inline void mixMatrixRampScalar(float* out, int outChannels, const float* src, int srcChannels, size_t frames,
+                                const float* gain, const float* step) {
+    int sources = srcChannels < MIX_MAX_SOURCES ? srcChannels : MIX_MAX_SOURCES;
+    int outputs = outChannels < MIX_MAX_OUTPUTS ? outChannels : MIX_MAX_OUTPUTS;
+    for (size_t k = 0; k < frames; ++k) {
+        float ramp = static_cast<float>(k + 1);
+        float* frame = out + k * outChannels;
+        for (int o = 0; o < outputs; ++o) {
+            float mixed = frame[o];
+            for (int s = 0; s < sources; ++s) {
+                int i = s * MIX_MAX_OUTPUTS + o;
+                mixed += src[k * srcChannels + s] * (gain[i] + step[i] * ramp);
+            }
+            frame[o] = mixed;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SIMD kernels
+
+#if DCS_HAPTIC_X86_SIMD
+
+inline void clampSSE2(float* data, size_t count, float threshold) {
+    const __m128 hi = _mm_set1_ps(threshold);
+    const __m128 lo = _mm_set1_ps(-threshold);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Operand order keeps NaN samples unchanged, like the scalar code
+        __m128 x = _mm_loadu_ps(data + i);
+        _mm_storeu_ps(data + i, _mm_min_ps(hi, _mm_max_ps(lo, x)));
+    }
+    clampScalar(data + i, count - i, threshold);
+}
+
+DCS_HAPTIC_TARGET_AVX2 inline void clampAVX2(float* data, size_t count, float threshold) {
+    const __m256 hi = _mm256_set1_ps(threshold);
+    const __m256 lo = _mm256_set1_ps(-threshold);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(data + i);
+        _mm256_storeu_ps(data + i, _mm256_min_ps(hi, _mm256_max_ps(lo, x)));
+    }
+    clampScalar(data + i, count - i, threshold);
+}
+
+inline float peakSSE2(const float* data, size_t count) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // max(x, peak) keeps peak when x is NaN, matching the scalar compare
+        __m128 x = _mm_and_ps(_mm_loadu_ps(data + i), absMask);
+        peak = _mm_max_ps(x, peak);
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak);
+    float maxPeak = peakScalar(data + i, count - i);
+    for (float lane : lanes) {
+        if (lane > maxPeak) maxPeak = lane;
+    }
+    return maxPeak;
+}
+
+DCS_HAPTIC_TARGET_AVX2 inline float peakAVX2(const float* data, size_t count) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_and_ps(_mm256_loadu_ps(data + i), absMask);
+        peak = _mm256_max_ps(x, peak);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, peak);
+    float maxPeak = peakScalar(data + i, count - i);
+    for (float lane : lanes) {
+        if (lane > maxPeak) maxPeak = lane;
+    }
+    return maxPeak;
+}
+
+// Matrix mix with the output channels of a frame in one vector: every source
+// sample is broadcast and multiplied by its gain column. Outputs beyond
+// outChannels are masked off, so any layout up to 7.1 takes this path.
+DCS_HAPTIC_TARGET_AVX2 inline void mixMatrixRampAVX2(float* out, int outChannels, const float* src, int srcChannels,
+                                                     size_t frames, const float* gain, const float* step) {
+    int sources = srcChannels < MIX_MAX_SOURCES ? srcChannels : MIX_MAX_SOURCES;
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(outChannels), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 gains[MIX_MAX_SOURCES];
+    __m256 steps[MIX_MAX_SOURCES];
+    for (int s = 0; s < sources; ++s) {
+        gains[s] = _mm256_loadu_ps(gain + s * MIX_MAX_OUTPUTS);
+        steps[s] = _mm256_loadu_ps(step + s * MIX_MAX_OUTPUTS);
+    }
+    for (size_t k = 0; k < frames; ++k) {
+        __m256 ramp = _mm256_set1_ps(static_cast<float>(k + 1));
+        float* frame = out + k * outChannels;
+        __m256 mixed = _mm256_maskload_ps(frame, mask);
+        for (int s = 0; s < sources; ++s) {
+            __m256 g = _mm256_add_ps(gains[s], _mm256_mul_ps(steps[s], ramp));
+            mixed = _mm256_add_ps(mixed, _mm256_mul_ps(_mm256_set1_ps(src[k * srcChannels + s]), g));
+        }
+        _mm256_maskstore_ps(frame, mask, mixed);
+    }
+}
+
+// The same for outputs in groups of four (quad and 7.1)
+inline void mixMatrixRampSSE2(float* out, int outChannels, const float* src, int srcChannels, size_t frames,
+                              const float* gain, const float* step) {
+    int sources = srcChannels < MIX_MAX_SOURCES ? srcChannels : MIX_MAX_SOURCES;
+    for (size_t k = 0; k < frames; ++k) {
+        __m128 ramp = _mm_set1_ps(static_cast<float>(k + 1));
+        float* frame = out + k * outChannels;
+        for (int o = 0; o < outChannels; o += 4) {
+            __m128 mixed = _mm_loadu_ps(frame + o);
+            for (int s = 0; s < sources; ++s) {
+                int i = s * MIX_MAX_OUTPUTS + o;
+                __m128 g = _mm_add_ps(_mm_loadu_ps(gain + i), _mm_mul_ps(_mm_loadu_ps(step + i), ramp));
+                mixed = _mm_add_ps(mixed, _mm_mul_ps(_mm_set1_ps(src[k * srcChannels + s]), g));
+            }
+            _mm_storeu_ps(frame + o, mixed);
+        }
+    }
+}
+
+#endif
+
+// Interleaved kernels, specialized by channel count
+template <int Channels>
+struct InterleavedKernels {
+    static void applyGain(float* data, size_t frames, float gainLeft, float gainRight) {
+        applyGainScalar(data, frames, Channels, gainLeft, gainRight);
+    }
+
+    static void mixRampStereo(float* out, const float* src, size_t frames,
+                              float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        mixRampScalar(out, 2, src, Channels, frames, gainLeft, gainRight, stepLeft, stepRight);
+    }
+};
+
+#if DCS_HAPTIC_X86_SIMD
+
+template <>
+struct InterleavedKernels<1> {
+    static void applyGainSSE2(float* data, size_t frames, float gain) {
+        const __m128 g = _mm_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 4 <= frames; i += 4) {
+            _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+        }
+        applyGainScalar(data + i, frames - i, 1, gain, gain);
+    }
+
+    DCS_HAPTIC_TARGET_AVX2 static void applyGainAVX2(float* data, size_t frames, float gain) {
+        const __m256 g = _mm256_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 8 <= frames; i += 8) {
+            _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+        }
+        applyGainScalar(data + i, frames - i, 1, gain, gain);
+    }
+
+    static void applyGain(float* data, size_t frames, float gainLeft, float) {
+        switch (simdLevel()) {
+            case SimdLevel::AVX2: applyGainAVX2(data, frames, gainLeft); break;
+            case SimdLevel::SSE2: applyGainSSE2(data, frames, gainLeft); break;
+            default: applyGainScalar(data, frames, 1, gainLeft, gainLeft); break;
+        }
+    }
+
+    static void mixRampStereo(float* out, const float* src, size_t frames,
+                              float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        mixRampScalar(out, 2, src, 1, frames, gainLeft, gainRight, stepLeft, stepRight);
+    }
+};
+
+template <>
+struct InterleavedKernels<2> {
+    static void applyGainSSE2(float* data, size_t frames, float gainLeft, float gainRight) {
+        const __m128 g = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+        size_t count = frames * 2;
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+        }
+        applyGainScalar(data + i, (count - i) / 2, 2, gainLeft, gainRight);
+    }
+
+    DCS_HAPTIC_TARGET_AVX2 static void applyGainAVX2(float* data, size_t frames, float gainLeft, float gainRight) {
+        const __m256 g = _mm256_setr_ps(gainLeft, gainRight, gainLeft, gainRight,
+                                        gainLeft, gainRight, gainLeft, gainRight);
+        size_t count = frames * 2;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+        }
+        applyGainScalar(data + i, (count - i) / 2, 2, gainLeft, gainRight);
+    }
+
+    static void applyGain(float* data, size_t frames, float gainLeft, float gainRight) {
+        switch (simdLevel()) {
+            case SimdLevel::AVX2: applyGainAVX2(data, frames, gainLeft, gainRight); break;
+            case SimdLevel::SSE2: applyGainSSE2(data, frames, gainLeft, gainRight); break;
+            default: applyGainScalar(data, frames, 2, gainLeft, gainRight); break;
+        }
+    }
+
+    static void mixRampSSE2(float* out, const float* src, size_t frames,
+                            float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        const __m128 base = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+        const __m128 step = _mm_setr_ps(stepLeft, stepRight, stepLeft, stepRight);
+        const __m128 two = _mm_set1_ps(2.0f);
+        __m128 ramp = _mm_setr_ps(1.0f, 1.0f, 2.0f, 2.0f);
+        size_t k = 0;
+        for (; k + 2 <= frames; k += 2) {
+            __m128 gain = _mm_add_ps(base, _mm_mul_ps(step, ramp));
+            __m128 mixed = _mm_add_ps(_mm_loadu_ps(out + 2 * k), _mm_mul_ps(_mm_loadu_ps(src + 2 * k), gain));
+            _mm_storeu_ps(out + 2 * k, mixed);
+            ramp = _mm_add_ps(ramp, two);
+        }
+        mixTail(out, src, frames, k, gainLeft, gainRight, stepLeft, stepRight);
+    }
+
+    DCS_HAPTIC_TARGET_AVX2 static void mixRampAVX2(float* out, const float* src, size_t frames,
+                                                   float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        const __m256 base = _mm256_setr_ps(gainLeft, gainRight, gainLeft, gainRight,
+                                           gainLeft, gainRight, gainLeft, gainRight);
+        const __m256 step = _mm256_setr_ps(stepLeft, stepRight, stepLeft, stepRight,
+                                           stepLeft, stepRight, stepLeft, stepRight);
+        const __m256 four = _mm256_set1_ps(4.0f);
+        __m256 ramp = _mm256_setr_ps(1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f, 4.0f, 4.0f);
+        size_t k = 0;
+        for (; k + 4 <= frames; k += 4) {
+            __m256 gain = _mm256_add_ps(base, _mm256_mul_ps(step, ramp));
+            __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(out + 2 * k),
+                                         _mm256_mul_ps(_mm256_loadu_ps(src + 2 * k), gain));
+            _mm256_storeu_ps(out + 2 * k, mixed);
+            ramp = _mm256_add_ps(ramp, four);
+        }
+        mixTail(out, src, frames, k, gainLeft, gainRight, stepLeft, stepRight);
+    }
+
+    static void mixRampStereo(float* out, const float* src, size_t frames,
+                              float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        switch (simdLevel()) {
+            case SimdLevel::AVX2: mixRampAVX2(out, src, frames, gainLeft, gainRight, stepLeft, stepRight); break;
+            case SimdLevel::SSE2: mixRampSSE2(out, src, frames, gainLeft, gainRight, stepLeft, stepRight); break;
+            default: mixRampScalar(out, 2, src, 2, frames, gainLeft, gainRight, stepLeft, stepRight); break;
+        }
+    }
+
+private:
+    // Remaining frames, continuing the ramp from frame k
+    static void mixTail(float* out, const float* src, size_t frames, size_t k,
+                        float gainLeft, float gainRight, float stepLeft, float stepRight) {
+        for (; k < frames; ++k) {
+            float ramp = static_cast<float>(k + 1);
+            out[2 * k] += src[2 * k] * (gainLeft + stepLeft * ramp);
+            out[2 * k + 1] += src[2 * k + 1] * (gainRight + stepRight * ramp);
+        }
+    }
+};
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Dispatching entry points
+
+// Apply per-channel gain to interleaved audio (first two channels only)
+inline void applyInterleavedGain(float* data, size_t frames, int channels, float gainLeft, float gainRight) {
+    switch (channels) {
+        case 1: InterleavedKernels<1>::applyGain(data, frames, gainLeft, gainRight); break;
+        case 2: InterleavedKernels<2>::applyGain(data, frames, gainLeft, gainRight); break;
+        default: applyGainScalar(data, frames, channels, gainLeft, gainRight); break;
+    }
+}
+
+// Clamp every sample to [-threshold, threshold]
+inline void clampSamples(float* data, size_t count, float threshold) {
+#if DCS_HAPTIC_X86_SIMD
+    switch (simdLevel()) {
+        case SimdLevel::AVX2: clampAVX2(data, count, threshold); return;
+        case SimdLevel::SSE2: clampSSE2(data, count, threshold); return;
+        default: break;
+    }
+#endif
+    clampScalar(data, count, threshold);
+}
+
+// Largest absolute sample value
+inline float peakAbsolute(const float* data, size_t count) {
+#if DCS_HAPTIC_X86_SIMD
+    switch (simdLevel()) {
+        case SimdLevel::AVX2: return peakAVX2(data, count);
+        case SimdLevel::SSE2: return peakSSE2(data, count);
+        default: break;
+    }
+#endif
+    return peakScalar(data, count);
+}
+
+// Mix a source clip into an interleaved output buffer with a gain ramp
+inline void mixInterleavedRamp(float* out, int outChannels, const float* src, int srcChannels, size_t frames,
+                               float gainLeft, float gainRight, float stepLeft, float stepRight) {
+    if (outChannels == 2 && srcChannels == 2) {
+        InterleavedKernels<2>::mixRampStereo(out, src, frames, gainLeft, gainRight, stepLeft, stepRight);
+    } else if (outChannels == 2 && srcChannels == 1) {
+        InterleavedKernels<1>::mixRampStereo(out, src, frames, gainLeft, gainRight, stepLeft, stepRight);
+    } else {
+        mixRampScalar(out, outChannels, src, srcChannels, frames, gainLeft, gainRight, stepLeft, stepRight);
+    }
+}
+
+// True if a matrix only feeds source 0 to output 0 and source 1 to output 1
+// (a mono source: source 0 to outputs 0 and 1), the layout of the stereo kernels
+inline bool isStereoMatrix(const float* gain, const float* step, int srcChannels) {
+    for (int s = 0; s < MIX_MAX_SOURCES; ++s) {
+        for (int o = 0; o < MIX_MAX_OUTPUTS; ++o) {
+            bool stereo = srcChannels == 1 ? (s == 0 && o < 2) : (s == o);
+            int i = s * MIX_MAX_OUTPUTS + o;
+            if (!stereo && (gain[i] != 0.0f || step[i] != 0.0f)) return false;
+        }
+    }
+    return true;
+}
+
+// Mix a source clip into an interleaved output buffer through a routing
+// matrix with a gain ramp, in one pass over the block. Stereo layouts on a
+// stereo output use the stereo kernels.
+inline void mixMatrixRamp(float* out, int outChannels, const float* src, int srcChannels, size_t frames,
+                          const float* gain, const float* step) {
+    if (outChannels == 2 && srcChannels <= 2 && isStereoMatrix(gain, step, srcChannels)) {
+        int right = srcChannels == 1 ? 1 : MIX_MAX_OUTPUTS + 1;
+        mixInterleavedRamp(out, 2, src, srcChannels, frames, gain[0], gain[right], step[0], step[right]);
+        return;
+    }
+#if DCS_HAPTIC_X86_SIMD
+    switch (simdLevel()) {
+        case SimdLevel::AVX2:
+            if (outChannels <= MIX_MAX_OUTPUTS) {
+                mixMatrixRampAVX2(out, outChannels, src, srcChannels, frames, gain, step);
+                return;
+            }
+            break;
+        case SimdLevel::SSE2:
+            if (outChannels % 4 == 0 && outChannels <= MIX_MAX_OUTPUTS) {
+                mixMatrixRampSSE2(out, outChannels, src, srcChannels, frames, gain, step);
+                return;
+            }
+            break;
+        default: break;
+    }
+#endif
+    mixMatrixRampScalar(out, outChannels, src, srcChannels, frames, gain, step);
+}
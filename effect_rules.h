@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "channel_routing.h"
+#include "haptic_synth.h"
+#include "telemetry_packet.h"
+
+// Effect rules: extra haptic cues declared in the .cfg files, one per line:
+//
+//   Effect=<name> when <condition> [and <condition>]... play <frequency> Hz
+//          [pulse <rate> Hz] volume <percent> [by <parameter> <low>..<high>]
+//          [for <seconds> s] [layer <1-4>] [square] [route <routing>]
+//
+// A condition is a parameter and an inclusive range, either end of which may
+// be left open: "G 6..", "vspeed ..-1.5", "gear 0.5..1". Frequency, pulse
+// rate and volume may be ranges too, interpolated by where the "by"
+// parameter lies in its range. A rule with "for" is a one-shot: it plays for
+// that long each time its conditions become true, e.g. a touchdown bump.
+// "route" takes the routing syntax of channel_routing.h; without it the cue
+// follows the AOA warning's routing or balance.
+//
+// Each layer plays one cue at a time, the first rule of the layer, in the
+// order declared, whose conditions hold. The rules are compiled once per
+// profile into columns (EffectRuleSet) and every telemetry packet is tested
+// against all of them in one pass without allocating (EffectEvaluator).
+
+// Telemetry values a rule can test, IAS and AoA followed by the optional
+// fields of the sample payload
+enum EffectParameter : uint8_t {
+    EFFECT_IAS = 0,
+    EFFECT_AOA,
+    EFFECT_G,
+    EFFECT_GEAR,
+    EFFECT_FLAPS,
+    EFFECT_RPM,
+    EFFECT_VERTICAL_SPEED,
+    EFFECT_ALTITUDE_AGL,
+    EFFECT_PARAMETER_COUNT,
+    EFFECT_ALWAYS = EFFECT_PARAMETER_COUNT  // constant 0, fills unused condition slots
+};
+static_assert(EFFECT_PARAMETER_COUNT == 2 + TELEMETRY_EXTRA_COUNT, "effect parameters follow the sample fields");
+
+constexpr int EFFECT_VALUE_COUNT = EFFECT_PARAMETER_COUNT + 1;
+constexpr int EFFECT_MAX_CONDITIONS = 4;
+// Cues that can play at once; each has its own synth voice in the mixers
+constexpr int EFFECT_LAYERS = 4;
+
+inline const char* effectParameterName(EffectParameter parameter) {
+    static const char* const names[EFFECT_VALUE_COUNT] = {"IAS", "AoA", "G", "gear", "flaps", "rpm",
+                                                           "vspeed", "agl", "always"};
+    return parameter <= EFFECT_ALWAYS ? names[parameter] : "?";
+}
+
+inline bool parseEffectParameter(const std::string& name, EffectParameter& parameter) {
+    for (int i = 0; i < EFFECT_PARAMETER_COUNT; ++i) {
+        const char* known = effectParameterName(static_cast<EffectParameter>(i));
+        if (name.size() == std::strlen(known) &&
+            std::equal(name.begin(), name.end(), known, [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            })) {
+            parameter = static_cast<EffectParameter>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Values of a sample indexed by EffectParameter; NaN fails every condition
+inline void effectValues(const TelemetrySample& sample, float* values) {
+    values[EFFECT_IAS] = sample.IAS;
+    values[EFFECT_AOA] = sample.AoA;
+    for (int i = 0; i < TELEMETRY_EXTRA_COUNT; ++i) {
+        values[EFFECT_G + i] = sample.extra[i];
+    }
+    values[EFFECT_ALWAYS] = 0.0f;
+}
+
+// One rule as declared
+struct EffectRule {
+    struct Condition {
+        EffectParameter parameter = EFFECT_ALWAYS;
+        float low = -std::numeric_limits<float>::infinity();
+        float high = std::numeric_limits<float>::infinity();
+    };
+
+    std::string name;
+    Condition conditions[EFFECT_MAX_CONDITIONS];
+    int conditionCount = 0;
+    // Cue at intensity 0 and 1
+    float frequency[2] = {0.0f, 0.0f};
+    float pulseRate[2] = {0.0f, 0.0f};
+    float volume[2] = {0.0f, 0.0f};
+    // Intensity is where this parameter lies in [low, high]; 1 without "by"
+    EffectParameter intensityParameter = EFFECT_ALWAYS;
+    float intensityLow = 0.0f;
+    float intensityHigh = 1.0f;
+    float duration = 0.0f;  // seconds a one-shot plays, 0 while the conditions hold
+    int layer = 0;
+    SynthWaveform waveform = SynthWaveform::Sine;
+    ChannelRouting routing;
+};
+
+namespace effect_rule_detail {
+
+// "a..b", "a..", "..b" or, if allowSingle, "a"
+inline bool parseRange(const std::string& text, float& low, float& high, bool allowSingle) {
+    auto number = [](const std::string& part, float& value) {
+        if (part.empty()) return false;
+        char* end = nullptr;
+        value = std::strtof(part.c_str(), &end);
+        return end == part.c_str() + part.size();
+    };
+    size_t dots = text.find("..");
+    if (dots == std::string::npos) {
+        if (!allowSingle || !number(text, low)) return false;
+        high = low;
+        return true;
+    }
+    std::string first = text.substr(0, dots);
+    std::string second = text.substr(dots + 2);
+    if (first.empty() && second.empty()) return false;
+    if (!first.empty() && !number(first, low)) return false;
+    if (!second.empty() && !number(second, high)) return false;
+    return true;
+}
+
+}  // namespace effect_rule_detail
+
+// Parse the value of an Effect line. Returns false with error set if the
+// rule is malformed.
+inline bool parseEffectRule(const std::string& text, EffectRule& rule, std::string& error) {
+    using effect_rule_detail::parseRange;
+    std::istringstream tokens(text);
+    std::vector<std::string> words;
+    for (std::string word; tokens >> word;) {
+        // Units are accepted for readability
+        if (word != "Hz" && word != "hz" && word != "s" && word != "%") words.push_back(word);
+    }
+
+    EffectRule parsed;
+    size_t i = 0;
+    auto next = [&](std::string& word) {
+        if (i >= words.size()) return false;
+        word = words[i++];
+        return true;
+    };
+    std::string word;
+    if (!next(parsed.name) || parsed.name == "when") {
+        error = "missing effect name";
+        return false;
+    }
+    if (!next(word) || word != "when") {
+        error = "expected 'when' after the name";
+        return false;
+    }
+
+    // Conditions up to "play"
+    for (;;) {
+        std::string name;
+        std::string range;
+        EffectRule::Condition condition;
+        if (!next(name) || !next(range) || !parseEffectParameter(name, condition.parameter) ||
+            !parseRange(range, condition.low, condition.high, false)) {
+            error = "expected a condition such as 'G 6..' before 'play'";
+            return false;
+        }
+        if (parsed.conditionCount == EFFECT_MAX_CONDITIONS) {
+            error = "more than " + std::to_string(EFFECT_MAX_CONDITIONS) + " conditions";
+            return false;
+        }
+        parsed.conditions[parsed.conditionCount++] = condition;
+        if (!next(word)) {
+            error = "missing 'play'";
+            return false;
+        }
+        if (word == "play") break;
+        if (word != "and") {
+            error = "expected 'and' or 'play', got '" + word + "'";
+            return false;
+        }
+    }
+
+    if (!next(word) || !parseRange(word, parsed.frequency[0], parsed.frequency[1], true) ||
+        parsed.frequency[0] <= 0.0f || parsed.frequency[1] <= 0.0f) {
+        error = "expected a frequency in Hz after 'play'";
+        return false;
+    }
+    bool haveVolume = false;
+    while (next(word)) {
+        std::string value;
+        if (word == "pulse" && next(value) && parseRange(value, parsed.pulseRate[0], parsed.pulseRate[1], true) &&
+            parsed.pulseRate[0] >= 0.0f && parsed.pulseRate[1] >= 0.0f) {
+            continue;
+        }
+        if (word == "volume" && next(value) && parseRange(value, parsed.volume[0], parsed.volume[1], true) &&
+            std::min(parsed.volume[0], parsed.volume[1]) >= 0.0f &&
+            std::max(parsed.volume[0], parsed.volume[1]) <= 100.0f) {
+            haveVolume = true;
+            continue;
+        }
+        if (word == "by") {
+            std::string name;
+            if (next(name) && next(value) && parseEffectParameter(name, parsed.intensityParameter) &&
+                parseRange(value, parsed.intensityLow, parsed.intensityHigh, false) &&
+                std::isfinite(parsed.intensityLow) && std::isfinite(parsed.intensityHigh) &&
+                parsed.intensityHigh != parsed.intensityLow) {
+                continue;
+            }
+            error = "expected 'by <parameter> <low>..<high>'";
+            return false;
+        }
+        if (word == "for" && next(value)) {
+            char* end = nullptr;
+            parsed.duration = std::strtof(value.c_str(), &end);
+            if (end == value.c_str() + value.size() && parsed.duration > 0.0f) continue;
+        }
+        if (word == "layer" && next(value)) {
+            parsed.layer = std::atoi(value.c_str()) - 1;
+            if (parsed.layer >= 0 && parsed.layer < EFFECT_LAYERS) continue;
+        }
+        if (word == "square") {
+            parsed.waveform = SynthWaveform::Square;
+            continue;
+        }
+        if (word == "route") {
+            std::string routingError;
+            if (next(value) && parseChannelRouting(value, parsed.routing, routingError)) continue;
+            error = "bad route: " + routingError;
+            return false;
+        }
+        error = "unexpected '" + word + "'";
+        return false;
+    }
+    if (!haveVolume) {
+        error = "missing volume";
+        return false;
+    }
+    rule = parsed;
+    return true;
+}
+
+// Cue a layer should play after a packet; rule is -1 when the layer is silent
+struct EffectCue {
+    int rule = -1;
+    float volume = 0.0f;
+    float frequency = 0.0f;
+    float pulseRate = 0.0f;
+};
+
+// Rules of a profile compiled into columns, one entry per rule, so a packet
+// is tested against every rule with a few linear scans
+class EffectRuleSet {
+public:
+    explicit EffectRuleSet(std::vector<EffectRule> rules) : rules_(std::move(rules)) {
+        size_t count = rules_.size();
+        for (const EffectRule& rule : rules_) {
+            columns_ = std::max(columns_, rule.conditionCount);
+        }
+        for (int c = 0; c < columns_; ++c) {
+            parameter_[c].resize(count);
+            low_[c].resize(count);
+            high_[c].resize(count);
+            for (size_t i = 0; i < count; ++i) {
+                const EffectRule::Condition& condition = rules_[i].conditions[c];
+                parameter_[c][i] = condition.parameter;
+                low_[c][i] = condition.low;
+                high_[c][i] = condition.high;
+            }
+        }
+        layer_.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            layer_[i] = static_cast<uint8_t>(rules_[i].layer);
+            layersUsed_ |= 1u << rules_[i].layer;
+            if (rules_[i].duration > 0.0f) {
+                oneShots_.push_back(static_cast<uint32_t>(i));
+                durationMicros_.push_back(static_cast<uint64_t>(rules_[i].duration * 1e6));
+            }
+        }
+    }
+
+    size_t size() const { return rules_.size(); }
+    const EffectRule& rule(size_t index) const { return rules_[index]; }
+
+private:
+    friend class EffectEvaluator;
+
+    std::vector<EffectRule> rules_;  // names and cues, read for the winners only
+    int columns_ = 0;                // most conditions of any rule
+    std::vector<uint8_t> parameter_[EFFECT_MAX_CONDITIONS];
+    std::vector<float> low_[EFFECT_MAX_CONDITIONS];
+    std::vector<float> high_[EFFECT_MAX_CONDITIONS];
+    std::vector<uint8_t> layer_;
+    unsigned layersUsed_ = 0;
+    std::vector<uint32_t> oneShots_;       // rules with a duration
+    std::vector<uint64_t> durationMicros_; // parallel to oneShots_
+};
+
+// Per-receiver state of a rule set: scratch for the matches and the one-shot
+// timers. Sized by reset(), so evaluate() never allocates.
+class EffectEvaluator {
+public:
+    void reset(const EffectRuleSet* rules) {
+        rules_ = rules;
+        size_t count = rules ? rules->size() : 0;
+        match_.assign(count, 0);
+        size_t oneShots = rules ? rules->oneShots_.size() : 0;
+        armed_.assign(oneShots, 1);
+        holdUntil_.assign(oneShots, 0);
+    }
+
+    // Test one sample against every rule. values are indexed by
+    // EffectParameter (see effectValues), timeMicros is the capture time
+    // one-shots are timed with. Fills cues[EFFECT_LAYERS].
+    void evaluate(const float* values, uint64_t timeMicros, EffectCue* cues) {
+        for (int layer = 0; layer < EFFECT_LAYERS; ++layer) {
+            cues[layer] = EffectCue();
+        }
+        if (!rules_ || rules_->size() == 0) return;
+
+        const EffectRuleSet& rules = *rules_;
+        size_t count = rules.size();
+        uint8_t* match = match_.data();
+        std::fill(match, match + count, static_cast<uint8_t>(1));
+        // Unused slots test the constant 0 against an unbounded range
+        for (int c = 0; c < rules.columns_; ++c) {
+            const uint8_t* parameter = rules.parameter_[c].data();
+            const float* low = rules.low_[c].data();
+            const float* high = rules.high_[c].data();
+            for (size_t i = 0; i < count; ++i) {
+                float value = values[parameter[i]];
+                match[i] &= static_cast<uint8_t>((value >= low[i]) & (value <= high[i]));
+            }
+        }
+
+        // A one-shot starts on the packet its conditions become true and
+        // stays on for its duration
+        for (size_t k = 0; k < rules.oneShots_.size(); ++k) {
+            uint32_t i = rules.oneShots_[k];
+            if (match[i] && armed_[k]) {
+                holdUntil_[k] = timeMicros + rules.durationMicros_[k];
+            }
+            armed_[k] = !match[i];
+            match[i] = timeMicros < holdUntil_[k];
+        }
+
+        // First active rule of each layer
+        unsigned open = rules.layersUsed_;
+        const uint8_t* layer = rules.layer_.data();
+        for (size_t i = 0; i < count && open != 0; ++i) {
+            unsigned bit = 1u << layer[i];
+            if (match[i] && (open & bit)) {
+                cues[layer[i]].rule = static_cast<int>(i);
+                open &= ~bit;
+            }
+        }
+
+        for (int l = 0; l < EFFECT_LAYERS; ++l) {
+            EffectCue& cue = cues[l];
+            if (cue.rule < 0) continue;
+            const EffectRule& rule = rules.rule(cue.rule);
+            float t = 1.0f;
+            if (rule.intensityParameter != EFFECT_ALWAYS) {
+                t = (values[rule.intensityParameter] - rule.intensityLow) / (rule.intensityHigh - rule.intensityLow);
+                // Also maps NaN to 0
+                t = t > 0.0f ? (t < 1.0f ? t : 1.0f) : 0.0f;
+            }
+            cue.volume = rule.volume[0] + t * (rule.volume[1] - rule.volume[0]);
+            cue.frequency = rule.frequency[0] + t * (rule.frequency[1] - rule.frequency[0]);
+            cue.pulseRate = rule.pulseRate[0] + t * (rule.pulseRate[1] - rule.pulseRate[0]);
+        }
+    }
+
+private:
+    const EffectRuleSet* rules_ = nullptr;
+    std::vector<uint8_t> match_;
+    std::vector<uint8_t> armed_;       // per one-shot: conditions were false on the last packet
+    std::vector<uint64_t> holdUntil_;  // per one-shot
+};
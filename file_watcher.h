@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include "logger.h"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// A batch is reported once no further change arrived for this long, so an
+// editor's save (truncate, write, rename...) produces a single callback
+constexpr std::chrono::milliseconds FILE_WATCH_DEBOUNCE{50};
+// Scan interval of the portable fallback
+constexpr std::chrono::milliseconds FILE_WATCH_POLL_INTERVAL{500};
+
+// Watches a set of directories and their subdirectories from an io_context
+// and reports the files that changed as "directory/relative/path" paths
+// with forward slashes. If events were lost, the directory itself is
+// reported and everything in it should be treated as changed. The callback
+// runs on the thread running the io_context; start() and stop() must be
+// called there too, or while it is not running.
+//
+// On Linux this waits on inotify until the kernel reports a change. A
+// watched directory that is deleted or moved away is looked for again
+// every FILE_WATCH_POLL_INTERVAL and reported as a whole once it is back.
+// Elsewhere the directories are scanned for modification time and size
+// changes every FILE_WATCH_POLL_INTERVAL.
+class DirectoryWatcher {
+public:
+    using Callback = std::function<void(const std::set<std::string>& paths)>;
+
+    ~DirectoryWatcher() { stop(); }
+
+    bool start(boost::asio::io_context& io, std::vector<std::string> directories, Callback callback) {
+        if (timer_) return false;
+        directories_ = std::move(directories);
+        callback_ = std::move(callback);
+        timer_ = std::make_unique<boost::asio::steady_timer>(io);
+
+#ifdef __linux__
+        rewatchTimer_ = std::make_unique<boost::asio::steady_timer>(io);
+        if (startInotify(io)) {
+            waitForInotify();
+            return true;
+        }
+        LOG_WARNING("Warning: inotify unavailable, polling for file changes instead");
+#endif
+        snapshot_ = scanDirectories();
+        schedulePoll();
+        return true;
+    }
+
+    void stop() {
+        if (!timer_) return;
+        timer_->cancel();
+#ifdef __linux__
+        rewatchTimer_->cancel();
+        closeInotify();
+        rewatchTimer_.reset();
+        missing_.clear();
+#endif
+        timer_.reset();
+        pending_.clear();
+    }
+
+    const char* backend() const {
+#ifdef __linux__
+        if (inotify_) return "inotify";
+#endif
+        return "polling";
+    }
+
+private:
+#ifdef __linux__
+    static constexpr uint32_t INOTIFY_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                               IN_DELETE_SELF | IN_MOVE_SELF;
+
+    bool startInotify(boost::asio::io_context& io) {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        inotifyFd_ = fd;
+        for (const std::string& directory : directories_) {
+            if (!addWatches(directory)) {
+                LOG_WARNING("Warning: Cannot watch directory {}", directory);
+                missing_.insert(directory);
+            }
+        }
+        if (watches_.empty()) {
+            ::close(fd);
+            inotifyFd_ = -1;
+            missing_.clear();
+            return false;
+        }
+        // The descriptor owns fd from here on
+        inotify_ = std::make_unique<boost::asio::posix::stream_descriptor>(io, fd);
+        if (!missing_.empty()) {
+            scheduleRewatch();
+        }
+        return true;
+    }
+
+    // Watch a directory and every directory below it
+    bool addWatches(const std::string& directory) {
+        int watch = inotify_add_watch(inotifyFd_, directory.c_str(), INOTIFY_EVENTS | IN_ONLYDIR);
+        if (watch < 0) {
+            return false;
+        }
+        watches_[watch] = directory;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+            if (entry.is_directory(ec)) {
+                addWatches(directory + "/" + entry.path().filename().string());
+            }
+        }
+        return true;
+    }
+
+    void closeInotify() {
+        if (inotify_) {
+            boost::system::error_code ec;
+            inotify_->close(ec);
+            inotify_.reset();
+        }
+        inotifyFd_ = -1;
+        watches_.clear();
+    }
+
+    // Sleep until the kernel reports a change; each one restarts the quiet
+    // period after which the batch is reported
+    void waitForInotify() {
+        inotify_->async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                             [this](const boost::system::error_code& error) {
+            if (error == boost::asio::error::operation_aborted) return;
+            if (error) {
+                LOG_ERROR("Error waiting for file changes: {}", error.message());
+                return;
+            }
+            readInotifyEvents(pending_);
+            reportAfterQuietPeriod();
+            waitForInotify();
+        });
+    }
+
+    void reportAfterQuietPeriod() {
+        timer_->expires_after(FILE_WATCH_DEBOUNCE);
+        timer_->async_wait([this](const boost::system::error_code& error) {
+            // Cancelled by a newer change, or stopped
+            if (error || pending_.empty()) return;
+            std::set<std::string> changed;
+            changed.swap(pending_);
+            callback_(changed);
+        });
+    }
+
+    void readInotifyEvents(std::set<std::string>& pending) {
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t length = ::read(inotify_->native_handle(), buffer, sizeof(buffer));
+            if (length <= 0) return;
+            for (char* p = buffer; p < buffer + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    pending.insert(directories_.begin(), directories_.end());
+                    continue;
+                }
+                auto it = watches_.find(event->wd);
+                if (it == watches_.end()) continue;
+                const std::string directory = it->second;
+
+                if (event->mask & IN_MOVE_SELF) {
+                    // The watch follows the directory to its new name;
+                    // dropping it is reported as IN_IGNORED below
+                    inotify_rm_watch(inotifyFd_, event->wd);
+                } else if (event->mask & IN_IGNORED) {
+                    // Deleted, moved away or unmounted
+                    watches_.erase(it);
+                    if (std::find(directories_.begin(), directories_.end(), directory) != directories_.end()) {
+                        LOG_WARNING("Warning: {}/ is gone, watching for it to come back", directory);
+                        missing_.insert(directory);
+                        scheduleRewatch();
+                    }
+                } else if (event->len > 0) {
+                    std::string path = directory + "/" + event->name;
+                    if ((event->mask & IN_ISDIR) == 0) {
+                        pending.insert(path);
+                    } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        // Files may have landed in it before it was watched
+                        addWatches(path);
+                        addFilesBelow(path, pending);
+                    }
+                }
+            }
+        }
+    }
+
+    static void addFilesBelow(const std::string& directory, std::set<std::string>& paths) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(directory, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            std::error_code fileError;
+            if (it->is_regular_file(fileError)) {
+                paths.insert(directory + "/" + it->path().lexically_relative(directory).generic_string());
+            }
+        }
+    }
+
+    // Look for watched directories that disappeared; one that is back is
+    // reported as a whole, as anything in it may have changed
+    void scheduleRewatch() {
+        rewatchTimer_->expires_after(FILE_WATCH_POLL_INTERVAL);
+        rewatchTimer_->async_wait([this](const boost::system::error_code& error) {
+            if (error) return;
+            for (auto it = missing_.begin(); it != missing_.end();) {
+                if (!addWatches(*it)) {
+                    ++it;
+                    continue;
+                }
+                LOG_INFO("Watching {}/ again", *it);
+                pending_.insert(*it);
+                it = missing_.erase(it);
+            }
+            if (!pending_.empty()) {
+                reportAfterQuietPeriod();
+            }
+            if (!missing_.empty()) {
+                scheduleRewatch();
+            }
+        });
+    }
+
+    std::unique_ptr<boost::asio::posix::stream_descriptor> inotify_;
+    int inotifyFd_ = -1;
+    std::map<int, std::string> watches_;
+    std::set<std::string> missing_;  // watched directories that disappeared
+    std::unique_ptr<boost::asio::steady_timer> rewatchTimer_;
+#endif
+
+    using FileState = std::pair<std::filesystem::file_time_type, uintmax_t>;
+
+    std::map<std::string, FileState> scanDirectories() const {
+        std::map<std::string, FileState> files;
+        for (const std::string& directory : directories_) {
+            std::error_code ec;
+            for (auto it = std::filesystem::recursive_directory_iterator(directory, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+                std::error_code fileError;
+                if (!it->is_regular_file(fileError)) continue;
+                FileState state{it->last_write_time(fileError), it->file_size(fileError)};
+                files[directory + "/" + it->path().lexically_relative(directory).generic_string()] = state;
+            }
+        }
+        return files;
+    }
+
+    void schedulePoll() {
+        timer_->expires_after(FILE_WATCH_POLL_INTERVAL);
+        timer_->async_wait([this](const boost::system::error_code& error) {
+            if (error) return;
+            std::map<std::string, FileState> current = scanDirectories();
+            std::set<std::string> changed;
+            for (const auto& [path, state] : current) {
+                auto it = snapshot_.find(path);
+                if (it == snapshot_.end() || it->second != state) changed.insert(path);
+            }
+            for (const auto& [path, state] : snapshot_) {
+                if (current.find(path) == current.end()) changed.insert(path);
+            }
+            snapshot_ = std::move(current);
+            if (!changed.empty()) {
+                callback_(changed);
+            }
+            schedulePoll();
+        });
+    }
+
+    std::vector<std::string> directories_;
+    Callback callback_;
+    std::map<std::string, FileState> snapshot_;
+    std::set<std::string> pending_;  // changes waiting for the quiet period
+    std::unique_ptr<boost::asio::steady_timer> timer_;
+};
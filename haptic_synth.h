@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Carrier shape of the synthesized cue
+enum class SynthWaveform : uint8_t {
+    Sine,
+    Square
+};
+
+// Time constant of the parameter smoothing. Long enough that a step in
+// any parameter never clicks, short enough to follow telemetry closely.
+constexpr double SYNTH_SMOOTHING_SECONDS = 0.02;
+// Peak level at full volume, the same headroom the clips are scaled to
+constexpr float SYNTH_PEAK_LEVEL = 0.7f;
+// Drive of the soft clipper that turns the sine into a rounded square
+constexpr float SYNTH_SQUARE_DRIVE = 3.0f;
+
+// Generates the haptic cue directly in the audio callback: a carrier at
+// bass shaker frequencies, gated by raised-cosine pulses. Every parameter
+// glides towards its target with a one-pole filter per sample, and the
+// oscillators keep their phase across changes, so telemetry updates are
+// followed within one buffer without clicks. Only touched from the audio
+// callback.
+class HapticSynth {
+public:
+    void prepare(double sampleRate) {
+        sampleRate_ = sampleRate > 0.0 ? sampleRate : 48000.0;
+        smoothing_ = static_cast<float>(1.0 - std::exp(-1.0 / (SYNTH_SMOOTHING_SECONDS * sampleRate_)));
+    }
+
+    // Move towards new parameters. Gains are linear (0..1) per output side;
+    // a pulse rate of 0 gives a continuous tone.
+    void setTarget(float gainLeft, float gainRight, float frequency, float pulseRate, SynthWaveform waveform) {
+        if (!active_) {
+            // Start from silence at the requested pitch and pulse rate
+            frequency_.value = frequency;
+            pulseRate_.value = pulseRate;
+            pulseDepth_.value = pulseRate > 0.0f ? 1.0f : 0.0f;
+            squareness_.value = waveform == SynthWaveform::Square ? 1.0f : 0.0f;
+            pulsePhase_ = 0.0;
+        }
+        gainLeft_.target = gainLeft;
+        gainRight_.target = gainRight;
+        frequency_.target = frequency;
+        // Keep the last rate while fading into a continuous tone, so the
+        // pulses dissolve instead of freezing halfway
+        if (pulseRate > 0.0f) pulseRate_.target = pulseRate;
+        pulseDepth_.target = pulseRate > 0.0f ? 1.0f : 0.0f;
+        squareness_.target = waveform == SynthWaveform::Square ? 1.0f : 0.0f;
+        active_ = true;
+        stopping_ = false;
+    }
+
+    // Fade out; the synth goes idle once it is silent
+    void stop() {
+        gainLeft_.target = 0.0f;
+        gainRight_.target = 0.0f;
+        stopping_ = active_;
+    }
+
+    bool active() const { return active_; }
+
+    // Add frames of the cue to an interleaved buffer with the given channel
+    // count. Mono outputs get the average of both gains.
+    void render(float* out, int channels, size_t frames) {
+        if (!active_) return;
+
+        const double twoPi = 6.283185307179586;
+        for (size_t i = 0; i < frames; ++i) {
+            float gainLeft = gainLeft_.step(smoothing_);
+            float gainRight = gainRight_.step(smoothing_);
+            float frequency = frequency_.step(smoothing_);
+            float pulseRate = pulseRate_.step(smoothing_);
+            float pulseDepth = pulseDepth_.step(smoothing_);
+            float squareness = squareness_.step(smoothing_);
+
+            float carrier = static_cast<float>(std::sin(twoPi * carrierPhase_));
+            float square = carrier * SYNTH_SQUARE_DRIVE;
+            square = square > 1.0f ? 1.0f : (square < -1.0f ? -1.0f : square);
+            carrier += squareness * (square - carrier);
+
+            // Raised cosine: each pulse starts and ends at zero
+            float pulse = 0.5f - 0.5f * static_cast<float>(std::cos(twoPi * pulsePhase_));
+            float sample = carrier * (1.0f - pulseDepth * (1.0f - pulse)) * SYNTH_PEAK_LEVEL;
+
+            if (channels >= 2) {
+                out[0] += sample * gainLeft;
+                out[1] += sample * gainRight;
+            } else {
+                out[0] += sample * 0.5f * (gainLeft + gainRight);
+            }
+            out += channels;
+
+            carrierPhase_ += frequency / sampleRate_;
+            carrierPhase_ -= std::floor(carrierPhase_);
+            pulsePhase_ += pulseRate / sampleRate_;
+            pulsePhase_ -= std::floor(pulsePhase_);
+        }
+
+        if (stopping_ && gainLeft_.value < 1e-4f && gainRight_.value < 1e-4f) {
+            gainLeft_.value = 0.0f;
+            gainRight_.value = 0.0f;
+            active_ = false;
+            stopping_ = false;
+        }
+    }
+
+private:
+    struct Smoothed {
+        float value = 0.0f;
+        float target = 0.0f;
+        float step(float coefficient) {
+            value += coefficient * (target - value);
+            return value;
+        }
+    };
+
+    double sampleRate_ = 48000.0;
+    float smoothing_ = 1.0f;
+    bool active_ = false;
+    bool stopping_ = false;
+    double carrierPhase_ = 0.0;
+    double pulsePhase_ = 0.0;
+    Smoothed gainLeft_;
+    Smoothed gainRight_;
+    Smoothed frequency_;
+    Smoothed pulseRate_;
+    Smoothed pulseDepth_;
+    Smoothed squareness_;
+};
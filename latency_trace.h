@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "logger.h"
+
+// End-to-end latency of warning commands, from the sender's timestamp to
+// the moment PortAudio reports the first affected sample reaches the DAC.
+//
+// Each stage is measured where it ends and added to a lock-free histogram,
+// so both the UDP receiver and the audio callbacks record without locks or
+// allocations. report() logs p50/p99/max per stage.
+
+enum LatencyStage : uint8_t {
+    LATENCY_SENDER_TO_RECEIVE = 0,    // binary packets only; sender and app clocks
+    LATENCY_RECEIVE_TO_ENQUEUE,       // datagram read until the command is queued
+    LATENCY_ENQUEUE_TO_CALLBACK,      // queued until the audio callback applies it
+    LATENCY_CALLBACK_TO_FIRST_SAMPLE, // applied until its block is written
+    LATENCY_CALLBACK_TO_DAC,          // block written until it is played (outputBufferDacTime)
+    LATENCY_RECEIVE_TO_DAC,
+    LATENCY_SENDER_TO_DAC,            // binary packets only
+    LATENCY_STAGE_COUNT
+};
+
+inline const char* latencyStageName(int stage) {
+    switch (stage) {
+        case LATENCY_SENDER_TO_RECEIVE: return "sender -> receive";
+        case LATENCY_RECEIVE_TO_ENQUEUE: return "receive -> enqueue";
+        case LATENCY_ENQUEUE_TO_CALLBACK: return "enqueue -> callback";
+        case LATENCY_CALLBACK_TO_FIRST_SAMPLE: return "callback -> first sample";
+        case LATENCY_CALLBACK_TO_DAC: return "callback -> DAC";
+        case LATENCY_RECEIVE_TO_DAC: return "receive -> DAC";
+        case LATENCY_SENDER_TO_DAC: return "sender -> DAC";
+        default: return "?";
+    }
+}
+
+// Steady clock in nanoseconds, the time base of every stage
+inline int64_t latencyNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wall clock in seconds since the Unix epoch, to compare with sender times
+inline double latencyWallClock() {
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Values below 16 us get one bucket each; above that every power of two is
+// split into 8 buckets, so percentiles are within 12.5%
+constexpr int LATENCY_LINEAR_BUCKETS = 16;
+constexpr int LATENCY_SUB_BUCKET_BITS = 3;
+constexpr int LATENCY_BUCKET_COUNT = LATENCY_LINEAR_BUCKETS + (40 - 4) * (1 << LATENCY_SUB_BUCKET_BITS);
+
+// Log-linear histogram of microsecond values with atomic counters
+class LatencyHistogram {
+public:
+    void record(int64_t nanoseconds) {
+        uint64_t micros = nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) / 1000 : 0;
+        buckets_[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (micros > max && !max_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t maxMicros() const { return max_.load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the q-th quantile (0..1), in us
+    uint64_t percentileMicros(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint64_t upper = bucketUpperBound(i);
+                return upper < maxMicros() ? upper : maxMicros();
+            }
+        }
+        return maxMicros();
+    }
+
+private:
+    static int bucketIndex(uint64_t micros) {
+        if (micros < LATENCY_LINEAR_BUCKETS) return static_cast<int>(micros);
+        int exponent = 63 - countLeadingZeros(micros);
+        int sub = static_cast<int>((micros >> (exponent - LATENCY_SUB_BUCKET_BITS)) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1));
+        int index = LATENCY_LINEAR_BUCKETS + (exponent - 4) * (1 << LATENCY_SUB_BUCKET_BITS) + sub;
+        return index < LATENCY_BUCKET_COUNT ? index : LATENCY_BUCKET_COUNT - 1;
+    }
+
+    static uint64_t bucketUpperBound(int index) {
+        if (index < LATENCY_LINEAR_BUCKETS) return static_cast<uint64_t>(index);
+        int offset = index - LATENCY_LINEAR_BUCKETS;
+        int exponent = offset / (1 << LATENCY_SUB_BUCKET_BITS) + 4;
+        uint64_t sub = static_cast<uint64_t>(offset % (1 << LATENCY_SUB_BUCKET_BITS));
+        uint64_t step = uint64_t(1) << (exponent - LATENCY_SUB_BUCKET_BITS);
+        return (uint64_t(1) << exponent) + (sub + 1) * step - 1;
+    }
+
+    static int countLeadingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(value);
+#else
+        int zeros = 0;
+        for (uint64_t bit = uint64_t(1) << 63; bit != 0 && (value & bit) == 0; bit >>= 1) ++zeros;
+        return zeros;
+#endif
+    }
+
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Timestamps carried by a traced warning command
+struct LatencyTrace {
+    int64_t receiveTime = 0;   // steady ns the datagram was read, 0 if untraced
+    int64_t enqueueTime = 0;   // steady ns the command was queued
+    int64_t senderDelay = -1;  // ns from the sender's timestamp to receiveTime, -1 if unknown
+};
+
+class LatencyTracer {
+public:
+    static LatencyTracer& instance() {
+        static LatencyTracer tracer;
+        return tracer;
+    }
+
+    void record(LatencyStage stage, int64_t nanoseconds) {
+        stages_[stage].record(nanoseconds);
+    }
+
+    // Record the stages of a command the audio callback applied at
+    // callbackTime, whose block was written by writtenTime and reaches the
+    // DAC dacDelay nanoseconds after that
+    void recordPlayback(const LatencyTrace& trace, int64_t callbackTime, int64_t writtenTime, int64_t dacDelay) {
+        if (trace.receiveTime == 0) return;
+        int64_t dacTime = writtenTime + dacDelay;
+        record(LATENCY_ENQUEUE_TO_CALLBACK, callbackTime - trace.enqueueTime);
+        record(LATENCY_CALLBACK_TO_FIRST_SAMPLE, writtenTime - callbackTime);
+        record(LATENCY_CALLBACK_TO_DAC, dacDelay);
+        record(LATENCY_RECEIVE_TO_DAC, dacTime - trace.receiveTime);
+        if (trace.senderDelay >= 0) {
+            record(LATENCY_SENDER_TO_DAC, trace.senderDelay + dacTime - trace.receiveTime);
+        }
+    }
+
+    const LatencyHistogram& stage(LatencyStage stage) const { return stages_[stage]; }
+
+    void report() const {
+        LOG_INFO("Warning latency (p50 / p99 / max):");
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+            const LatencyHistogram& histogram = stages_[stage];
+            if (histogram.count() == 0) {
+                LOG_INFO("  {}: no samples", latencyStageName(stage));
+                continue;
+            }
+            LOG_INFO("  {}: {} / {} / {} us ({} samples)", latencyStageName(stage),
+                     histogram.percentileMicros(0.50), histogram.percentileMicros(0.99),
+                     histogram.maxMicros(), histogram.count());
+        }
+    }
+
+private:
+    LatencyTracer() = default;
+    LatencyHistogram stages_[LATENCY_STAGE_COUNT];
+};
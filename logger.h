@@ -0,0 +1,274 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "command_ring.h"
+
+// Asynchronous, level-filtered logger.
+//
+// LOG_* calls capture the format string pointer and the argument values into
+// a fixed-size record and push it into a preallocated lock-free ring. A
+// background thread does the formatting ("{}" placeholders) and the console
+// writes, so logging never flushes the console on the calling thread and
+// never allocates. The format string must be a string literal.
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3,
+    Off = 4
+};
+
+// Messages below this level are compiled out entirely
+#ifndef DCS_HAPTIC_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define DCS_HAPTIC_LOG_MIN_LEVEL 1
+#else
+#define DCS_HAPTIC_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// True if messages at level are compiled in. Compares levels rather than
+// the macro's number, which would be an always-true test at level 0.
+constexpr bool logLevelEnabled(LogLevel level) {
+    return level >= static_cast<LogLevel>(DCS_HAPTIC_LOG_MIN_LEVEL);
+}
+
+constexpr size_t LOG_MAX_ARGS = 8;
+constexpr size_t LOG_TEXT_CAPACITY = 256;
+constexpr size_t LOG_RING_CAPACITY = 1024;
+
+enum class LogArgType : uint8_t {
+    Int,
+    UInt,
+    Double,
+    Bool,
+    Char,
+    String
+};
+
+struct LogArg {
+    LogArgType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        char c;
+        struct {
+            uint16_t offset;
+            uint16_t length;
+        } s;
+    };
+};
+
+// One log message; strings are copied into the record's text area
+struct LogRecord {
+    LogLevel level;
+    uint8_t argCount;
+    uint16_t textUsed;
+    const char* format;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_CAPACITY];
+};
+
+inline bool parseLogLevel(const std::string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::Debug;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "warning") level = LogLevel::Warning;
+    else if (name == "error") level = LogLevel::Error;
+    else if (name == "off") level = LogLevel::Off;
+    else return false;
+    return true;
+}
+
+inline const char* logLevelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Info: return "info";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error: return "error";
+        default: return "off";
+    }
+}
+
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    ~Logger() { stop(); }
+
+    // Start the background writer thread
+    void start() {
+        bool expected = false;
+        if (running_.compare_exchange_strong(expected, true)) {
+            writer_ = std::thread(&Logger::writerLoop, this);
+        }
+    }
+
+    // Write out everything still queued and stop the writer thread
+    void stop() {
+        if (running_.exchange(false)) {
+            if (writer_.joinable()) {
+                writer_.join();
+            }
+        }
+        drain();
+    }
+
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+
+    bool enabled(LogLevel level) const {
+        return level >= level_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t droppedRecords() const { return dropped_.load(std::memory_order_relaxed); }
+
+    template <typename... Args>
+    void log(LogLevel level, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+        if (!enabled(level)) return;
+
+        LogRecord record;
+        record.level = level;
+        record.argCount = 0;
+        record.textUsed = 0;
+        record.format = format;
+        (capture(record, args), ...);
+
+        if (!ring_.push(record)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    Logger() = default;
+
+    template <typename T>
+    static void capture(LogRecord& record, const T& value) {
+        LogArg& arg = record.args[record.argCount++];
+        if constexpr (std::is_same<T, bool>::value) {
+            arg.type = LogArgType::Bool;
+            arg.b = value;
+        } else if constexpr (std::is_same<T, char>::value) {
+            arg.type = LogArgType::Char;
+            arg.c = value;
+        } else if constexpr (std::is_enum<T>::value) {
+            arg.type = LogArgType::Int;
+            arg.i = static_cast<int64_t>(value);
+        } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            arg.type = LogArgType::Int;
+            arg.i = value;
+        } else if constexpr (std::is_integral<T>::value) {
+            arg.type = LogArgType::UInt;
+            arg.u = value;
+        } else if constexpr (std::is_floating_point<T>::value) {
+            arg.type = LogArgType::Double;
+            arg.d = value;
+        } else if constexpr (std::is_same<T, std::string>::value) {
+            captureString(record, arg, value.data(), value.size());
+        } else {
+            const char* text = value;
+            captureString(record, arg, text, text ? std::strlen(text) : 0);
+        }
+    }
+
+    static void captureString(LogRecord& record, LogArg& arg, const char* text, size_t length) {
+        size_t available = LOG_TEXT_CAPACITY - record.textUsed;
+        if (length > available) length = available;
+        std::memcpy(record.text + record.textUsed, text, length);
+        arg.type = LogArgType::String;
+        arg.s.offset = record.textUsed;
+        arg.s.length = static_cast<uint16_t>(length);
+        record.textUsed = static_cast<uint16_t>(record.textUsed + length);
+    }
+
+    void writerLoop() {
+        using namespace std::chrono_literals;
+        while (running_.load(std::memory_order_acquire)) {
+            if (!drain()) {
+                std::this_thread::sleep_for(10ms);
+            }
+        }
+    }
+
+    // Format and write all queued records. Returns false if there were none.
+    bool drain() {
+        bool wroteAny = false;
+        bool wroteError = false;
+        LogRecord record;
+        while (ring_.pop(record)) {
+            std::ostream& out = record.level >= LogLevel::Warning ? std::cerr : std::cout;
+            format(out, record);
+            out << '\n';
+            wroteAny = true;
+            wroteError |= record.level >= LogLevel::Warning;
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reportedDropped_) {
+            std::cerr << "Warning: " << dropped - reportedDropped_ << " log message(s) dropped, log queue full\n";
+            reportedDropped_ = dropped;
+            wroteError = true;
+        }
+
+        if (wroteAny) std::cout.flush();
+        if (wroteError) std::cerr.flush();
+        return wroteAny;
+    }
+
+    static void format(std::ostream& out, const LogRecord& record) {
+        const char* p = record.format;
+        size_t argIndex = 0;
+        while (*p) {
+            if (p[0] == '{' && p[1] == '}' && argIndex < record.argCount) {
+                writeArg(out, record, record.args[argIndex++]);
+                p += 2;
+            } else {
+                out << *p++;
+            }
+        }
+    }
+
+    static void writeArg(std::ostream& out, const LogRecord& record, const LogArg& arg) {
+        switch (arg.type) {
+            case LogArgType::Int: out << arg.i; break;
+            case LogArgType::UInt: out << arg.u; break;
+            case LogArgType::Double: out << arg.d; break;
+            case LogArgType::Bool: out << (arg.b ? "true" : "false"); break;
+            case LogArgType::Char: out << arg.c; break;
+            case LogArgType::String: out.write(record.text + arg.s.offset, arg.s.length); break;
+        }
+    }
+
+    MpscRing<LogRecord, LOG_RING_CAPACITY> ring_;
+    std::atomic<LogLevel> level_{LogLevel::Info};
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t reportedDropped_ = 0;
+    std::thread writer_;
+};
+
+#define LOG_AT_LEVEL(level, ...)                                         \
+    do {                                                                 \
+        if constexpr (logLevelEnabled(level)) {                          \
+            Logger::instance().log(level, __VA_ARGS__);                  \
+        }                                                                \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT_LEVEL(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT_LEVEL(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT_LEVEL(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_LEVEL(LogLevel::Error, __VA_ARGS__)
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "audio_backend.h"
+#include "audio_mixer.h"
+#include "logger.h"
+
+// Shared handle to a device's mixer. Every copy keeps the device's stream
+// open; the warnings of a profile hold one each.
+using OutputLease = std::shared_ptr<AudioMixer>;
+
+// How long a stream nobody leases stays open, so a reload that drops and
+// takes the device again in quick succession does not reopen it
+constexpr std::chrono::milliseconds OUTPUT_IDLE_CLOSE_DELAY{1000};
+// How often a configured device that is missing is looked for again
+constexpr std::chrono::milliseconds OUTPUT_DEVICE_RETRY_INTERVAL{5000};
+
+// Opens exactly one output stream per device and shares its mixer between
+// every warning routed to it, across all loaded profiles.
+//
+// Streams are reference counted through leases. A profile reloaded with the
+// same devices takes its leases while the previous version still holds
+// them, so a config reload never reopens a stream. The last lease is often
+// dropped on the receiver thread, which must not wait for the driver, so
+// idle streams are closed by the manager's own thread after
+// OUTPUT_IDLE_CLOSE_DELAY.
+//
+// The same thread runs the device-change handler when a stream stops on its
+// own (device unplugged) and, while retryDevicesLater() is pending, every
+// OUTPUT_DEVICE_RETRY_INTERVAL.
+class OutputManager {
+public:
+    // streamLost is false when called for retryDevicesLater()
+    using DeviceChangeHandler = std::function<void(bool streamLost)>;
+
+    ~OutputManager() { closeAll(); }
+
+    void setDeviceChangeHandler(DeviceChangeHandler handler) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deviceChangeHandler_ = std::move(handler);
+    }
+
+    // Backend for the streams opened from now on; PortAudio by default
+    void setBackend(const AudioBackendConfig& config) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        backendConfig_ = config;
+    }
+
+    AudioBackendConfig backend() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return backendConfig_;
+    }
+
+    // Lease the mixer of a device, opening its stream if needed. Returns
+    // null if the device cannot be opened.
+    OutputLease acquire(int deviceIndex) {
+        // Opening waits for the driver, so it happens outside mutex_, which
+        // release() takes on the receiver thread
+        std::lock_guard<std::mutex> streamLock(streamMutex_);
+        std::shared_ptr<Device> device;
+        AudioBackendConfig config;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!worker_.joinable() && !stopped_) {
+                worker_ = std::thread(&OutputManager::workerLoop, this);
+            }
+            auto it = devices_.find(deviceIndex);
+            if (it != devices_.end()) {
+                device = it->second;
+                ++device->leases;
+            }
+            config = backendConfig_;
+        }
+
+        if (!device) {
+            auto opened = std::make_shared<Device>();
+            opened->mixer = std::make_unique<AudioMixer>();
+            if (!opened->mixer->open(createAudioBackend(config), deviceIndex, [this] { onStreamLost(); })) {
+                return nullptr;
+            }
+            LOG_DEBUG("Opened output stream for device {}", deviceIndex);
+            // Nothing else adds devices while streamMutex_ is held
+            std::lock_guard<std::mutex> lock(mutex_);
+            opened->leases = 1;
+            devices_[deviceIndex] = opened;
+            device = std::move(opened);
+        }
+        // The lease does not own the mixer; it keeps its Device alive and
+        // returns its reference when the last copy goes away
+        std::shared_ptr<Device> owner = device;
+        return OutputLease(device->mixer.get(), [this, owner](AudioMixer*) { release(*owner); });
+    }
+
+    // Close every stream and forget the devices, then run whileDetached
+    // before any stream can be opened again, e.g. to re-initialize PortAudio
+    // and rescan them. Leased mixers stay allocated, closed, until their
+    // profiles are replaced.
+    void detachAll(const std::function<void()>& whileDetached = {}) {
+        std::lock_guard<std::mutex> streamLock(streamMutex_);
+        std::map<int, std::shared_ptr<Device>> detached;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            detached.swap(devices_);
+        }
+        for (auto& [deviceIndex, device] : detached) {
+            device->mixer->close();
+        }
+        if (whileDetached) {
+            whileDetached();
+        }
+    }
+
+    // Look for missing devices again after OUTPUT_DEVICE_RETRY_INTERVAL
+    void retryDevicesLater() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (retryAt_ != std::chrono::steady_clock::time_point::max()) return;
+            retryAt_ = std::chrono::steady_clock::now() + OUTPUT_DEVICE_RETRY_INTERVAL;
+        }
+        wake_.notify_one();
+    }
+
+    // True if no open stream is playing anything
+    bool allIdle() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [deviceIndex, device] : devices_) {
+            if (!device->mixer->isIdle()) return false;
+        }
+        return true;
+    }
+
+    // Stop every stream at exit. Mixers that are still leased stay
+    // allocated, closed, until their last lease is dropped.
+    void closeAll() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        wake_.notify_all();
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+
+        std::lock_guard<std::mutex> streamLock(streamMutex_);
+        std::vector<std::shared_ptr<Device>> open;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [deviceIndex, device] : devices_) {
+                open.push_back(device);
+            }
+        }
+        for (auto& device : open) {
+            device->mixer->close();
+        }
+    }
+
+    size_t openStreams() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return devices_.size();
+    }
+
+private:
+    struct Device {
+        std::unique_ptr<AudioMixer> mixer;
+        size_t leases = 0;  // guarded by mutex_
+        std::chrono::steady_clock::time_point idleSince;
+    };
+
+    // Runs wherever the last copy of a lease dies; never blocks on the driver
+    void release(Device& device) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (device.leases == 0 || --device.leases > 0) return;
+            device.idleSince = std::chrono::steady_clock::now();
+        }
+        wake_.notify_one();
+    }
+
+    // Called from a PortAudio thread
+    void onStreamLost() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            streamLost_ = true;
+        }
+        wake_.notify_one();
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopped_) {
+            auto now = std::chrono::steady_clock::now();
+
+            if (streamLost_ || now >= retryAt_) {
+                bool streamLost = streamLost_;
+                streamLost_ = false;
+                retryAt_ = std::chrono::steady_clock::time_point::max();
+                DeviceChangeHandler handler = deviceChangeHandler_;
+                if (handler) {
+                    lock.unlock();
+                    handler(streamLost);
+                    lock.lock();
+                }
+                continue;
+            }
+
+            // Sleep until the earliest idle stream or retry is due
+            auto due = retryAt_;
+            bool closeDue = false;
+            for (const auto& [deviceIndex, device] : devices_) {
+                if (device->leases > 0) continue;
+                if (now - device->idleSince >= OUTPUT_IDLE_CLOSE_DELAY) {
+                    closeDue = true;
+                } else if (device->idleSince + OUTPUT_IDLE_CLOSE_DELAY < due) {
+                    due = device->idleSince + OUTPUT_IDLE_CLOSE_DELAY;
+                }
+            }
+            if (closeDue) {
+                // Stopping a stream waits for the driver; release() must not
+                lock.unlock();
+                closeIdleStreams();
+                lock.lock();
+                continue;
+            }
+            if (due == std::chrono::steady_clock::time_point::max()) {
+                wake_.wait(lock);
+            } else {
+                wake_.wait_until(lock, due);
+            }
+        }
+    }
+
+    // Close the streams idle for OUTPUT_IDLE_CLOSE_DELAY. They are picked
+    // again under streamMutex_, so one leased meanwhile stays open.
+    void closeIdleStreams() {
+        std::lock_guard<std::mutex> streamLock(streamMutex_);
+        std::vector<std::shared_ptr<Device>> closing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = std::chrono::steady_clock::now();
+            for (auto it = devices_.begin(); it != devices_.end();) {
+                const Device& device = *it->second;
+                if (device.leases == 0 && now - device.idleSince >= OUTPUT_IDLE_CLOSE_DELAY) {
+                    LOG_INFO("Closing output stream for device {}, no warning uses it any more", it->first);
+                    closing.push_back(std::move(it->second));
+                    it = devices_.erase(it);
+                    continue;
+                }
+                ++it;
+            }
+        }
+        closing.clear();
+    }
+
+    mutable std::mutex mutex_;
+    // Serializes every stream open and close, which wait for the driver.
+    // Taken before mutex_, and never on the receiver thread.
+    std::mutex streamMutex_;
+    std::condition_variable wake_;
+    std::map<int, std::shared_ptr<Device>> devices_;
+    DeviceChangeHandler deviceChangeHandler_;
+    AudioBackendConfig backendConfig_;
+    bool streamLost_ = false;
+    std::chrono::steady_clock::time_point retryAt_ = std::chrono::steady_clock::time_point::max();
+    bool stopped_ = false;
+    std::thread worker_;
+};
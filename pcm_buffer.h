@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <boost/interprocess/mapped_region.hpp>
+
+// FNV-1a, used to identify clips and source files
+constexpr uint64_t FNV1A_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64_t FNV1A_PRIME = 1099511628211ULL;
+
+inline uint64_t fnv1a64(const void* data, size_t length, uint64_t hash = FNV1A_OFFSET_BASIS) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * FNV1A_PRIME;
+    }
+    return hash;
+}
+
+// Read-only interleaved float samples, either owned or memory-mapped from
+// the PCM cache. Shared between profiles, so it is never modified.
+class PcmBuffer {
+public:
+    explicit PcmBuffer(std::vector<float> samples)
+        : samples_(std::move(samples)), data_(samples_.data()), size_(samples_.size()) {}
+
+    // View of count samples at byte offset in a mapped cache file
+    PcmBuffer(boost::interprocess::mapped_region region, size_t offset, size_t count)
+        : region_(std::move(region)),
+          data_(reinterpret_cast<const float*>(static_cast<const char*>(region_.get_address()) + offset)),
+          size_(count) {}
+
+    PcmBuffer(const PcmBuffer&) = delete;
+    PcmBuffer& operator=(const PcmBuffer&) = delete;
+
+    const float* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool mapped() const { return region_.get_address() != nullptr; }
+
+private:
+    std::vector<float> samples_;
+    boost::interprocess::mapped_region region_;
+    const float* data_;
+    size_t size_;
+};
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "logger.h"
+#include "pcm_buffer.h"
+
+// Persistent cache of ready-to-play warning clips.
+//
+// Each entry is one clip after decoding, gain, limiting and conversion to
+// the device rate, stored as raw native floats behind a small header. A hit
+// maps the file read-only instead of decoding it, so samples are only paged
+// in when they are played. Entries live in one file per (clip path,
+// volume, balance, device rate). The header records the size, modification
+// time and hash of the source file. A lookup only stats the source; the
+// file is hashed only when its modification time no longer matches, so an
+// edited clip is detected and its entry rewritten, while a clip that was
+// merely touched or copied keeps its entry.
+
+// Bump when preprocessing, resampling or the header change, to drop all
+// old entries
+constexpr uint32_t PCM_CACHE_VERSION = 3;
+constexpr char PCM_CACHE_MAGIC[8] = {'D', 'C', 'S', 'P', 'C', 'M', '\0', '\0'};
+// Sample data starts at this offset, so it is aligned for SIMD loads
+constexpr size_t PCM_CACHE_DATA_OFFSET = 128;
+
+struct PcmCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dataOffset;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    int64_t sourceModified;  // file_time_type ticks
+    int32_t sourceRate;
+    int32_t outputRate;
+    int32_t channels;
+    int32_t balance;
+    float volume;
+    float scaling;
+    uint64_t samples;
+};
+static_assert(sizeof(PcmCacheHeader) <= PCM_CACHE_DATA_OFFSET, "PCM cache header too large");
+
+// What a clip is converted with; selects the cache file
+struct PcmCacheKey {
+    std::string sourcePath;
+    float volume = 0.0f;
+    int balance = 0;
+    int outputRate = 0;
+};
+
+// Size and modification time of a source clip, compared before its hash
+struct PcmSourceStamp {
+    uint64_t size = 0;
+    int64_t modified = 0;
+};
+
+inline bool statSourceFile(const std::string& path, PcmSourceStamp& stamp) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    stamp.size = size;
+    stamp.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+    return true;
+}
+
+// A cached clip and the values computed along with it
+struct PcmCacheEntry {
+    std::shared_ptr<const PcmBuffer> samples;
+    int sourceRate = 0;
+    int channels = 0;
+    float scaling = 1.0f;
+};
+
+// Hash a whole file, used to tell whether a source clip changed
+inline bool hashFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    hash = FNV1A_OFFSET_BASIS;
+    size = 0;
+    char chunk[64 * 1024];
+    while (file) {
+        file.read(chunk, sizeof(chunk));
+        std::streamsize count = file.gcount();
+        hash = fnv1a64(chunk, static_cast<size_t>(count), hash);
+        size += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+class PcmDiskCache {
+public:
+    explicit PcmDiskCache(std::string directory = "cache") : directory_(std::move(directory)) {}
+
+    // Map the entry for key if it was built from the source as it is now
+    bool load(const PcmCacheKey& key, const PcmSourceStamp& source, PcmCacheEntry& entry) {
+        namespace bip = boost::interprocess;
+        std::string path = entryPath(key);
+        std::error_code ec;
+        uint64_t fileSize = std::filesystem::file_size(path, ec);
+        PcmCacheHeader header;
+        if (ec || fileSize < PCM_CACHE_DATA_OFFSET || !readHeader(path, header)) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        bool valid = std::memcmp(header.magic, PCM_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version == PCM_CACHE_VERSION &&
+                     header.dataOffset == PCM_CACHE_DATA_OFFSET &&
+                     header.outputRate == key.outputRate &&
+                     header.balance == key.balance &&
+                     header.volume == key.volume &&
+                     header.channels > 0 &&
+                     fileSize == PCM_CACHE_DATA_OFFSET + header.samples * sizeof(float);
+        if (!valid) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (!sourceUnchanged(key.sourcePath, source, path, header)) {
+            LOG_INFO("Cached PCM for {} is stale, source file changed", key.sourcePath);
+            stale_.fetch_add(1, std::memory_order_relaxed);
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        try {
+            bip::file_mapping mapping(path.c_str(), bip::read_only);
+            bip::mapped_region region(mapping, bip::read_only);
+            entry.samples = std::make_shared<const PcmBuffer>(std::move(region), PCM_CACHE_DATA_OFFSET,
+                                                              static_cast<size_t>(header.samples));
+            entry.sourceRate = header.sourceRate;
+            entry.channels = header.channels;
+            entry.scaling = header.scaling;
+        } catch (const bip::interprocess_exception& e) {
+            LOG_WARNING("Warning: Could not map PCM cache file {}: {}", path, e.what());
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Write the entry for key, built from the source as stamped before it
+    // was decoded. The file is written under a temporary name and renamed,
+    // so a crash never leaves a truncated entry behind.
+    bool store(const PcmCacheKey& key, const PcmSourceStamp& source, const PcmCacheEntry& entry) {
+        uint64_t sourceHash = 0;
+        uint64_t sourceSize = 0;
+        if (!hashFile(key.sourcePath, sourceHash, sourceSize) || sourceSize != source.size) {
+            return false;
+        }
+        // An edit since the stamp would record the new hash with samples
+        // decoded from the old content; its time gives it away
+        PcmSourceStamp hashed;
+        if (!statSourceFile(key.sourcePath, hashed) || hashed.size != source.size ||
+            hashed.modified != source.modified) {
+            LOG_DEBUG("Not caching PCM for {}, the source file changed while it was decoded", key.sourcePath);
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(directory_, ec);
+        if (ec) {
+            LOG_WARNING("Warning: Could not create PCM cache directory {}: {}", directory_, ec.message());
+            return false;
+        }
+
+        PcmCacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, PCM_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PCM_CACHE_VERSION;
+        header.dataOffset = PCM_CACHE_DATA_OFFSET;
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.sourceModified = source.modified;
+        header.sourceRate = entry.sourceRate;
+        header.outputRate = key.outputRate;
+        header.channels = entry.channels;
+        header.balance = key.balance;
+        header.volume = key.volume;
+        header.scaling = entry.scaling;
+        header.samples = entry.samples->size();
+
+        std::string path = entryPath(key);
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                LOG_WARNING("Warning: Could not write PCM cache file {}", tempPath);
+                return false;
+            }
+            char padded[PCM_CACHE_DATA_OFFSET] = {};
+            std::memcpy(padded, &header, sizeof(header));
+            file.write(padded, sizeof(padded));
+            file.write(reinterpret_cast<const char*>(entry.samples->data()),
+                       static_cast<std::streamsize>(entry.samples->size() * sizeof(float)));
+            if (!file) {
+                LOG_WARNING("Warning: Could not write PCM cache file {}", tempPath);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec) {
+            // On Windows an entry that is still mapped cannot be replaced
+            LOG_WARNING("Warning: Could not replace PCM cache file {}: {}", path, ec.message());
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        LOG_DEBUG("Stored PCM cache entry {}", path);
+        return true;
+    }
+
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    uint64_t staleEntries() const { return stale_.load(std::memory_order_relaxed); }
+
+private:
+    static bool readHeader(const std::string& path, PcmCacheHeader& header) {
+        std::ifstream file(path, std::ios::binary);
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        return static_cast<bool>(file);
+    }
+
+    // True if the entry was built from the source file as it is now. Equal
+    // size and modification time are trusted; otherwise a source of the same
+    // size is hashed, and if only its time changed the entry is stamped with
+    // the new time so later lookups skip the hash again.
+    static bool sourceUnchanged(const std::string& sourcePath, const PcmSourceStamp& source,
+                                const std::string& path, const PcmCacheHeader& header) {
+        if (header.sourceSize != source.size) return false;
+        if (header.sourceModified == source.modified) return true;
+
+        uint64_t hash = 0;
+        uint64_t size = 0;
+        if (!hashFile(sourcePath, hash, size) || hash != header.sourceHash || size != header.sourceSize) {
+            return false;
+        }
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(static_cast<std::streamoff>(offsetof(PcmCacheHeader, sourceModified)));
+        file.write(reinterpret_cast<const char*>(&source.modified), sizeof(source.modified));
+        if (!file) {
+            LOG_DEBUG("Could not update the source time in PCM cache file {}", path);
+        }
+        return true;
+    }
+
+    std::string entryPath(const PcmCacheKey& key) const {
+        uint64_t hash = fnv1a64(key.sourcePath.data(), key.sourcePath.size());
+        hash = fnv1a64(&key.volume, sizeof(key.volume), hash);
+        hash = fnv1a64(&key.balance, sizeof(key.balance), hash);
+        hash = fnv1a64(&key.outputRate, sizeof(key.outputRate), hash);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.pcm", static_cast<unsigned long long>(hash));
+        return directory_ + "/" + name;
+    }
+
+    std::string directory_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stale_{0};
+};
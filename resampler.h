@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "logger.h"
+#include "pcm_buffer.h"
+
+// Polyphase windowed-sinc sample-rate converter for whole clips.
+//
+// The conversion ratio is reduced to L/M (e.g. 44100 -> 48000 is 160/147)
+// and one Kaiser-windowed sinc filter phase is precomputed for each of the L
+// output positions between input samples. Ratios that would need more than
+// RESAMPLER_MAX_PHASES phases use the nearest of RESAMPLER_MAX_PHASES
+// phases instead. Resident clips are converted whole at load time;
+// StreamingResampler converts streamed clips piece by piece on the thread
+// that decodes them. The audio callback never resamples.
+
+constexpr int RESAMPLER_TAPS = 64;           // filter taps per phase
+constexpr int RESAMPLER_MAX_PHASES = 4096;
+constexpr double RESAMPLER_KAISER_BETA = 8.6; // about 90 dB stopband
+constexpr double RESAMPLER_PASSBAND = 0.95;   // cutoff relative to the lower Nyquist
+
+inline long long greatestCommonDivisor(long long a, long long b) {
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+inline double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(int inputRate, int outputRate)
+        : inputRate_(inputRate), outputRate_(outputRate) {
+        long long divisor = greatestCommonDivisor(inputRate, outputRate);
+        upFactor_ = outputRate / divisor;
+        downFactor_ = inputRate / divisor;
+        phases_ = static_cast<int>(upFactor_ < RESAMPLER_MAX_PHASES ? upFactor_ : RESAMPLER_MAX_PHASES);
+        buildFilter();
+    }
+
+    int inputRate() const { return inputRate_; }
+    int outputRate() const { return outputRate_; }
+    size_t coefficientCount() const { return coefficients_.size(); }
+
+    size_t outputFrames(size_t inputFrames) const {
+        return static_cast<size_t>((static_cast<long long>(inputFrames) * upFactor_ + downFactor_ - 1) / downFactor_);
+    }
+
+    // Convert an interleaved clip. The output has outputFrames(frames) frames.
+    std::vector<float> process(const float* input, size_t frames, int channels) const {
+        size_t outFrames = outputFrames(frames);
+        std::vector<float> output(outFrames * channels);
+        if (frames == 0) return output;
+
+        // Each channel is copied into a zero-padded mono buffer so the inner
+        // loop is a contiguous dot product without edge checks
+        const int half = RESAMPLER_TAPS / 2;
+        // One frame more than the taps span, for a phase rounded up to the
+        // next input frame at the end
+        std::vector<float> padded(frames + RESAMPLER_TAPS + 1);
+        for (int ch = 0; ch < channels; ++ch) {
+            for (size_t i = 0; i < frames; ++i) {
+                padded[i + half] = input[i * channels + ch];
+            }
+
+            for (size_t n = 0; n < outFrames; ++n) {
+                size_t index;
+                const float* h = taps(n, index);
+                output[n * channels + ch] = dot(padded.data() + index + 1, h);
+            }
+        }
+        return output;
+    }
+
+    // Filter phase for output frame n. Its taps cover input frames
+    // index - RESAMPLER_TAPS / 2 + 1 .. index + RESAMPLER_TAPS / 2.
+    const float* taps(unsigned long long n, size_t& index) const {
+        long long position = static_cast<long long>(n) * downFactor_;
+        index = static_cast<size_t>(position / upFactor_);
+        long long remainder = position % upFactor_;
+        if (phases_ == upFactor_) {
+            return coefficients_.data() + static_cast<size_t>(remainder) * RESAMPLER_TAPS;
+        }
+        // Nearest phase; rounding up past the last one is phase 0 of the
+        // next input frame
+        int phase = static_cast<int>((remainder * phases_ + upFactor_ / 2) / upFactor_);
+        if (phase == phases_) {
+            phase = 0;
+            ++index;
+        }
+        return coefficients_.data() + static_cast<size_t>(phase) * RESAMPLER_TAPS;
+    }
+
+    // Output frames per period of the phase pattern, and the input frames
+    // they consume
+    long long upFactor() const { return upFactor_; }
+    long long downFactor() const { return downFactor_; }
+
+    static float dot(const float* x, const float* h) {
+        float acc0 = 0.0f, acc1 = 0.0f, acc2 = 0.0f, acc3 = 0.0f;
+        for (int k = 0; k < RESAMPLER_TAPS; k += 4) {
+            acc0 += x[k] * h[k];
+            acc1 += x[k + 1] * h[k + 1];
+            acc2 += x[k + 2] * h[k + 2];
+            acc3 += x[k + 3] * h[k + 3];
+        }
+        return (acc0 + acc1) + (acc2 + acc3);
+    }
+
+private:
+    void buildFilter() {
+        const int half = RESAMPLER_TAPS / 2;
+        const double pi = 3.14159265358979323846;
+        // Cutoff in cycles per input sample, lowered when downsampling
+        double cutoff = 0.5 * RESAMPLER_PASSBAND;
+        if (outputRate_ < inputRate_) {
+            cutoff *= static_cast<double>(outputRate_) / inputRate_;
+        }
+        double windowNorm = besselI0(RESAMPLER_KAISER_BETA);
+
+        coefficients_.assign(static_cast<size_t>(phases_) * RESAMPLER_TAPS, 0.0f);
+        for (int phase = 0; phase < phases_; ++phase) {
+            double fraction = static_cast<double>(phase) / phases_;
+            double sum = 0.0;
+            std::vector<double> taps(RESAMPLER_TAPS);
+            for (int idx = 0; idx < RESAMPLER_TAPS; ++idx) {
+                // Distance from input sample (index - half + 1 + idx) to the output time
+                double t = (half - 1 - idx) + fraction;
+                double x = 2.0 * cutoff * t;
+                double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(pi * x) / (pi * x);
+                double r = t / half;
+                double window = std::fabs(r) >= 1.0 ? 0.0
+                              : besselI0(RESAMPLER_KAISER_BETA * std::sqrt(1.0 - r * r)) / windowNorm;
+                taps[idx] = sinc * window;
+                sum += taps[idx];
+            }
+            // Unity gain at DC for every phase
+            for (int idx = 0; idx < RESAMPLER_TAPS; ++idx) {
+                coefficients_[static_cast<size_t>(phase) * RESAMPLER_TAPS + idx] = static_cast<float>(taps[idx] / sum);
+            }
+        }
+    }
+
+    int inputRate_;
+    int outputRate_;
+    long long upFactor_ = 1;
+    long long downFactor_ = 1;
+    int phases_ = 1;
+    std::vector<float> coefficients_;
+};
+
+// The same conversion for a clip fed in pieces, as a streamed clip is
+// decoded. Each channel is buffered behind RESAMPLER_TAPS / 2 frames of
+// zeros, as process() pads a whole clip, and input is only dropped once no
+// later output frame reads it, so the output carries on across pieces.
+// Copyable, to save a position in the stream and return to it.
+class StreamingResampler {
+public:
+    // filter may be shared by several streams; null passes the input through
+    StreamingResampler(std::shared_ptr<const PolyphaseResampler> filter, int channels)
+        : filter_(std::move(filter)), input_(static_cast<size_t>(channels)) {
+        reset();
+    }
+
+    // Start a new stream
+    void reset() {
+        size_t history = filter_ ? RESAMPLER_TAPS / 2 : 0;
+        for (std::vector<float>& samples : input_) {
+            samples.assign(history, 0.0f);
+        }
+        produced_ = 0;
+        consumed_ = 0;
+    }
+
+    // Append interleaved input frames
+    void push(const float* input, size_t frames) {
+        size_t channels = input_.size();
+        for (size_t ch = 0; ch < channels; ++ch) {
+            std::vector<float>& samples = input_[ch];
+            size_t start = samples.size();
+            samples.resize(start + frames);
+            for (size_t i = 0; i < frames; ++i) {
+                samples[start + i] = input[i * channels + ch];
+            }
+        }
+    }
+
+    // Write up to maxFrames interleaved output frames, as many as the input
+    // pushed so far covers. Returns the number written.
+    size_t pull(float* output, size_t maxFrames) {
+        size_t channels = input_.size();
+        size_t available = channels > 0 ? input_[0].size() : 0;
+        size_t count = 0;
+        if (!filter_) {
+            count = std::min(available, maxFrames);
+            for (size_t ch = 0; ch < channels; ++ch) {
+                for (size_t i = 0; i < count; ++i) {
+                    output[i * channels + ch] = input_[ch][i];
+                }
+            }
+            consumed_ = count;
+        } else {
+            for (; count < maxFrames; ++count) {
+                size_t index;
+                const float* h = filter_->taps(produced_, index);
+                size_t start = consumed_ + index + 1;
+                if (start + RESAMPLER_TAPS > available) break;
+                for (size_t ch = 0; ch < channels; ++ch) {
+                    output[count * channels + ch] = PolyphaseResampler::dot(input_[ch].data() + start, h);
+                }
+                // The phases repeat every upFactor output frames, so the
+                // frame count restarts there instead of growing without end
+                if (++produced_ == static_cast<unsigned long long>(filter_->upFactor())) {
+                    produced_ = 0;
+                    consumed_ += static_cast<size_t>(filter_->downFactor());
+                }
+            }
+        }
+
+        size_t dropped = std::min(consumed_, available);
+        for (std::vector<float>& samples : input_) {
+            samples.erase(samples.begin(), samples.begin() + dropped);
+        }
+        consumed_ -= dropped;
+        return count;
+    }
+
+private:
+    std::shared_ptr<const PolyphaseResampler> filter_;
+    std::vector<std::vector<float>> input_;  // per channel
+    unsigned long long produced_ = 0;        // output frames since the phases last repeated
+    size_t consumed_ = 0;                    // input frames no output reads any more
+};
+
+// Resampled clips kept around between reloads
+constexpr size_t RESAMPLE_CACHE_CAPACITY = 16;
+
+// Cache of clips converted to a device rate, keyed by (clip, device rate).
+// The clip is identified by a hash of its preprocessed samples, so a reload
+// of an unchanged clip, or a second warning using the same clip on the same
+// device, reuses the converted buffer instead of resampling again. Buffers
+// are shared, so evicting an entry never frees a clip that is still in use.
+class ResampledClipCache {
+public:
+    using Buffer = std::shared_ptr<const PcmBuffer>;
+
+    // Return the clip at outputRate, converting it on a miss
+    Buffer get(const std::vector<float>& clip, int channels, int inputRate, int outputRate) {
+        Key key{hashSamples(clip), clip.size(), channels, inputRate, outputRate};
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++useCounter_;
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            it->second.lastUse = useCounter_;
+            LOG_DEBUG("Resampled clip cache hit ({} Hz -> {} Hz)", inputRate, outputRate);
+            return it->second.buffer;
+        }
+
+        Buffer buffer;
+        if (inputRate == outputRate || channels <= 0 || inputRate <= 0 || outputRate <= 0) {
+            buffer = std::make_shared<const PcmBuffer>(clip);
+        } else {
+            auto start = std::chrono::steady_clock::now();
+            PolyphaseResampler resampler(inputRate, outputRate);
+            buffer = std::make_shared<const PcmBuffer>(
+                resampler.process(clip.data(), clip.size() / channels, channels));
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+            LOG_INFO("Resampled clip from {} Hz to {} Hz ({} frames) in {} ms",
+                     inputRate, outputRate, buffer->size() / channels, elapsed.count());
+        }
+
+        if (entries_.size() >= RESAMPLE_CACHE_CAPACITY) {
+            evictLeastRecentlyUsed();
+        }
+        entries_[key] = Entry{buffer, useCounter_};
+        return buffer;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+    }
+
+private:
+    struct Key {
+        uint64_t hash;
+        size_t samples;
+        int channels;
+        int inputRate;
+        int outputRate;
+
+        bool operator<(const Key& other) const {
+            return std::tie(hash, samples, channels, inputRate, outputRate) <
+                   std::tie(other.hash, other.samples, other.channels, other.inputRate, other.outputRate);
+        }
+    };
+
+    struct Entry {
+        Buffer buffer;
+        uint64_t lastUse;
+    };
+
+    static uint64_t hashSamples(const std::vector<float>& clip) {
+        return fnv1a64(clip.data(), clip.size() * sizeof(float));
+    }
+
+    void evictLeastRecentlyUsed() {
+        auto oldest = entries_.begin();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+        if (oldest != entries_.end()) {
+            entries_.erase(oldest);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::map<Key, Entry> entries_;
+    uint64_t useCounter_ = 0;
+};
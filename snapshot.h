@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "command_ring.h"
+
+// Threads that may hold a SnapshotCell read guard
+constexpr size_t SNAPSHOT_MAX_READERS = 16;
+
+// Holds the current version of an immutable value, RCU style.
+//
+// Readers register once per thread and then read without locks or
+// reference counting: a read guard announces the epoch it started in and
+// pins whatever value it loaded. publish() swaps the pointer in one atomic
+// exchange and retires the previous value; a retired value is released
+// once every reader that could have loaded it has dropped its guard, and
+// its optional release condition holds.
+template <typename T>
+class SnapshotCell {
+public:
+    using Value = std::shared_ptr<const T>;
+
+    // Per-thread reader registration
+    class Reader {
+    public:
+        Reader() = default;
+
+    private:
+        friend class SnapshotCell;
+        std::atomic<uint64_t>* slot_ = nullptr;
+    };
+
+    // Pins the value it was created with until it goes out of scope. Only
+    // one guard per reader may be alive at a time.
+    class ReadGuard {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard() { slot_->store(0, std::memory_order_release); }
+
+        const T* get() const { return value_; }
+        const T* operator->() const { return value_; }
+        const T& operator*() const { return *value_; }
+        explicit operator bool() const { return value_ != nullptr; }
+
+    private:
+        friend class SnapshotCell;
+        ReadGuard(const T* value, std::atomic<uint64_t>* slot) : value_(value), slot_(slot) {}
+        const T* value_;
+        std::atomic<uint64_t>* slot_;
+    };
+
+    SnapshotCell() {
+        for (auto& slot : slots_) {
+            slot.epoch.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Reserve a reader slot for the calling thread. Readers are registered
+    // at startup; running out of slots is a programming error.
+    Reader registerReader() {
+        size_t index = readerCount_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= SNAPSHOT_MAX_READERS) {
+            throw std::length_error("Too many snapshot readers");
+        }
+        Reader reader;
+        reader.slot_ = &slots_[index].epoch;
+        return reader;
+    }
+
+    // Lock-free; never blocks on publish()
+    ReadGuard read(Reader& reader) const {
+        reader.slot_->store(epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        return ReadGuard(current_.load(std::memory_order_seq_cst), reader.slot_);
+    }
+
+    // Make value current. The previous value is released once no reader can
+    // still see it and releaseCondition (if set) returns true.
+    void publish(Value value, std::function<bool()> releaseCondition = {}) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_.exchange(value.get(), std::memory_order_seq_cst);
+        uint64_t retiredIn = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        if (owner_) {
+            retired_.push_back(Retired{std::move(owner_), retiredIn, std::move(releaseCondition)});
+        }
+        owner_ = std::move(value);
+        collectLocked();
+    }
+
+    // Release the retired values whose grace period is over
+    void collect() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectLocked();
+    }
+
+    // Owning reference to the current value, for code that needs to keep it
+    Value current() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return owner_;
+    }
+
+    size_t retiredCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return retired_.size();
+    }
+
+    // Lock-free hint that collect() has something to release
+    bool hasRetired() const {
+        return retiredPending_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        std::atomic<uint64_t> epoch;  // epoch the active guard started in, 0 if none
+    };
+
+    struct Retired {
+        Value value;
+        uint64_t epoch;  // readers that started before this may still use it
+        std::function<bool()> releaseCondition;
+    };
+
+    void collectLocked() {
+        uint64_t oldestReader = UINT64_MAX;
+        size_t readers = readerCount_.load(std::memory_order_relaxed);
+        if (readers > SNAPSHOT_MAX_READERS) readers = SNAPSHOT_MAX_READERS;
+        for (size_t i = 0; i < readers; ++i) {
+            uint64_t epoch = slots_[i].epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < oldestReader) oldestReader = epoch;
+        }
+
+        for (size_t i = 0; i < retired_.size();) {
+            Retired& retired = retired_[i];
+            bool readersDone = oldestReader >= retired.epoch;
+            if (readersDone && (!retired.releaseCondition || retired.releaseCondition())) {
+                retired_.erase(retired_.begin() + static_cast<std::ptrdiff_t>(i));
+            } else {
+                ++i;
+            }
+        }
+        retiredPending_.store(!retired_.empty(), std::memory_order_relaxed);
+    }
+
+    std::atomic<const T*> current_{nullptr};
+    std::atomic<uint64_t> epoch_{1};
+    std::atomic<size_t> readerCount_{0};
+    std::atomic<bool> retiredPending_{false};
+    Slot slots_[SNAPSHOT_MAX_READERS];
+
+    mutable std::mutex mutex_;
+    Value owner_;
+    std::vector<Retired> retired_;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "channel_routing.h"
+
+// Numbered Source_<n>_* settings of default.cfg
+constexpr int SOURCE_ROUTE_MAX_NUMBER = 8;
+
+// Outputs of one cockpit when several send telemetry to this program, read
+// from default.cfg:
+//
+//   Source_1_address=192.168.1.20:50001   sender IP, optionally with its port
+//   Source_1_device_name=Speakers (Seat 2) device for both warnings and effects
+//   Source_1_routing=0>2 1>3              channels, replacing the warnings' routing
+//
+// A sender that matches no route plays on the devices of its airframe config.
+struct SourceRoute {
+    int number = 0;
+    boost::asio::ip::address address;
+    bool hasAddress = false;
+    uint16_t port = 0;  // 0 matches any port
+    std::string deviceName;
+    int deviceIndex = -1;
+    ChannelRouting routing;
+
+    bool matches(const boost::asio::ip::udp::endpoint& sender) const {
+        return hasAddress && sender.address() == address && (port == 0 || sender.port() == port);
+    }
+};
+
+// Apply one Source_<n>_<setting> key. Returns false with error set if the
+// key or value is malformed.
+inline bool parseSourceRouteSetting(const std::string& key, const std::string& value,
+                                    std::vector<SourceRoute>& routes, std::string& error) {
+    char* end = nullptr;
+    long number = std::strtol(key.c_str() + 7, &end, 10);  // after "Source_"
+    if (end == key.c_str() + 7 || *end != '_' || number < 1 || number > SOURCE_ROUTE_MAX_NUMBER) {
+        error = "expected Source_<1-" + std::to_string(SOURCE_ROUTE_MAX_NUMBER) + ">_<setting>";
+        return false;
+    }
+    std::string setting = end + 1;
+
+    auto it = std::find_if(routes.begin(), routes.end(),
+                           [number](const SourceRoute& route) { return route.number == number; });
+    SourceRoute route = it != routes.end() ? *it : SourceRoute();
+    route.number = static_cast<int>(number);
+
+    if (setting == "address") {
+        std::string host = value;
+        route.port = 0;
+        size_t colon = value.rfind(':');
+        if (colon != std::string::npos && value.find(':') == colon) {
+            int port = std::atoi(value.c_str() + colon + 1);
+            if (port < 1 || port > 65535) {
+                error = "bad port in '" + value + "'";
+                return false;
+            }
+            host = value.substr(0, colon);
+            route.port = static_cast<uint16_t>(port);
+        }
+        boost::system::error_code ec;
+        route.address = boost::asio::ip::make_address(host, ec);
+        if (ec) {
+            error = "'" + host + "' is not an IP address";
+            return false;
+        }
+        route.hasAddress = true;
+    } else if (setting == "device_name") {
+        route.deviceName = value;
+    } else if (setting == "device_index") {
+        route.deviceIndex = std::atoi(value.c_str());
+    } else if (setting == "routing") {
+        if (!parseChannelRouting(value, route.routing, error)) return false;
+    } else {
+        error = "unknown setting '" + setting + "'";
+        return false;
+    }
+
+    if (it != routes.end()) {
+        *it = route;
+    } else {
+        routes.push_back(route);
+    }
+    return true;
+}
+
+// Number of the first route a sender matches, 0 if none
+inline int matchSourceRoute(const std::vector<SourceRoute>& routes, const boost::asio::ip::udp::endpoint& sender) {
+    for (const SourceRoute& route : routes) {
+        if (route.matches(sender)) return route.number;
+    }
+    return 0;
+}
+
+inline const SourceRoute* findSourceRoute(const std::vector<SourceRoute>& routes, int number) {
+    for (const SourceRoute& route : routes) {
+        if (route.number == number) return &route;
+    }
+    return nullptr;
+}
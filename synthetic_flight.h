@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "telemetry_capture.h"
+#include "telemetry_packet.h"
+
+// Packets per second of the generated stream
+constexpr double SYNTHETIC_PACKET_RATE = 20.0;
+// Interval at which the generated stream repeats the airframe, as
+// AOAHaptic.lua does
+constexpr double SYNTHETIC_AIRFRAME_INTERVAL = 2.0;
+// Length of one maneuver: cruise, a pull through the warning band into
+// the stall, and the recovery
+constexpr double SYNTHETIC_MANEUVER_SECONDS = 20.0;
+
+// IAS (m/s) and AoA (degrees) of the synthetic flight at time t of a flight
+// lasting duration seconds: taxi, takeoff, repeated maneuvers, landing.
+// extra holds the optional sample fields (see telemetry_packet.h).
+struct SyntheticFlightState {
+    float IAS = 0.0f;
+    float AoA = 0.0f;
+    float extra[TELEMETRY_EXTRA_COUNT] = {};
+};
+
+// Height above ground of the synthetic flight: lift-off late in the takeoff
+// run, a climb to cruise and the descent to touchdown halfway through the
+// landing
+inline double syntheticAltitudeAt(double t, double duration) {
+    auto ramp = [](double from, double to, double x) { return from + (to - from) * std::min(std::max(x, 0.0), 1.0); };
+    double taxiEnd = 0.08 * duration;
+    double takeoffEnd = 0.15 * duration;
+    double landingStart = 0.85 * duration;
+    if (t < takeoffEnd) return ramp(0.0, 50.0, (t - taxiEnd) / (takeoffEnd - taxiEnd) * 3.0 - 2.0);
+    if (t < landingStart) {
+        return std::min(ramp(50.0, 800.0, (t - takeoffEnd) / 10.0), ramp(800.0, 60.0, (t - landingStart + 10.0) / 10.0));
+    }
+    return ramp(60.0, 0.0, (t - landingStart) / (duration - landingStart) * 2.0);
+}
+
+inline SyntheticFlightState syntheticFlightAt(double t, double duration) {
+    auto ramp = [](double from, double to, double x) { return from + (to - from) * std::min(std::max(x, 0.0), 1.0); };
+    double taxiEnd = 0.08 * duration;
+    double takeoffEnd = 0.15 * duration;
+    double landingStart = 0.85 * duration;
+
+    SyntheticFlightState state;
+    if (t < taxiEnd) {
+        state.IAS = 5.0f;
+        state.AoA = 2.0f;
+    } else if (t < takeoffEnd) {
+        double x = (t - taxiEnd) / (takeoffEnd - taxiEnd);
+        state.IAS = static_cast<float>(ramp(10.0, 150.0, x));
+        state.AoA = static_cast<float>(ramp(8.0, 4.0, x));
+    } else if (t < landingStart) {
+        double m = std::fmod(t - takeoffEnd, SYNTHETIC_MANEUVER_SECONDS);
+        double AoA;
+        if (m < 4.0) AoA = 4.0;                          // cruise
+        else if (m < 10.0) AoA = ramp(4.0, 18.0, (m - 4.0) / 6.0);    // into the warning band
+        else if (m < 13.0) AoA = ramp(18.0, 23.0, (m - 10.0) / 3.0);  // into the stall
+        else if (m < 15.0) AoA = 23.0;
+        else AoA = ramp(23.0, 4.0, (m - 15.0) / 5.0);   // recovery
+        state.AoA = static_cast<float>(AoA);
+        state.IAS = static_cast<float>(150.0 - 3.0 * AoA);
+    } else {
+        double x = (t - landingStart) / (duration - landingStart);
+        state.IAS = static_cast<float>(ramp(80.0, 0.0, x));
+        state.AoA = static_cast<float>(ramp(10.0, 0.0, x));
+    }
+
+    bool maneuvering = t >= takeoffEnd && t < landingStart;
+    double altitude = syntheticAltitudeAt(t, duration);
+    // Vertical speed as the sender would differentiate it, so the packet
+    // that reaches the ground still reports the sink rate
+    double step = 1.0 / SYNTHETIC_PACKET_RATE;
+    double verticalSpeed = (altitude - syntheticAltitudeAt(t - step, duration)) / step;
+    state.extra[TELEMETRY_G] = maneuvering ? 1.0f + 0.3f * std::max(state.AoA - 4.0f, 0.0f) : 1.0f;
+    state.extra[TELEMETRY_GEAR] = maneuvering ? 0.0f : 1.0f;
+    state.extra[TELEMETRY_FLAPS] = maneuvering ? 0.0f : (t < landingStart ? 0.5f : 1.0f);
+    state.extra[TELEMETRY_RPM] = t < taxiEnd ? 70.0f : (maneuvering ? 90.0f + 0.4f * state.AoA : 100.0f);
+    if (t >= landingStart) state.extra[TELEMETRY_RPM] = altitude > 0.0 ? 80.0f : 60.0f;
+    state.extra[TELEMETRY_VERTICAL_SPEED] = static_cast<float>(verticalSpeed);
+    state.extra[TELEMETRY_ALTITUDE_AGL] = static_cast<float>(altitude);
+    return state;
+}
+
+// Capture of a synthetic flight in the binary wire format, one packet per
+// wakeup at rate Hz. The AoA jitter uses a fixed seed, so every call with
+// the same arguments produces the same decisions. sendEpoch is the sender
+// clock (seconds since the Unix epoch) at the start of the flight.
+inline std::vector<char> generateSyntheticFlight(const std::string& airframe, double seconds, double rate,
+                                                 double sendEpoch) {
+    CaptureBuilder capture;
+    std::mt19937 rng(1);
+    std::normal_distribution<float> jitter(0.0f, 0.15f);
+    unsigned char packet[TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_AIRFRAME_NAME];
+    uint32_t sequence = 0;
+    double lastAirframe = -SYNTHETIC_AIRFRAME_INTERVAL;
+    size_t count = static_cast<size_t>(seconds * rate);
+
+    for (size_t i = 0; i < count; ++i) {
+        double t = i / rate;
+        uint64_t micros = static_cast<uint64_t>(t * 1e6);
+        if (t - lastAirframe >= SYNTHETIC_AIRFRAME_INTERVAL) {
+            size_t length = encodeTelemetryAirframe(packet, 0, sequence, sendEpoch + t, static_cast<float>(t),
+                                                    airframe.c_str());
+            capture.add(micros, packet, length);
+            lastAirframe = t;
+        }
+        SyntheticFlightState state = syntheticFlightAt(t, seconds);
+        float AoA = state.IAS >= 10.0f ? state.AoA + jitter(rng) : state.AoA;
+        size_t length = encodeTelemetrySampleExtended(packet, 0, sequence, sendEpoch + t, static_cast<float>(t),
+                                                      state.IAS, AoA, state.extra);
+        capture.add(micros, packet, length);
+        ++sequence;
+    }
+    return capture.release();
+}
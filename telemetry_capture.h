@@ -0,0 +1,261 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "udp_receiver.h"
+
+// Telemetry capture file, written by --record and read by --replay:
+//
+//   8 bytes  magic "DCSHCAP1"
+//   then one record per datagram, in arrival order:
+//     varint  (microseconds since the previous record << 1) | 1 if the
+//             datagram starts a new receiver wakeup
+//     varint  datagram length
+//     bytes   datagram
+//
+// Varints are unsigned LEB128. Datagrams drained in the same wakeup share
+// its arrival time, so a replay hands them to the receiver together and
+// coalesces exactly as the live run did.
+
+constexpr char TELEMETRY_CAPTURE_MAGIC[8] = {'D', 'C', 'S', 'H', 'C', 'A', 'P', '1'};
+// Longest record header: two 64-bit varints
+constexpr size_t CAPTURE_RECORD_HEADER_MAX = 20;
+
+inline size_t encodeVarint(unsigned char* out, uint64_t value) {
+    size_t length = 0;
+    do {
+        unsigned char byte = static_cast<unsigned char>(value & 0x7f);
+        value >>= 7;
+        out[length++] = static_cast<unsigned char>(byte | (value != 0 ? 0x80 : 0));
+    } while (value != 0);
+    return length;
+}
+
+// Returns false if the varint runs past end
+inline bool decodeVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+inline size_t encodeCaptureRecordHeader(unsigned char* out, uint64_t deltaMicros, bool newWakeup, size_t length) {
+    size_t size = encodeVarint(out, (deltaMicros << 1) | (newWakeup ? 1 : 0));
+    return size + encodeVarint(out + size, length);
+}
+
+// Builds a capture in memory, for generated telemetry
+class CaptureBuilder {
+public:
+    CaptureBuilder() { bytes_.assign(std::begin(TELEMETRY_CAPTURE_MAGIC), std::end(TELEMETRY_CAPTURE_MAGIC)); }
+
+    // Add a datagram arriving at timeMicros, alone in its wakeup
+    void add(uint64_t timeMicros, const unsigned char* data, size_t length) {
+        unsigned char header[CAPTURE_RECORD_HEADER_MAX];
+        uint64_t delta = timeMicros > lastMicros_ ? timeMicros - lastMicros_ : 0;
+        size_t headerLength = encodeCaptureRecordHeader(header, delta, true, length);
+        bytes_.insert(bytes_.end(), header, header + headerLength);
+        bytes_.insert(bytes_.end(), data, data + length);
+        lastMicros_ = timeMicros > lastMicros_ ? timeMicros : lastMicros_;
+    }
+
+    std::vector<char> release() { return std::move(bytes_); }
+
+private:
+    std::vector<char> bytes_;
+    uint64_t lastMicros_ = 0;
+};
+
+// Appends every datagram the receiver reads to a capture file. Runs on the
+// receiver thread; writes go through a fixed stdio buffer, so recording
+// does not allocate per packet.
+class CaptureRecorder {
+public:
+    ~CaptureRecorder() { close(); }
+
+    bool open(const std::string& path) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) return false;
+        std::setvbuf(file_, buffer_, _IOFBF, sizeof(buffer_));
+        std::fwrite(TELEMETRY_CAPTURE_MAGIC, 1, sizeof(TELEMETRY_CAPTURE_MAGIC), file_);
+        return true;
+    }
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    void record(uint64_t timeMicros, bool newWakeup, const char* data, size_t length) {
+        if (!file_) return;
+        unsigned char header[CAPTURE_RECORD_HEADER_MAX];
+        uint64_t delta = timeMicros > lastMicros_ ? timeMicros - lastMicros_ : 0;
+        std::fwrite(header, 1, encodeCaptureRecordHeader(header, delta, newWakeup, length), file_);
+        std::fwrite(data, 1, length, file_);
+        lastMicros_ = timeMicros > lastMicros_ ? timeMicros : lastMicros_;
+        ++datagrams_;
+        // Bound what an abrupt exit loses to about a second of traffic
+        if (lastMicros_ - flushedMicros_ >= 1000000) {
+            std::fflush(file_);
+            flushedMicros_ = lastMicros_;
+        }
+    }
+
+    uint64_t datagrams() const { return datagrams_; }
+
+    void close() {
+        if (file_) {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+private:
+    FILE* file_ = nullptr;
+    char buffer_[64 * 1024];
+    uint64_t lastMicros_ = 0;
+    uint64_t flushedMicros_ = 0;
+    uint64_t datagrams_ = 0;
+};
+
+// Feeds a capture to the receive loop in place of the socket. With speed 1
+// every wakeup happens at its original offset from the start, with speed N
+// N times faster and with speed 0 as fast as possible.
+class TelemetryReplay {
+public:
+    // Read a capture file; returns false if it is missing or not a capture
+    bool load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return load(std::move(bytes));
+    }
+
+    bool load(std::vector<char> bytes) {
+        if (bytes.size() < sizeof(TELEMETRY_CAPTURE_MAGIC) ||
+            std::memcmp(bytes.data(), TELEMETRY_CAPTURE_MAGIC, sizeof(TELEMETRY_CAPTURE_MAGIC)) != 0) {
+            return false;
+        }
+        bytes_ = std::move(bytes);
+        position_ = reinterpret_cast<const unsigned char*>(bytes_.data()) + sizeof(TELEMETRY_CAPTURE_MAGIC);
+        end_ = reinterpret_cast<const unsigned char*>(bytes_.data()) + bytes_.size();
+        started_ = false;
+        return true;
+    }
+
+    void setSpeed(double speed) { speed_ = speed > 0.0 ? speed : 0.0; }
+
+    // Move to the next wakeup; it is due at wakeupDue(). Datagrams of the
+    // current wakeup that were not read are skipped. Returns false at the
+    // end of the capture.
+    bool nextWakeup() {
+        Record record;
+        while (peek(record) && !record.newWakeup) {
+            advance(record);
+        }
+        if (!peek(record)) return false;
+
+        wakeupMicros_ = timeMicros_ + record.deltaMicros;
+        inWakeup_ = true;
+        read_ = 0;
+        if (!started_) {
+            started_ = true;
+            firstMicros_ = wakeupMicros_;
+            start_ = std::chrono::steady_clock::now();
+        }
+        return true;
+    }
+
+    // When the current wakeup should be replayed at the set speed; already
+    // due when replaying as fast as possible
+    std::chrono::steady_clock::time_point wakeupDue() const {
+        if (speed_ <= 0.0) return start_;
+        auto offset = std::chrono::duration<double, std::micro>((wakeupMicros_ - firstMicros_) / speed_);
+        return start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+    }
+
+    // Copy up to one batch of the current wakeup's datagrams, NUL-terminated
+    // and truncated (and flagged) as the socket would. Returns 0 once the
+    // wakeup is done.
+    size_t receivePending(DatagramBatch& batch) {
+        size_t count = 0;
+        Record record;
+        while (count < DATAGRAM_BATCH_SIZE && inWakeup_ && peek(record)) {
+            if (record.newWakeup && count + read_ > 0) {
+                break;
+            }
+            size_t length = record.length < DATAGRAM_MAX_SIZE - 1 ? record.length : DATAGRAM_MAX_SIZE - 1;
+            std::memcpy(batch.data[count], record.data, length);
+            batch.data[count][length] = '\0';
+            batch.length[count] = length;
+            batch.truncated[count] = length < record.length;
+            // Captures do not keep the sender, so a replay is one source
+            batch.sender[count] = boost::asio::ip::udp::endpoint();
+            advance(record);
+            ++count;
+            ++read_;
+        }
+        if (count == 0) {
+            inWakeup_ = false;
+            read_ = 0;
+        }
+        return count;
+    }
+
+    // Capture time of the current wakeup, in microseconds from the first
+    uint64_t wakeupTime() const { return wakeupMicros_ - firstMicros_; }
+    bool malformed() const { return malformed_; }
+
+private:
+    struct Record {
+        uint64_t deltaMicros = 0;
+        bool newWakeup = false;
+        size_t length = 0;
+        const unsigned char* data = nullptr;
+        const unsigned char* next = nullptr;
+    };
+
+    bool peek(Record& record) {
+        if (position_ >= end_) return false;
+        const unsigned char* p = position_;
+        uint64_t timing;
+        uint64_t length;
+        if (!decodeVarint(p, end_, timing) || !decodeVarint(p, end_, length) ||
+            length > static_cast<uint64_t>(end_ - p)) {
+            malformed_ = true;
+            position_ = end_;
+            return false;
+        }
+        record.deltaMicros = timing >> 1;
+        record.newWakeup = (timing & 1) != 0;
+        record.length = static_cast<size_t>(length);
+        record.data = p;
+        record.next = p + length;
+        return true;
+    }
+
+    void advance(const Record& record) {
+        timeMicros_ += record.deltaMicros;
+        position_ = record.next;
+    }
+
+    std::vector<char> bytes_;
+    const unsigned char* position_ = nullptr;
+    const unsigned char* end_ = nullptr;
+    double speed_ = 1.0;
+    bool started_ = false;
+    bool inWakeup_ = false;
+    bool malformed_ = false;
+    size_t read_ = 0;             // datagrams read in the current wakeup
+    uint64_t timeMicros_ = 0;     // capture time of the last record passed
+    uint64_t wakeupMicros_ = 0;
+    uint64_t firstMicros_ = 0;
+    std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+// Binary telemetry wire format, version 1 (all fields little-endian)
+//
+// Header, 24 bytes:
+//   0  u8   magic (0xDC, never the first byte of a CSV packet)
+//   1  u8   version
+//   2  u8   packet type
+//   3  u8   airframe id
+//   4  u32  sequence number
+//   8  f64  sender wall clock time (seconds since the Unix epoch)
+//   16 f32  sim model time (seconds)
+//   20 u16  payload length
+//   22 u16  reserved, zero
+//
+// Sample payload:   f32 IAS, f32 AoA, then optionally the extra fields
+//                   below in this order: f32 G (normal load factor), gear
+//                   and flaps (0 up to 1 down), RPM (% of the faster
+//                   engine), vertical speed (m/s) and altitude above ground
+//                   (m). A sender may stop after any of them; fields beyond
+//                   the last one this version knows are ignored.
+// Airframe payload: airframe name bytes, binds the header's airframe id
+//
+// Packets that do not start with the magic byte are parsed as the legacy
+// "IAS,AoA,airframe" CSV text.
+
+constexpr uint8_t TELEMETRY_MAGIC = 0xDC;
+constexpr uint8_t TELEMETRY_VERSION = 1;
+constexpr size_t TELEMETRY_HEADER_SIZE = 24;
+constexpr size_t TELEMETRY_SAMPLE_PAYLOAD_SIZE = 8;  // IAS and AoA only
+constexpr size_t TELEMETRY_MAX_AIRFRAME_NAME = 255;
+
+// Optional sample fields after IAS and AoA, in wire order
+enum TelemetryExtraField : uint8_t {
+    TELEMETRY_G = 0,
+    TELEMETRY_GEAR,
+    TELEMETRY_FLAPS,
+    TELEMETRY_RPM,
+    TELEMETRY_VERTICAL_SPEED,
+    TELEMETRY_ALTITUDE_AGL,
+    TELEMETRY_EXTRA_COUNT
+};
+
+constexpr size_t TELEMETRY_EXTENDED_PAYLOAD_SIZE = TELEMETRY_SAMPLE_PAYLOAD_SIZE + 4 * TELEMETRY_EXTRA_COUNT;
+
+enum TelemetryPacketType : uint8_t {
+    TELEMETRY_SAMPLE = 1,
+    TELEMETRY_AIRFRAME = 2
+};
+
+enum class TelemetryParseResult {
+    Sample,             // sample filled in
+    AirframeDeclared,   // airframe id bound, no sample
+    UnknownAirframe,    // sample references an id not declared yet
+    UnsupportedVersion,
+    Malformed
+};
+
+// One telemetry sample. airframe points into the parser and stays valid
+// until the next call to parse().
+struct TelemetrySample {
+    float IAS = 0.0f;
+    float AoA = 0.0f;
+    // NaN for fields the packet did not carry (CSV and older senders)
+    float extra[TELEMETRY_EXTRA_COUNT];
+    const char* airframe = "";
+    bool binary = false;     // sequence and times are only set for binary packets
+    uint32_t sequence = 0;
+    double sendTime = 0.0;
+    float modelTime = 0.0f;
+    int64_t receiveTime = 0;  // steady clock ns the datagram was read, see latency_trace.h
+    int64_t senderDelay = -1; // ns from sendTime to receiveTime, -1 if unknown
+    uint64_t captureTime = 0; // us since the first datagram of the run or replayed capture
+
+    TelemetrySample() { clearExtra(); }
+
+    void clearExtra() {
+        for (float& value : extra) value = std::numeric_limits<float>::quiet_NaN();
+    }
+};
+
+inline uint16_t readU16LE(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t readU32LE(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline float readF32LE(const unsigned char* p) {
+    uint32_t bits = readU32LE(p);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline double readF64LE(const unsigned char* p) {
+    uint64_t bits = static_cast<uint64_t>(readU32LE(p)) | (static_cast<uint64_t>(readU32LE(p + 4)) << 32);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void writeU16LE(unsigned char* p, uint16_t value) {
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+inline void writeU32LE(unsigned char* p, uint32_t value) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+inline void writeF32LE(unsigned char* p, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32LE(p, bits);
+}
+
+inline void writeF64LE(unsigned char* p, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    writeU32LE(p, static_cast<uint32_t>(bits));
+    writeU32LE(p + 4, static_cast<uint32_t>(bits >> 32));
+}
+
+// Encoders matching AOAHaptic.lua, for tools that generate telemetry.
+// out must hold TELEMETRY_HEADER_SIZE plus the payload; return the length.
+inline size_t encodeTelemetryHeader(unsigned char* out, uint8_t type, uint8_t airframeId, uint32_t sequence,
+                                    double sendTime, float modelTime, uint16_t payloadLength) {
+    out[0] = TELEMETRY_MAGIC;
+    out[1] = TELEMETRY_VERSION;
+    out[2] = type;
+    out[3] = airframeId;
+    writeU32LE(out + 4, sequence);
+    writeF64LE(out + 8, sendTime);
+    writeF32LE(out + 16, modelTime);
+    writeU16LE(out + 20, payloadLength);
+    writeU16LE(out + 22, 0);
+    return TELEMETRY_HEADER_SIZE;
+}
+
+inline size_t encodeTelemetrySample(unsigned char* out, uint8_t airframeId, uint32_t sequence,
+                                    double sendTime, float modelTime, float IAS, float AoA) {
+    encodeTelemetryHeader(out, TELEMETRY_SAMPLE, airframeId, sequence, sendTime, modelTime,
+                          TELEMETRY_SAMPLE_PAYLOAD_SIZE);
+    writeF32LE(out + TELEMETRY_HEADER_SIZE, IAS);
+    writeF32LE(out + TELEMETRY_HEADER_SIZE + 4, AoA);
+    return TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_PAYLOAD_SIZE;
+}
+
+// Sample with all TELEMETRY_EXTRA_COUNT extra fields
+inline size_t encodeTelemetrySampleExtended(unsigned char* out, uint8_t airframeId, uint32_t sequence,
+                                            double sendTime, float modelTime, float IAS, float AoA,
+                                            const float* extra) {
+    encodeTelemetryHeader(out, TELEMETRY_SAMPLE, airframeId, sequence, sendTime, modelTime,
+                          TELEMETRY_EXTENDED_PAYLOAD_SIZE);
+    writeF32LE(out + TELEMETRY_HEADER_SIZE, IAS);
+    writeF32LE(out + TELEMETRY_HEADER_SIZE + 4, AoA);
+    for (size_t i = 0; i < TELEMETRY_EXTRA_COUNT; ++i) {
+        writeF32LE(out + TELEMETRY_HEADER_SIZE + TELEMETRY_SAMPLE_PAYLOAD_SIZE + 4 * i, extra[i]);
+    }
+    return TELEMETRY_HEADER_SIZE + TELEMETRY_EXTENDED_PAYLOAD_SIZE;
+}
+
+// The name is cut to TELEMETRY_MAX_AIRFRAME_NAME bytes, as the script does
+inline size_t encodeTelemetryAirframe(unsigned char* out, uint8_t airframeId, uint32_t sequence,
+                                      double sendTime, float modelTime, const char* airframe) {
+    size_t length = std::strlen(airframe);
+    if (length > TELEMETRY_MAX_AIRFRAME_NAME) length = TELEMETRY_MAX_AIRFRAME_NAME;
+    encodeTelemetryHeader(out, TELEMETRY_AIRFRAME, airframeId, sequence, sendTime, modelTime,
+                          static_cast<uint16_t>(length));
+    std::memcpy(out + TELEMETRY_HEADER_SIZE, airframe, length);
+    return TELEMETRY_HEADER_SIZE + length;
+}
+
+// Parser for both wire formats. Keeps the airframe id -> name table for the
+// binary format in fixed storage, so parsing never allocates.
+class TelemetryParser {
+public:
+    // data must be NUL-terminated at data[len] for the CSV path
+    TelemetryParseResult parse(const char* data, size_t len, TelemetrySample& sample) {
+        if (len == 0) {
+            return TelemetryParseResult::Malformed;
+        }
+        if (static_cast<unsigned char>(data[0]) != TELEMETRY_MAGIC) {
+            return parseCsv(data, sample);
+        }
+        return parseBinary(reinterpret_cast<const unsigned char*>(data), len, sample);
+    }
+
+private:
+    TelemetryParseResult parseCsv(const char* data, TelemetrySample& sample) {
+        if (sscanf(data, "%f,%f,%255s", &sample.IAS, &sample.AoA, csvAirframe_) != 3) {
+            return TelemetryParseResult::Malformed;
+        }
+        sample.airframe = csvAirframe_;
+        sample.binary = false;
+        sample.clearExtra();
+        return TelemetryParseResult::Sample;
+    }
+
+    TelemetryParseResult parseBinary(const unsigned char* data, size_t len, TelemetrySample& sample) {
+        if (len < TELEMETRY_HEADER_SIZE) {
+            return TelemetryParseResult::Malformed;
+        }
+        if (data[1] != TELEMETRY_VERSION) {
+            return TelemetryParseResult::UnsupportedVersion;
+        }
+
+        uint8_t type = data[2];
+        uint8_t airframeId = data[3];
+        size_t payloadLength = readU16LE(data + 20);
+        if (payloadLength > len - TELEMETRY_HEADER_SIZE) {
+            return TelemetryParseResult::Malformed;
+        }
+        const unsigned char* payload = data + TELEMETRY_HEADER_SIZE;
+
+        if (type == TELEMETRY_AIRFRAME) {
+            if (payloadLength == 0 || payloadLength > TELEMETRY_MAX_AIRFRAME_NAME) {
+                return TelemetryParseResult::Malformed;
+            }
+            std::memcpy(airframeNames_[airframeId], payload, payloadLength);
+            airframeNames_[airframeId][payloadLength] = '\0';
+            airframeKnown_[airframeId] = true;
+            return TelemetryParseResult::AirframeDeclared;
+        }
+
+        if (type != TELEMETRY_SAMPLE || payloadLength < TELEMETRY_SAMPLE_PAYLOAD_SIZE) {
+            return TelemetryParseResult::Malformed;
+        }
+        if (!airframeKnown_[airframeId]) {
+            return TelemetryParseResult::UnknownAirframe;
+        }
+
+        sample.binary = true;
+        sample.sequence = readU32LE(data + 4);
+        sample.sendTime = readF64LE(data + 8);
+        sample.modelTime = readF32LE(data + 16);
+        sample.IAS = readF32LE(payload);
+        sample.AoA = readF32LE(payload + 4);
+        size_t extras = (payloadLength - TELEMETRY_SAMPLE_PAYLOAD_SIZE) / 4;
+        for (size_t i = 0; i < TELEMETRY_EXTRA_COUNT; ++i) {
+            sample.extra[i] = i < extras ? readF32LE(payload + TELEMETRY_SAMPLE_PAYLOAD_SIZE + 4 * i)
+                                         : std::numeric_limits<float>::quiet_NaN();
+        }
+        sample.airframe = airframeNames_[airframeId];
+        return TelemetryParseResult::Sample;
+    }
+
+    char csvAirframe_[256] = "";
+    char airframeNames_[256][TELEMETRY_MAX_AIRFRAME_NAME + 1] = {};
+    bool airframeKnown_[256] = {};
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include "airframe_profile.h"
+#include "aoa_predictor.h"
+#include "audio_mixer.h"
+#include "effect_rules.h"
+#include "snapshot.h"
+#include "telemetry_packet.h"
+
+// Senders served at once; each plays on its own voices in the mixers
+constexpr size_t MAX_TELEMETRY_SOURCES = MIXER_SOURCES;
+// A source silent for this long may be taken over by a new sender when all
+// are in use, e.g. DCS sending from a new port after a mission restart
+constexpr int64_t TELEMETRY_SOURCE_IDLE_NANOS = 10'000'000'000;
+
+// AoA tracking of a source
+struct AoaPrediction {
+    AoaPredictor predictor;
+    double latency = AOA_PREDICTOR_NOMINAL_LATENCY;  // receive to DAC, seconds
+    uint32_t samples = 0;
+};
+
+// Effect cues of a source's current profile
+struct EffectPlayback {
+    std::shared_ptr<const EffectRuleSet> rules;
+    OutputLease output;            // where the playing layers were sent
+    EffectEvaluator evaluator;
+    int playing[EFFECT_LAYERS] = {-1, -1, -1, -1};  // rule per layer, -1 when silent
+};
+
+// Everything the receiver keeps per sender endpoint: the airframe it flies,
+// its profile and the state of its warnings. One sim instance or seat never
+// sees the airframe switches or warning state of another.
+struct TelemetrySource {
+    uint8_t id = 0;  // voice bank in the mixers, see SoundCommand::source
+    boost::asio::ip::udp::endpoint sender;
+    std::string name;  // sender address, for the log
+    int route = 0;     // number of the Source_<n> route it plays on, 0 for none
+    uint32_t routesVersion = 0;
+
+    // Current profile, published on the loader thread and read by the
+    // receiver. wantedProfile is guarded by profileSwitchMutex.
+    SnapshotCell<AirframeProfile> profile;
+    SnapshotCell<AirframeProfile>::Reader reader;
+    std::string wantedProfile;
+
+    // Receiver thread only from here on
+    TelemetryParser parser;  // airframe ids are chosen by each sender
+    std::string airframe;
+    bool soundPlaying = false;
+    WarningBand warningBand = WarningBand::Idle;
+    AoaPrediction prediction;
+    EffectPlayback effects;
+    bool haveLastSequence = false;
+    uint32_t lastSequence = 0;
+    int64_t lastReceiveTime = 0;
+    uint64_t lastCaptureTime = 0;  // capture clock, microseconds
+
+    // Newest sample of the current wakeup in the latest receive mode; the
+    // airframe name is copied because the parser reuses its storage
+    TelemetrySample pending;
+    bool hasPending = false;
+    char pendingAirframe[TELEMETRY_MAX_AIRFRAME_NAME + 1] = "";
+
+    uint64_t coalescedPackets = 0;
+    uint64_t droppedPackets = 0;
+    uint64_t ignoredPackets = 0;  // unparsable, or sent before the airframe
+
+    TelemetrySource() : reader(profile.registerReader()) {}
+
+    // Forget the previous sender's state when the slot is taken over. The
+    // profile stays until the new sender's airframe replaces it.
+    void restart(const boost::asio::ip::udp::endpoint& endpoint) {
+        sender = endpoint;
+        name = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+        parser = TelemetryParser();
+        airframe.clear();
+        soundPlaying = false;
+        warningBand = WarningBand::Idle;
+        prediction = AoaPrediction();
+        // Re-arms the one-shot effects; the rules stay with the profile
+        effects.evaluator.reset(effects.rules.get());
+        haveLastSequence = false;
+        lastSequence = 0;
+        lastCaptureTime = 0;
+        hasPending = false;
+        coalescedPackets = 0;
+        droppedPackets = 0;
+        ignoredPackets = 0;
+    }
+};
+
+// Fixed table of the senders seen so far. Sources are created by the
+// receiver and never freed while it runs, so other threads may walk the
+// first size() entries under the lock that guards their creation.
+class TelemetrySourceTable {
+public:
+    // Source of a sender, or null if it has not been seen; no allocation
+    TelemetrySource* find(const boost::asio::ip::udp::endpoint& sender) {
+        size_t count = size();
+        for (size_t i = 0; i < count; ++i) {
+            if (sources_[i]->sender == sender) return sources_[i].get();
+        }
+        return nullptr;
+    }
+
+    // New source for a sender, or null if the table is full
+    TelemetrySource* add(const boost::asio::ip::udp::endpoint& sender) {
+        size_t count = size();
+        if (count == MAX_TELEMETRY_SOURCES) return nullptr;
+        sources_[count] = std::make_unique<TelemetrySource>();
+        sources_[count]->id = static_cast<uint8_t>(count);
+        sources_[count]->restart(sender);
+        count_.store(count + 1, std::memory_order_release);
+        return sources_[count].get();
+    }
+
+    // Source silent the longest, if for longer than TELEMETRY_SOURCE_IDLE_NANOS
+    TelemetrySource* idlest(int64_t now) {
+        TelemetrySource* idlest = nullptr;
+        size_t count = size();
+        for (size_t i = 0; i < count; ++i) {
+            TelemetrySource* source = sources_[i].get();
+            if (now - source->lastReceiveTime < TELEMETRY_SOURCE_IDLE_NANOS) continue;
+            if (!idlest || source->lastReceiveTime < idlest->lastReceiveTime) idlest = source;
+        }
+        return idlest;
+    }
+
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+    TelemetrySource& operator[](size_t index) { return *sources_[index]; }
+
+private:
+    std::unique_ptr<TelemetrySource> sources_[MAX_TELEMETRY_SOURCES];
+    std::atomic<size_t> count_{0};
+};
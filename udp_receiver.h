@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <boost/asio.hpp>
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+// Datagrams read per system call while draining the socket
+constexpr size_t DATAGRAM_BATCH_SIZE = 32;
+// Largest datagram kept; one byte is reserved for the NUL terminator
+constexpr size_t DATAGRAM_MAX_SIZE = 1024;
+
+// Preallocated storage for one batch of datagrams
+struct DatagramBatch {
+    char data[DATAGRAM_BATCH_SIZE][DATAGRAM_MAX_SIZE];
+    size_t length[DATAGRAM_BATCH_SIZE];
+    // Set if the datagram was longer than DATAGRAM_MAX_SIZE - 1 and only its
+    // start was kept; such a datagram must not be parsed
+    bool truncated[DATAGRAM_BATCH_SIZE];
+    boost::asio::ip::udp::endpoint sender[DATAGRAM_BATCH_SIZE];
+};
+
+// Receive errors that only report an ICMP message for an earlier send,
+// e.g. port unreachable from a sender that went away; Windows reports it
+// on the next receive of a UDP socket. The socket keeps working.
+inline bool isTransientReceiveError(const boost::system::error_code& error) {
+    return error == boost::asio::error::connection_reset || error == boost::asio::error::connection_refused;
+}
+
+// Read the datagrams that are already queued on the socket, without
+// blocking, up to one batch. Each datagram is NUL-terminated in place and
+// flagged if it was truncated. Returns the number read; a full batch means
+// more may be pending. On a receive error ec is set and the datagrams read
+// before it are returned; transient errors are skipped.
+inline size_t receivePendingDatagrams(boost::asio::ip::udp::socket& socket, DatagramBatch& batch,
+                                      boost::system::error_code& ec) {
+    ec.clear();
+#ifdef __linux__
+    // recvmmsg pulls the whole batch in one system call
+    mmsghdr messages[DATAGRAM_BATCH_SIZE];
+    iovec buffers[DATAGRAM_BATCH_SIZE];
+    std::memset(messages, 0, sizeof(messages));
+    for (size_t i = 0; i < DATAGRAM_BATCH_SIZE; ++i) {
+        buffers[i].iov_base = batch.data[i];
+        buffers[i].iov_len = DATAGRAM_MAX_SIZE - 1;
+        messages[i].msg_hdr.msg_iov = &buffers[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_name = batch.sender[i].data();
+        messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(batch.sender[i].capacity());
+    }
+
+    int received;
+    for (;;) {
+        received = recvmmsg(socket.native_handle(), messages, DATAGRAM_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received >= 0) break;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        ec.assign(errno, boost::system::system_category());
+        // Each call reports one queued ICMP error; datagrams may follow it
+        if (!isTransientReceiveError(ec)) return 0;
+        ec.clear();
+    }
+    for (int i = 0; i < received; ++i) {
+        batch.length[i] = messages[i].msg_len;
+        batch.truncated[i] = (messages[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        batch.data[i][batch.length[i]] = '\0';
+        batch.sender[i].resize(messages[i].msg_hdr.msg_namelen);
+    }
+    return static_cast<size_t>(received);
+#else
+    if (!socket.non_blocking()) {
+        socket.non_blocking(true, ec);
+        if (ec) return 0;
+    }
+
+    size_t count = 0;
+    while (count < DATAGRAM_BATCH_SIZE) {
+        boost::system::error_code error;
+        size_t len = socket.receive_from(boost::asio::buffer(batch.data[count], DATAGRAM_MAX_SIZE - 1),
+                                         batch.sender[count], 0, error);
+        if (error == boost::asio::error::would_block) {
+            break;
+        }
+        if (isTransientReceiveError(error)) {
+            continue;
+        }
+        if (error && error != boost::asio::error::message_size) {
+            ec = error;
+            break;
+        }
+        batch.length[count] = len;
+        batch.truncated[count] = error == boost::asio::error::message_size;
+        batch.data[count][len] = '\0';
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Sequence numbers this far behind the last one mean the sender restarted
+constexpr uint32_t SEQUENCE_RESTART_WINDOW = 1024;
+
+// True if a packet is a duplicate of, or older than, the last one acted on.
+// Handles wrap-around of the 32-bit counter.
+inline bool isStaleSequence(uint32_t sequence, uint32_t lastSequence) {
+    uint32_t behind = lastSequence - sequence;
+    return behind < SEQUENCE_RESTART_WINDOW;
+}